@@ -64,6 +64,7 @@ section_order = (
 
 param_exclude = (
     'channel_id',
+    'arena',
 )
 
 # Annotations are displayed as line items after API function descriptions.
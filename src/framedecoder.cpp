@@ -0,0 +1,157 @@
+#include <cstring>
+#include "framedecoder.h"
+
+namespace NeovimQt {
+
+/**
+ * \class NeovimQt::FrameDecoder
+ *
+ * \brief Decodes the compressed frames sent by Neovim after
+ * nvim_set_compression()
+ *
+ * Each frame is the byte 0xc1, the message size and the payload size
+ * (big endian quint32) and the payload. The payload is a single msgpack
+ * message compressed with the LZ4 block format, or the message itself if
+ * both sizes are equal.
+ */
+
+/// Messages larger than this are rejected as invalid frames
+static const quint32 MAX_MESSAGE_SIZE = 256*1024*1024;
+
+static quint32 readBE32(const uchar *p)
+{
+	return (quint32(p[0]) << 24) | (quint32(p[1]) << 16)
+		| (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+FrameDecoder::FrameDecoder()
+:m_pos(0)
+{
+}
+
+/// Add data read from the device
+void FrameDecoder::append(const char *data, qint64 len)
+{
+	if (m_pos > 0 && m_pos == m_buf.size()) {
+		m_buf.clear();
+		m_pos = 0;
+	} else if (m_pos > 65536) {
+		m_buf.remove(0, m_pos);
+		m_pos = 0;
+	}
+	m_buf.append(data, len);
+}
+
+/**
+ * Decode the next frame into msg, frameSize is set to the number of bytes
+ * it used in the input.
+ *
+ * After InvalidFrame the decoder cannot be used anymore.
+ */
+FrameDecoder::Status FrameDecoder::next(QByteArray& msg, int *frameSize)
+{
+	int avail = m_buf.size() - m_pos;
+	if (avail < HeaderSize) {
+		return NeedMoreData;
+	}
+	const uchar *header = reinterpret_cast<const uchar*>(m_buf.constData() + m_pos);
+	if (header[0] != Marker) {
+		return InvalidFrame;
+	}
+	quint32 size = readBE32(header + 1);
+	quint32 payload = readBE32(header + 5);
+	if (size > MAX_MESSAGE_SIZE || payload > size + size/255 + 16) {
+		return InvalidFrame;
+	}
+	if (quint32(avail - HeaderSize) < payload) {
+		return NeedMoreData;
+	}
+
+	const char *data = m_buf.constData() + m_pos + HeaderSize;
+	if (payload == size) {
+		msg = QByteArray(data, size);
+	} else {
+		msg.resize(size);
+		if (!lz4Decompress(data, payload, msg.data(), size)) {
+			return InvalidFrame;
+		}
+	}
+	m_pos += HeaderSize + payload;
+	if (frameSize) {
+		*frameSize = HeaderSize + payload;
+	}
+	return FrameReady;
+}
+
+/**
+ * Decompress an LZ4 block, dstlen must be the exact decompressed size.
+ * Returns false if the block is malformed.
+ */
+bool FrameDecoder::lz4Decompress(const char *src, int srclen, char *dst, int dstlen)
+{
+	const uchar *ip = reinterpret_cast<const uchar*>(src);
+	const uchar *iend = ip + srclen;
+	uchar *op = reinterpret_cast<uchar*>(dst);
+	uchar *oend = op + dstlen;
+
+	while (ip < iend) {
+		uint token = *ip++;
+
+		// Literals
+		size_t len = token >> 4;
+		if (len == 15) {
+			uint b;
+			do {
+				if (ip >= iend) {
+					return false;
+				}
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		if (size_t(iend - ip) < len || size_t(oend - op) < len) {
+			return false;
+		}
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+		if (ip == iend) {
+			// The last sequence has no match
+			break;
+		}
+
+		// Match
+		if (iend - ip < 2) {
+			return false;
+		}
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > size_t(op - reinterpret_cast<uchar*>(dst))) {
+			return false;
+		}
+		len = token & 0xf;
+		if (len == 15) {
+			uint b;
+			do {
+				if (ip >= iend) {
+					return false;
+				}
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		len += 4;
+		if (size_t(oend - op) < len) {
+			return false;
+		}
+		// Byte by byte, the match can overlap the output
+		const uchar *match = op - offset;
+		for (size_t i=0; i<len; i++) {
+			op[i] = match[i];
+		}
+		op += len;
+	}
+	return op == oend;
+}
+
+} // Namespace NeovimQt
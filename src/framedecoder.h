@@ -0,0 +1,32 @@
+#ifndef NEOVIM_QT_FRAMEDECODER
+#define NEOVIM_QT_FRAMEDECODER
+
+#include <QByteArray>
+
+namespace NeovimQt {
+
+class FrameDecoder
+{
+public:
+	enum Status {
+		NeedMoreData,
+		FrameReady,
+		InvalidFrame,
+	};
+
+	/// First byte of a frame, never used by msgpack
+	static const uchar Marker = 0xc1;
+	static const int HeaderSize = 9;
+
+	FrameDecoder();
+	void append(const char *data, qint64 len);
+	Status next(QByteArray& msg, int *frameSize=nullptr);
+	static bool lz4Decompress(const char *src, int srclen, char *dst, int dstlen);
+
+private:
+	QByteArray m_buf;
+	int m_pos;
+};
+
+} // Namespace NeovimQt
+#endif
@@ -4,7 +4,10 @@
 #include <QTextStream>
 #include <QFileInfo>
 #include <QDir>
+#include <QPointer>
 #include "mainwindow.h"
+#include "latencytrace.h"
+#include "rpcstats.h"
 
 namespace NeovimQt {
 
@@ -62,6 +65,18 @@ App::App(int &argc, char ** argv)
 		qInstallMessageHandler(logger);
 	}
 
+	// Trace input latency, the trace is written to $NVIM_QT_TRACE on exit
+	QString trace_path = QString::fromLocal8Bit(qgetenv("NVIM_QT_TRACE"));
+	if (!trace_path.isEmpty()) {
+		LatencyTrace::setEnabled(true);
+		connect(this, &QCoreApplication::aboutToQuit, [trace_path]() {
+			if (!LatencyTrace::writeChromeTrace(trace_path)) {
+				qWarning() << "Unable to write trace to" << trace_path;
+			}
+			qDebug().noquote() << LatencyTrace::report();
+		});
+	}
+
 	QByteArray stylesheet_path = qgetenv("NVIM_QT_STYLESHEET");
 	if (!stylesheet_path.isEmpty()) {
 		QFile qssfile(stylesheet_path);
@@ -86,10 +101,37 @@ bool App::event(QEvent *event)
 
 void App::showUi(NeovimConnector *c, const QCommandLineParser& parser)
 {
+	// Capture all data sent by Neovim to $NVIM_QT_CAPTURE, the capture
+	// can be replayed with NeovimQt::ReplayDevice
+	QString capture_path = QString::fromLocal8Bit(qgetenv("NVIM_QT_CAPTURE"));
+	if (!capture_path.isEmpty()) {
+		c->startCapture(capture_path);
+	}
+
+	// Dump the RPC traffic counters to $NVIM_QT_RPC_STATS on exit
+	QString stats_path = QString::fromLocal8Bit(qgetenv("NVIM_QT_RPC_STATS"));
+	if (!stats_path.isEmpty()) {
+		QPointer<NeovimConnector> connector(c);
+		connect(this, &QCoreApplication::aboutToQuit, [connector, stats_path]() {
+			QFile f(stats_path);
+			if (!connector || !f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+				qWarning() << "Unable to write RPC stats to" << stats_path;
+				return;
+			}
+			QTextStream stream(&f);
+			stream << connector->rpcStats()->report() << "\n";
+		});
+	}
+
 	auto opts = ShellOptions();
 	if (parser.isSet("no-ext-tabline")) {
 		opts.enable_ext_tabline = false;
 	}
+	// Read the grid from shared memory, needs a Neovim that supports the
+	// shm_path UI option
+	if (!qgetenv("NVIM_QT_SHM_GRID").isEmpty()) {
+		opts.enable_shm_grid = true;
+	}
 
 #ifdef NEOVIMQT_GUI_WIDGET
 	NeovimQt::Shell *win = new NeovimQt::Shell(c);
@@ -151,6 +193,8 @@ void App::processCliOptions(QCommandLineParser &parser, const QStringList& argum
 				QCoreApplication::translate("main", "addr")));
 	parser.addOption(QCommandLineOption("spawn",
 				QCoreApplication::translate("main", "Treat positional arguments as the nvim argv")));
+	parser.addOption(QCommandLineOption("compress",
+				QCoreApplication::translate("main", "Ask the --server instance to compress the data it sends")));
 	parser.addHelpOption();
 
 #ifdef Q_OS_UNIX
@@ -199,7 +243,9 @@ NeovimConnector* App::createConnector(const QCommandLineParser& parser)
 		return NeovimQt::NeovimConnector::fromStdinOut();
 	} else if (parser.isSet("server")) {
 		QString server = parser.value("server");
-		return NeovimQt::NeovimConnector::connectToNeovim(server);
+		NeovimConnector *c = NeovimQt::NeovimConnector::connectToNeovim(server);
+		c->setCompression(parser.isSet("compress"));
+		return c;
 	} else if (parser.isSet("spawn") && !parser.positionalArguments().isEmpty()) {
 		const QStringList& args = parser.positionalArguments();
 		return NeovimQt::NeovimConnector::spawn(args.mid(1), args.at(0));
@@ -0,0 +1,238 @@
+#include "buffermirror.h"
+#include <QDebug>
+#include "msgpackrequest.h"
+
+namespace NeovimQt {
+
+/// Chunks are split when they grow past twice this size
+static const int CHUNK_SIZE = 1024;
+
+LineRope::LineRope()
+:m_size(0)
+{
+}
+
+int LineRope::size() const
+{
+	return m_size;
+}
+
+/// The line at idx (0-based), or an empty line if idx is out of range
+QByteArray LineRope::line(int idx) const
+{
+	int offset;
+	int c = chunkAt(idx, &offset);
+	if (idx < 0 || c >= m_chunks.size()) {
+		return QByteArray();
+	}
+	return m_chunks.at(c).at(offset);
+}
+
+void LineRope::clear()
+{
+	m_chunks.clear();
+	m_size = 0;
+}
+
+/// Index of the chunk holding line idx, offset is set to the position of
+/// the line in the chunk. Returns the chunk count if idx is past the end.
+int LineRope::chunkAt(int idx, int *offset) const
+{
+	for (int c=0; c<m_chunks.size(); c++) {
+		int len = m_chunks.at(c).size();
+		if (idx < len) {
+			*offset = idx;
+			return c;
+		}
+		idx -= len;
+	}
+	*offset = idx;
+	return m_chunks.size();
+}
+
+void LineRope::split(int chunk)
+{
+	QList<QByteArray> lines = m_chunks.at(chunk);
+	m_chunks.remove(chunk);
+	for (int i=0; i<lines.size(); i+=CHUNK_SIZE) {
+		m_chunks.insert(chunk++, lines.mid(i, CHUNK_SIZE));
+	}
+}
+
+/// Replace lines [first, last) with lines, i.e. the arguments of
+/// nvim_buf_lines_event
+void LineRope::replace(int first, int last, const QList<QByteArray>& lines)
+{
+	first = qBound(0, first, m_size);
+	last = qBound(first, last, m_size);
+
+	int offset;
+	int c = chunkAt(first, &offset);
+	int remove = last - first;
+	while (remove > 0 && c < m_chunks.size()) {
+		QList<QByteArray>& chunk = m_chunks[c];
+		int n = qMin(remove, chunk.size() - offset);
+		chunk.erase(chunk.begin() + offset, chunk.begin() + offset + n);
+		remove -= n;
+		m_size -= n;
+		if (chunk.isEmpty()) {
+			m_chunks.remove(c);
+		} else {
+			c++;
+			offset = 0;
+		}
+	}
+
+	if (lines.isEmpty()) {
+		return;
+	}
+
+	c = chunkAt(first, &offset);
+	if (c == m_chunks.size()) {
+		// Append to the last chunk if it has room
+		if (c > 0 && m_chunks.last().size() < CHUNK_SIZE) {
+			c--;
+			offset = m_chunks.at(c).size();
+		} else {
+			m_chunks.append(QList<QByteArray>());
+			offset = 0;
+		}
+	}
+
+	QList<QByteArray>& chunk = m_chunks[c];
+	QList<QByteArray> tail = chunk.mid(offset);
+	chunk.erase(chunk.begin() + offset, chunk.end());
+	chunk.append(lines);
+	chunk.append(tail);
+	m_size += lines.size();
+	if (chunk.size() > 2*CHUNK_SIZE) {
+		split(c);
+	}
+}
+
+/**
+ * \class NeovimQt::BufferMirror
+ *
+ * \brief A replica of Neovim buffers kept up to date with nvim_buf_attach
+ *
+ * Neovim sends the buffer contents when a buffer is attached, and then
+ * only the lines that change (nvim_buf_lines_event). The GUI can read
+ * buffer lines without sending requests to Neovim.
+ *
+ * Notifications must be forwarded to handleNeovimNotification.
+ */
+
+BufferMirror::BufferMirror(NeovimConnector *nvim, QObject *parent)
+:QObject(parent), m_nvim(nvim)
+{
+}
+
+/// Start mirroring buffer, its contents are sent by Neovim
+void BufferMirror::attach(qint64 buffer)
+{
+	if (!m_nvim || m_buffers.contains(buffer)) {
+		return;
+	}
+
+	m_buffers.insert(buffer, Buffer());
+	MsgpackRequest *r = m_nvim->request("nvim_buf_attach",
+			QVariantList() << buffer << true << QVariantMap());
+	connect(r, &MsgpackRequest::finished, this,
+		[this, buffer](quint32, quint64, const QVariant& resp) {
+			// False if the buffer is not loaded
+			if (!resp.toBool() && m_buffers.remove(buffer)) {
+				emit detached(buffer);
+			}
+		});
+	connect(r, &MsgpackRequest::error, this,
+		[this, buffer](quint32, quint64, const QVariant& err) {
+			qWarning() << "Unable to attach to buffer" << buffer << err;
+			if (m_buffers.remove(buffer)) {
+				emit detached(buffer);
+			}
+		});
+}
+
+void BufferMirror::detach(qint64 buffer)
+{
+	if (!m_buffers.remove(buffer)) {
+		return;
+	}
+	m_nvim->request("nvim_buf_detach", QVariantList() << buffer);
+	emit detached(buffer);
+}
+
+void BufferMirror::detachAll()
+{
+	foreach(qint64 buffer, m_buffers.keys()) {
+		detach(buffer);
+	}
+}
+
+bool BufferMirror::isAttached(qint64 buffer) const
+{
+	return m_buffers.contains(buffer);
+}
+
+/// A copy of the buffer lines, empty if the buffer is not attached
+LineRope BufferMirror::lines(qint64 buffer) const
+{
+	return m_buffers.value(buffer).lines;
+}
+
+/// The b:changedtick of the last update, -1 if the buffer is not attached
+qint64 BufferMirror::changedtick(qint64 buffer) const
+{
+	return m_buffers.value(buffer).changedtick;
+}
+
+void BufferMirror::handleNeovimNotification(const QByteArray& name, const QVariantList& args)
+{
+	if (name == "nvim_buf_lines_event") {
+		if (args.size() < 5 || !args.at(0).canConvert<qint64>() ||
+				!args.at(2).canConvert<qint64>() ||
+				!args.at(3).canConvert<qint64>() ||
+				(QMetaType::Type)args.at(4).type() != QMetaType::QVariantList) {
+			qWarning() << "Unexpected arguments for nvim_buf_lines_event" << args;
+			return;
+		}
+		qint64 buffer = args.at(0).toLongLong();
+		if (!m_buffers.contains(buffer)) {
+			return;
+		}
+
+		Buffer& buf = m_buffers[buffer];
+		if (args.at(1).isValid()) {
+			buf.changedtick = args.at(1).toLongLong();
+		}
+		QList<QByteArray> lines;
+		foreach(const QVariant& line, args.at(4).toList()) {
+			lines.append(line.toByteArray());
+		}
+		int first = args.at(2).toInt();
+		// -1 means the end of the buffer, e.g. the initial contents
+		int last = args.at(3).toLongLong() == -1 ? buf.lines.size() : args.at(3).toInt();
+		buf.lines.replace(first, last, lines);
+		emit linesChanged(buffer, first, last, lines.size());
+	} else if (name == "nvim_buf_changedtick_event") {
+		if (args.size() < 2 || !args.at(0).canConvert<qint64>()) {
+			qWarning() << "Unexpected arguments for nvim_buf_changedtick_event" << args;
+			return;
+		}
+		qint64 buffer = args.at(0).toLongLong();
+		if (m_buffers.contains(buffer)) {
+			m_buffers[buffer].changedtick = args.at(1).toLongLong();
+		}
+	} else if (name == "nvim_buf_detach_event") {
+		if (args.size() < 1 || !args.at(0).canConvert<qint64>()) {
+			qWarning() << "Unexpected arguments for nvim_buf_detach_event" << args;
+			return;
+		}
+		qint64 buffer = args.at(0).toLongLong();
+		if (m_buffers.remove(buffer)) {
+			emit detached(buffer);
+		}
+	}
+}
+
+} // Namespace
@@ -0,0 +1,66 @@
+#ifndef NEOVIM_QT_BUFFERMIRROR
+#define NEOVIM_QT_BUFFERMIRROR
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QVariantList>
+#include "neovimconnector.h"
+
+namespace NeovimQt {
+
+/// Buffer lines, stored in chunks so that edits only copy the chunks they
+/// touch. Copies are cheap and can be read from other threads.
+class LineRope
+{
+public:
+	LineRope();
+	int size() const;
+	QByteArray line(int idx) const;
+	void replace(int first, int last, const QList<QByteArray>& lines);
+	void clear();
+
+private:
+	int chunkAt(int idx, int *offset) const;
+	void split(int chunk);
+
+	QVector<QList<QByteArray> > m_chunks;
+	int m_size;
+};
+
+class BufferMirror: public QObject
+{
+	Q_OBJECT
+public:
+	BufferMirror(NeovimConnector *nvim, QObject *parent=0);
+	void attach(qint64 buffer);
+	void detach(qint64 buffer);
+	void detachAll();
+	bool isAttached(qint64 buffer) const;
+	LineRope lines(qint64 buffer) const;
+	qint64 changedtick(qint64 buffer) const;
+
+signals:
+	/// Lines [first, last) were replaced by count lines
+	void linesChanged(qint64 buffer, int first, int last, int count);
+	void detached(qint64 buffer);
+
+public slots:
+	void handleNeovimNotification(const QByteArray& name, const QVariantList& args);
+
+private:
+	class Buffer {
+	public:
+		Buffer(): changedtick(-1) {}
+		LineRope lines;
+		qint64 changedtick;
+	};
+
+	NeovimConnector *m_nvim;
+	QHash<qint64, Buffer> m_buffers;
+};
+
+} // Namespace
+#endif
@@ -3,13 +3,14 @@
 #include <QCloseEvent>
 #include <QToolBar>
 #include <QLayout>
+#include "tabline.h"
 
 namespace NeovimQt {
 
 MainWindow::MainWindow(NeovimConnector *c, ShellOptions opts, QWidget *parent)
 :QMainWindow(parent), m_nvim(0), m_errorWidget(0), m_shell(0),
 	m_delayedShow(DelayedShow::Disabled), m_tabline(0), m_tabline_bar(0),
-	m_shell_options(opts)
+	m_shell_options(opts), m_minimap_dock(0)
 {
 	m_errorWidget = new ErrorWidget();
 	m_stack.addWidget(m_errorWidget);
@@ -76,6 +77,23 @@ void MainWindow::init(NeovimConnector *c)
 			this, &MainWindow::neovimTablineUpdate);
 	m_shell->setFocus(Qt::OtherFocusReason);
 
+	// The minimap is hidden until requested with GuiMinimap()
+	if (!m_minimap_dock) {
+		m_minimap_dock = new QDockWidget(this);
+		m_minimap_dock->setObjectName("minimap");
+		m_minimap_dock->setFeatures(QDockWidget::NoDockWidgetFeatures);
+		m_minimap_dock->setTitleBarWidget(new QWidget(m_minimap_dock));
+		addDockWidget(Qt::RightDockWidgetArea, m_minimap_dock);
+		m_minimap_dock->hide();
+	}
+	if (m_minimap_dock->widget()) {
+		m_minimap_dock->widget()->deleteLater();
+	}
+	Minimap *minimap = new Minimap(c, m_minimap_dock);
+	m_minimap_dock->setWidget(minimap);
+	connect(minimap, &Minimap::visibilityRequested,
+			m_minimap_dock, &QDockWidget::setVisible);
+
 	if (m_nvim->errorCause()) {
 		neovimError(m_nvim->errorCause());
 	}
@@ -242,35 +260,10 @@ void MainWindow::neovimTablineUpdate(int64_t curtab, QList<Tab> tabs)
 		return;
 	}
 
-	// remove extra tabs
-	for (int index=tabs.size(); index<m_tabline->count(); index++) {
-		m_tabline->removeTab(index);
-	}
-
-
-	for (int index=0; index<tabs.size(); index++) {
-		// Escape & in tab name otherwise it will be interpreted as
-		// a keyboard shortcut (#357) - escaping is done using &&
-		QString text = tabs[index].name;
-		text.replace("&", "&&");
-
-		if (m_tabline->count() <= index) {
-			m_tabline->addTab(text);
-		} else {
-			m_tabline->setTabText(index, text);
-		}
-
-		m_tabline->setTabData(index, QVariant::fromValue(tabs[index].tab));
-
-		if (curtab == tabs[index].tab) {
-			m_tabline->setCurrentIndex(index);
-		}
-	}
+	updateTabBar(m_tabline, curtab, tabs);
 
 	// hide/show the tabline toolbar
 	m_tabline_bar->setVisible(tabs.size() > 1);
-
-	Q_ASSERT(tabs.size() == m_tabline->count());
 }
 
 void MainWindow::changeTab(int index)
@@ -283,7 +276,7 @@ void MainWindow::changeTab(int index)
 		return;
 	}
 
-	int64_t tab = m_tabline->tabData(index).toInt();
+	int64_t tab = m_tabline->tabData(index).toLongLong();
 	m_nvim->api2()->nvim_set_current_tabpage(tab);
 }
 } // Namespace
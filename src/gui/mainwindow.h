@@ -4,9 +4,11 @@
 #include <QMainWindow>
 #include <QStackedWidget>
 #include <QTabBar>
+#include <QDockWidget>
 #include "neovimconnector.h"
 #include "errorwidget.h"
 #include "shell.h"
+#include "minimap.h"
 
 namespace NeovimQt {
 
@@ -55,6 +57,7 @@ private:
 	QTabBar *m_tabline;
 	QToolBar *m_tabline_bar;
 	ShellOptions m_shell_options;
+	QDockWidget *m_minimap_dock;
 };
 
 } // Namespace
@@ -0,0 +1,267 @@
+#include "minimap.h"
+#include <QDebug>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QRunnable>
+
+namespace NeovimQt {
+
+/// Height of a buffer line in pixels, when the whole buffer fits
+static const int LINE_HEIGHT = 2;
+/// Delay before rendering, to batch consecutive line events
+static const int RENDER_DELAY = 50;
+
+/// Renders a downsampled image of the buffer lines, each non blank
+/// character is a pixel
+class MinimapRenderer: public QRunnable
+{
+public:
+	MinimapRenderer(Minimap *target, quint64 generation, const LineRope& lines,
+			const QSize& size, const QColor& fg, const QColor& bg)
+	:m_target(target), m_generation(generation), m_lines(lines),
+	m_size(size), m_fg(fg), m_bg(bg) {}
+
+	virtual void run() Q_DECL_OVERRIDE {
+		int count = m_lines.size();
+		int height = qMin(m_size.height(), count*LINE_HEIGHT);
+		QImage img;
+		if (height > 0 && m_size.width() > 0) {
+			img = QImage(m_size.width(), height, QImage::Format_RGB32);
+			img.fill(m_bg);
+			render(img, count);
+		}
+		QMetaObject::invokeMethod(m_target, "renderFinished",
+				Qt::QueuedConnection,
+				Q_ARG(quint64, m_generation), Q_ARG(QImage, img),
+				Q_ARG(int, count));
+	}
+
+private:
+	void render(QImage& img, int count) {
+		QRgb fg = qRgb((m_fg.red() + m_bg.red())/2,
+				(m_fg.green() + m_bg.green())/2,
+				(m_fg.blue() + m_bg.blue())/2);
+		int rowsPerLine = count*LINE_HEIGHT <= img.height() ? LINE_HEIGHT : 1;
+		for (int y=0; y<img.height(); y+=rowsPerLine) {
+			// When the buffer does not fit, sample one line per pixel row
+			const QByteArray line = m_lines.line(
+					qint64(y / rowsPerLine) * count / (img.height() / rowsPerLine));
+			QRgb *row = reinterpret_cast<QRgb *>(img.scanLine(y));
+			int x = 0;
+			for (int i=0; i<line.size() && x<img.width(); i++) {
+				unsigned char c = line.at(i);
+				if (c == '\t') {
+					x += 8 - x % 8;
+					continue;
+				} else if ((c & 0xC0) == 0x80) {
+					// UTF-8 continuation byte
+					continue;
+				} else if (c > ' ') {
+					row[x] = fg;
+				}
+				x++;
+			}
+		}
+	}
+
+	Minimap *m_target;
+	quint64 m_generation;
+	LineRope m_lines;
+	QSize m_size;
+	QColor m_fg, m_bg;
+};
+
+/**
+ * \class NeovimQt::Minimap
+ *
+ * \brief An overview of the current buffer
+ *
+ * The buffer contents come from a BufferMirror, so the minimap does not
+ * poll Neovim for lines. The image is rendered in a background thread,
+ * from a copy of the mirrored lines. Clicking the minimap moves the cursor
+ * to that line.
+ *
+ * The minimap is controlled by the GuiMinimap() shim function.
+ */
+
+Minimap::Minimap(NeovimConnector *nvim, QWidget *parent)
+:QWidget(parent), m_nvim(nvim), m_mirror(nvim), m_buffer(0),
+	m_top(0), m_bottom(0), m_generation(0), m_imageLines(0)
+{
+	setAttribute(Qt::WA_OpaquePaintEvent);
+	setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
+	m_pool.setMaxThreadCount(1);
+
+	m_renderTimer.setSingleShot(true);
+	m_renderTimer.setInterval(RENDER_DELAY);
+	connect(&m_renderTimer, &QTimer::timeout,
+			this, &Minimap::render);
+	connect(&m_mirror, &BufferMirror::linesChanged,
+			this, &Minimap::bufferChanged);
+	connect(&m_mirror, &BufferMirror::detached,
+			this, &Minimap::bufferChanged);
+
+	if (!m_nvim) {
+		return;
+	}
+	connect(m_nvim, &NeovimConnector::ready,
+			this, &Minimap::init);
+	if (m_nvim->isReady()) {
+		init();
+	}
+}
+
+Minimap::~Minimap()
+{
+	// Pending results are dropped with this object
+	m_pool.clear();
+	m_pool.waitForDone();
+}
+
+void Minimap::init()
+{
+	if (!m_nvim->api0()) {
+		return;
+	}
+	connect(m_nvim->api0(), &NeovimApi0::neovimNotification,
+			&m_mirror, &BufferMirror::handleNeovimNotification);
+	connect(m_nvim->api0(), &NeovimApi0::neovimNotification,
+			this, &Minimap::handleNeovimNotification);
+}
+
+QSize Minimap::sizeHint() const
+{
+	return QSize(100, 100);
+}
+
+const BufferMirror& Minimap::mirror() const
+{
+	return m_mirror;
+}
+
+/// Handle the Gui Minimap events sent by the shim
+///
+/// - show {buffer}, hide: toggle the minimap
+/// - buffer {buffer}: the current buffer changed
+/// - viewport {top} {bottom}: lines in the current window
+void Minimap::handleNeovimNotification(const QByteArray& name, const QVariantList& args)
+{
+	if (name != "Gui" || args.size() < 2 ||
+			m_nvim->decode(args.at(0).toByteArray()) != "Minimap") {
+		return;
+	}
+
+	QString action = m_nvim->decode(args.at(1).toByteArray());
+	if (action == "show" && args.size() == 3) {
+		if (m_nvim->apiLevel() < 4) {
+			m_nvim->api0()->vim_report_error(m_nvim->encode(
+				"GuiMinimap: this Neovim version does not support nvim_buf_attach"));
+			return;
+		}
+		emit visibilityRequested(true);
+		setBuffer(args.at(2).toLongLong());
+	} else if (action == "hide") {
+		emit visibilityRequested(false);
+		m_buffer = 0;
+		m_mirror.detachAll();
+	} else if (action == "buffer" && args.size() == 3) {
+		if (m_buffer != 0) {
+			setBuffer(args.at(2).toLongLong());
+		}
+	} else if (action == "viewport" && args.size() == 4) {
+		m_top = args.at(2).toInt();
+		m_bottom = args.at(3).toInt();
+		update();
+	} else {
+		qWarning() << "Unexpected arguments for Gui Minimap" << args;
+	}
+}
+
+/// Show buffer. Buffers stay attached until the minimap is hidden, so
+/// switching back to a buffer does not transfer it again.
+void Minimap::setBuffer(qint64 buffer)
+{
+	m_buffer = buffer;
+	m_mirror.attach(buffer);
+	bufferChanged(buffer);
+}
+
+void Minimap::bufferChanged(qint64 buffer)
+{
+	if (buffer == m_buffer && !m_renderTimer.isActive()) {
+		m_renderTimer.start();
+	}
+}
+
+void Minimap::render()
+{
+	if (!isVisible()) {
+		return;
+	}
+	m_generation++;
+	m_pool.start(new MinimapRenderer(this, m_generation,
+			m_mirror.lines(m_buffer), size(),
+			palette().color(QPalette::Text),
+			palette().color(QPalette::Base)));
+}
+
+void Minimap::renderFinished(quint64 generation, const QImage& image, int lines)
+{
+	if (generation != m_generation) {
+		return;
+	}
+	m_image = image;
+	m_imageLines = lines;
+	update();
+}
+
+void Minimap::paintEvent(QPaintEvent *)
+{
+	QPainter p(this);
+	p.fillRect(rect(), palette().color(QPalette::Base));
+	if (m_image.isNull() || m_imageLines == 0) {
+		return;
+	}
+	p.drawImage(0, 0, m_image);
+
+	// The visible lines of the Neovim window
+	if (m_top > 0 && m_bottom >= m_top) {
+		int y0 = qint64(m_top - 1) * m_image.height() / m_imageLines;
+		int y1 = qint64(m_bottom) * m_image.height() / m_imageLines;
+		QColor c = palette().color(QPalette::Highlight);
+		c.setAlpha(60);
+		p.fillRect(QRect(0, y0, width(), qMax(1, y1 - y0)), c);
+	}
+}
+
+void Minimap::resizeEvent(QResizeEvent *ev)
+{
+	QWidget::resizeEvent(ev);
+	bufferChanged(m_buffer);
+}
+
+void Minimap::mousePressEvent(QMouseEvent *ev)
+{
+	gotoLine(ev->y());
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *ev)
+{
+	if (ev->buttons() & Qt::LeftButton) {
+		gotoLine(ev->y());
+	}
+}
+
+/// Move the Neovim cursor to the line shown at y
+void Minimap::gotoLine(int y)
+{
+	if (!m_nvim || !m_nvim->api0() || m_image.isNull() || m_imageLines == 0 ||
+			y < 0 || y >= m_image.height()) {
+		return;
+	}
+	int line = qint64(y) * m_imageLines / m_image.height() + 1;
+	m_nvim->api0()->vim_command(m_nvim->encode(
+			QString("call cursor(%1, 1)").arg(line)));
+}
+
+} // Namespace
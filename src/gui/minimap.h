@@ -0,0 +1,64 @@
+#ifndef NEOVIM_QT_MINIMAP
+#define NEOVIM_QT_MINIMAP
+
+#include <QWidget>
+#include <QImage>
+#include <QThreadPool>
+#include <QTimer>
+#include "neovimconnector.h"
+#include "buffermirror.h"
+
+namespace NeovimQt {
+
+class Minimap: public QWidget
+{
+	Q_OBJECT
+public:
+	Minimap(NeovimConnector *nvim, QWidget *parent=0);
+	~Minimap();
+	virtual QSize sizeHint() const Q_DECL_OVERRIDE;
+	const BufferMirror& mirror() const;
+
+signals:
+	/// Neovim asked to show or hide the minimap, see GuiMinimap()
+	void visibilityRequested(bool);
+
+public slots:
+	void handleNeovimNotification(const QByteArray& name, const QVariantList& args);
+
+protected slots:
+	void init();
+
+protected:
+	virtual void paintEvent(QPaintEvent *ev) Q_DECL_OVERRIDE;
+	virtual void resizeEvent(QResizeEvent *ev) Q_DECL_OVERRIDE;
+	virtual void mousePressEvent(QMouseEvent *ev) Q_DECL_OVERRIDE;
+	virtual void mouseMoveEvent(QMouseEvent *ev) Q_DECL_OVERRIDE;
+
+private slots:
+	void bufferChanged(qint64 buffer);
+	void render();
+	void renderFinished(quint64 generation, const QImage& image, int lines);
+
+private:
+	void setBuffer(qint64 buffer);
+	void gotoLine(int y);
+
+	NeovimConnector *m_nvim;
+	BufferMirror m_mirror;
+	/// The buffer shown in the minimap, 0 if none
+	qint64 m_buffer;
+	/// First and last line (1-based) in the Neovim window
+	int m_top, m_bottom;
+	QTimer m_renderTimer;
+	/// Rendering runs in a single background thread
+	QThreadPool m_pool;
+	/// Incremented for each render, older results are dropped
+	quint64 m_generation;
+	QImage m_image;
+	/// Number of buffer lines in m_image
+	int m_imageLines;
+};
+
+} // Namespace
+#endif
@@ -1,25 +1,20 @@
 #include "popupmenu.h"
 #include "args_conv.h"
+#include "konsole_wcwidth.h"
 
-#include <QTableWidget>
+#include <QAbstractTableModel>
+#include <QTableView>
 #include <QHeaderView>
+#include <QStyle>
 #include <QScrollBar>
 #include <QGraphicsDropShadowEffect>
+#include <QHash>
+#include <QBrush>
 #include <QDebug>
-#include <map>
 
 namespace NeovimQt {
 namespace {
 
-inline QTableWidgetItem* getKindItem(QString const& kind,
-    PopupMenu::KindConfig const& config) {
-  auto def = config.value(kind.toLower(), {kind, "#232323"});
-  auto* item = new QTableWidgetItem(def[0]);
-  item->setBackground(QBrush(QColor(def[1])));
-  item->setTextAlignment(Qt::AlignHCenter|Qt::AlignBottom);
-  return item;
-}
-
 PopupMenu::KindConfig const defaultKindConfig {
   { "text", {"tx", "#076678"}},
   { "method", {"mt", "#79740e"}},
@@ -53,32 +48,189 @@ PopupMenu::Item convertItem(QVariantList const& from) {
   return item;
 }
 
+int const kindColIdx = 0;
 int const wordColIdx = 1;
 int const menuColIdx = 2;
+int const colCount = 3;
 }
 
 
-class PopupMenuTableWidget
-  : public QTableWidget {
+/// Lazy model over the completion items, nothing is materialised per item:
+/// the view only asks for the rows it is about to paint.
+class PopupMenuModel
+  : public QAbstractTableModel {
 
 public:
-  PopupMenuTableWidget(QWidget* parent)
-    : QTableWidget(parent) {
+  struct KindBadge {
+    QString abbr;
+    QBrush brush;
+  };
+
+  PopupMenuModel(QObject* parent)
+    : QAbstractTableModel(parent),
+      selected(-1),
+      longest(colCount),
+      unknownKindBrush(QColor("#232323")),
+      selectedBrush(QColor("#4a4a4a")) {
+    setKindConfig(defaultKindConfig);
+  }
+
+  int rowCount(QModelIndex const& parent = QModelIndex()) const override {
+    return parent.isValid() ? 0 : items.size();
+  }
+
+  int columnCount(QModelIndex const& parent = QModelIndex()) const override {
+    return parent.isValid() ? 0 : colCount;
+  }
+
+  QVariant data(QModelIndex const& index, int role) const override {
+    if(!index.isValid() || index.row() >= items.size()) {
+      return QVariant();
+    }
+    auto const& item = items[index.row()];
+    switch(role) {
+    case Qt::DisplayRole:
+      if(index.column() == kindColIdx) { return kindBadge(item.kind).abbr; }
+      if(index.column() == wordColIdx) { return QString(' ') + item.word; }
+      return item.menu.trimmed();
+    case Qt::BackgroundRole:
+      if(index.column() == kindColIdx) { return kindBadge(item.kind).brush; }
+      if(index.row() == selected) { return selectedBrush; }
+      break;
+    case Qt::TextAlignmentRole:
+      if(index.column() == kindColIdx) {
+        return static_cast<int>(Qt::AlignHCenter|Qt::AlignBottom);
+      }
+      break;
+    }
+    return QVariant();
+  }
+
+  void setItems(PopupMenu::Items newItems, int newSelected) {
+    beginResetModel();
+    items = std::move(newItems);
+    selected = newSelected;
+    updateLongest();
+    endResetModel();
+  }
+
+  void clear() {
+    setItems(PopupMenu::Items(), -1);
+  }
+
+  /// Only the rows of the previous and the new selection are repainted
+  void setSelected(int row) {
+    if(row == selected) { return; }
+    auto previous = selected;
+    selected = row;
+    rowChanged(previous);
+    rowChanged(selected);
+  }
+
+  int selectedRow() const { return selected; }
+
+  void setKindConfig(PopupMenu::KindConfig const& config) {
+    badges.clear();
+    for(auto it = config.constBegin(); it != config.constEnd(); ++it) {
+      badges.insert(it.key().toLower(),
+          KindBadge{it.value().value(0), QBrush(QColor(it.value().value(1)))});
+    }
+    if(!items.isEmpty()) {
+      updateLongest();
+      emit dataChanged(index(0, kindColIdx), index(items.size()-1, kindColIdx));
+    }
+  }
+
+  void setSelectedColor(QColor const& color) {
+    selectedBrush = QBrush(color);
+    rowChanged(selected);
+  }
+
+  /// The widest text of a column in terminal cells (double width
+  /// characters count as two), used to size the column without measuring
+  /// every item
+  QString const& longestText(int col) const { return longest[col]; }
+
+private:
+  KindBadge kindBadge(QString const& kind) const {
+    auto it = badges.constFind(kind.toLower());
+    if(it != badges.constEnd()) {
+      return *it;
+    }
+    return KindBadge{kind, unknownKindBrush};
+  }
+
+  void updateLongest() {
+    longest.fill(QString());
+    int wordIdx = -1, menuIdx = -1;
+    int wordWidth = -1, menuWidth = -1, kindWidth = 0;
+    for(int idx = 0; idx < items.size(); idx++) {
+      auto const& item = items[idx];
+      auto width = string_width(item.word);
+      if(width > wordWidth) {
+        wordIdx = idx;
+        wordWidth = width;
+      }
+      width = string_width(item.menu);
+      if(width > menuWidth) {
+        menuIdx = idx;
+        menuWidth = width;
+      }
+      auto abbr = kindBadge(item.kind).abbr;
+      width = string_width(abbr);
+      if(width > kindWidth) {
+        longest[kindColIdx] = abbr;
+        kindWidth = width;
+      }
+    }
+    if(wordIdx >= 0) {
+      longest[wordColIdx] = QString(' ') + items[wordIdx].word;
+      longest[menuColIdx] = items[menuIdx].menu.trimmed();
+    }
+  }
+
+  void rowChanged(int row) {
+    if(row >= 0 && row < items.size()) {
+      emit dataChanged(index(row, wordColIdx), index(row, menuColIdx),
+          {Qt::BackgroundRole});
+    }
+  }
+
+  PopupMenu::Items items;
+  int selected;
+  QVector<QString> longest;
+  QHash<QString, KindBadge> badges;
+  QBrush unknownKindBrush;
+  QBrush selectedBrush;
+};
+
+
+class PopupMenuView
+  : public QTableView {
+
+public:
+  PopupMenuView(QWidget* parent)
+    : QTableView(parent),
+      measured(colCount),
+      measuredWidth(colCount, 0) {
     verticalHeader()->hide();
     horizontalHeader()->hide();
     setSortingEnabled(false);
-    setSelectionBehavior(QAbstractItemView::SelectRows);
+    setSelectionMode(QAbstractItemView::NoSelection);
     setEditTriggers(QAbstractItemView::NoEditTriggers);
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    setSelectionMode(QAbstractItemView::SingleSelection);
     setShowGrid(true);
     setTabKeyNavigation(false);
     setVerticalScrollMode(QAbstractItemView::ScrollPerItem);
     setContentsMargins(0, 0, 0, 0);
     setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
+    setWordWrap(false);
 
-    horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
-    verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    // Fixed sections keep the view from measuring every row, only the
+    // visible rows are ever asked for data
+    horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    verticalHeader()->setMinimumSectionSize(1);
     setFocusPolicy(Qt::NoFocus);
     setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
 
@@ -90,8 +242,8 @@ public:
   }
 
   QSize sizeHint() const override {
-    auto sh = QTableWidget::sizeHint();
-    auto rCount = static_cast<std::uint32_t>(rowCount());
+    auto sh = QTableView::sizeHint();
+    auto rCount = static_cast<std::uint32_t>(model()->rowCount());
     if (rCount > PopupMenu::visibleRowCount) {
       static const std::uint32_t scrollbarWidth = 8;
       sh.setWidth(sh.width() + scrollbarWidth);
@@ -103,6 +255,25 @@ public:
     setColumnHidden(menuColIdx, !state);
   }
 
+  /// Size rows and columns from the font and the longest text per column,
+  /// a column is only measured again if its longest text changed
+  void updateSections(PopupMenuModel const& menuModel) {
+    QFontMetrics fm(font());
+    int margin = (style()->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, this) + 1) * 2;
+    for(int col = 0; col < colCount; col++) {
+      auto const& text = menuModel.longestText(col);
+      if(text != measured[col] || measuredWidth[col] == 0) {
+        measured[col] = text;
+        measuredWidth[col] = fm.width(text) + margin;
+      }
+      horizontalHeader()->resizeSection(col, measuredWidth[col]);
+    }
+    auto height = fm.height() + 2;
+    if(verticalHeader()->defaultSectionSize() != height) {
+      verticalHeader()->setDefaultSectionSize(height);
+    }
+  }
+
   void mousePressEvent(QMouseEvent*) override {}
   void mouseReleaseEvent(QMouseEvent*) override {}
   void mouseDoubleClickEvent(QMouseEvent*) override {}
@@ -110,11 +281,9 @@ public:
 
   void updateStyle(PopupMenu::ColorConfig const& config) {
     setStyleSheet(QString("color: %1;"
-        " background-color: %2;"
-        " selection-background-color: %3;")
+        " background-color: %2;")
         .arg(config.value("foreground", "#fdf4c1"))
-        .arg(config.value("background", "#393939"))
-        .arg(config.value("selected", "#4a4a4a")) );
+        .arg(config.value("background", "#393939")) );
 
     QScrollBar* sb = verticalScrollBar();
     sb->setStyleSheet(QString(
@@ -127,6 +296,18 @@ public:
         .arg(config.value("scrollbar-background", "#000000")) );
 
   }
+
+protected:
+  void changeEvent(QEvent* ev) override {
+    if(ev->type() == QEvent::FontChange) {
+      measuredWidth.fill(0);
+    }
+    QTableView::changeEvent(ev);
+  }
+
+private:
+  QVector<QString> measured;
+  QVector<int> measuredWidth;
 };
 
 
@@ -135,19 +316,13 @@ const std::uint32_t PopupMenu::visibleRowCount = 15;
 PopupMenu::PopupMenu(QWidget* parent,
     GetCellSize cellSizeGetter)
   : editorWindow(parent),
-    widget(new PopupMenuTableWidget(parent)),
+    model(new PopupMenuModel(parent)),
+    widget(new PopupMenuView(parent)),
     getCellSize(cellSizeGetter),
-    selected(-1),
-    kindConfig(defaultKindConfig),
     styleSet(false) {
 
     widget->hide();
-    widget->setColumnCount(3);
-
-    QHeaderView* hdr = widget->horizontalHeader();
-    hdr->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    hdr->setSectionResizeMode(1, QHeaderView::ResizeToContents);
-    hdr->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+    widget->setModel(model);
   }
 
 void PopupMenu::show(Items items,
@@ -155,49 +330,25 @@ void PopupMenu::show(Items items,
     std::uint32_t row,
     std::uint32_t col) {
   if(items.isEmpty()) { return; }
-  addItems(items);
-  setWindowHeight(items.size());
+  auto count = items.size();
+  model->setItems(std::move(items), -1);
+  widget->updateSections(*model);
+  setWindowHeight(count);
   select(selectIdx);
   moveWindow(row, col);
   showWindow();
 }
 
 void PopupMenu::select(Idx newselected) {
-  if(widget->isVisible() && selected >= 0) {
-    setSelection(false);
-  }
-  selected = newselected;
-  if(selected >= 0) {
-    setSelection(true);
-    widget->scrollToItem(widget->item(selected, 0));
+  model->setSelected(newselected);
+  if(newselected >= 0) {
+    widget->scrollTo(model->index(newselected, wordColIdx));
   }
 }
 
 void PopupMenu::hide() {
   widget->hide();
-  widget->clearContents();
-}
-
-void PopupMenu::addItem(std::uint32_t row, Item const& item) {
-  widget->setItem(row, 0, getKindItem(item.kind, kindConfig));
-  widget->setItem(row, wordColIdx, new QTableWidgetItem(QString(' ') + item.word));
-  widget->setItem(row, menuColIdx, new QTableWidgetItem(item.menu.trimmed()));
-}
-
-void PopupMenu::addItems(Items const& items) {
-  widget->clearContents();
-  widget->setRowCount(items.size());
-  std::uint32_t idx = 0;
-  for(auto const& item: items) {
-    addItem(idx++, item);
-  }
-}
-
-void PopupMenu::setSelection(bool state) {
-  if(widget->rowCount() > selected) {
-    widget->item(selected, wordColIdx)->setSelected(state);
-    widget->item(selected, menuColIdx)->setSelected(state);
-  }
+  model->clear();
 }
 
 void PopupMenu::moveWindow(std::uint32_t row, std::uint32_t col) {
@@ -225,11 +376,13 @@ void PopupMenu::setWindowHeight(std::uint32_t items) {
 
 void PopupMenu::setStyle(ColorConfig const& colors) {
   widget->updateStyle(colors);
+  model->setSelectedColor(QColor(colors.value("selected", "#4a4a4a")));
   styleSet = true;
 }
 
 void PopupMenu::setKindConfig(KindConfig const& newKindConfig) {
-  kindConfig = newKindConfig;
+  model->setKindConfig(newKindConfig);
+  widget->updateSections(*model);
 }
 
 void PopupMenu::setMenuColVisible(bool state) {
@@ -238,8 +391,7 @@ void PopupMenu::setMenuColVisible(bool state) {
 
 void PopupMenu::initStyleIfNotConfigured() {
   if(!styleSet) {
-    widget->updateStyle(ColorConfig());
-    styleSet = true;
+    setStyle(ColorConfig());
   }
 }
 
@@ -12,12 +12,12 @@
 #include <functional>
 #include <cstdint>
 
-class QTableWidget;
 class QWidget;
 
 namespace NeovimQt {
 
-class PopupMenuTableWidget;
+class PopupMenuView;
+class PopupMenuModel;
 
 class PopupMenu {
 public:
@@ -50,19 +50,15 @@ public:
   void hide();
 
 private:
-  void addItem(std::uint32_t row, Item const& item);
-  void addItems(Items const& items);
-  void setSelection(bool state);
   void showWindow();
   void setWindowHeight(std::uint32_t items);
   void initStyleIfNotConfigured();
   void moveWindow(std::uint32_t row, std::uint32_t col);
 
   QWidget* editorWindow;
-  PopupMenuTableWidget* widget;
+  PopupMenuModel* model;
+  PopupMenuView* widget;
   GetCellSize getCellSize;
-  int selected;
-  KindConfig kindConfig;
   bool styleSet;
 };
 
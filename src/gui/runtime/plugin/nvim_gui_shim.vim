@@ -43,6 +43,43 @@ function! GuiMousehide(enabled) abort
   call rpcnotify(0, 'Gui', 'Mousehide', a:enabled)
 endfunction
 
+" Ask the GUI to store its frame counters in g:GuiFrameStats
+function! GuiFrameStats() abort
+  call rpcnotify(0, 'Gui', 'FrameStats')
+endfunction
+
+" Returns the GUI RPC traffic counters, a dictionary of method names
+" to counters
+function! GuiRpcStats() abort
+  if !exists('g:GuiChannel')
+    throw 'GuiRpcStats: g:GuiChannel is not set'
+  endif
+  return rpcrequest(g:GuiChannel, 'Gui', 'RpcStats')
+endfunction
+
+" Trace input latency, see :help GuiTrace
+function! GuiTrace(action, ...) abort
+  call rpcnotify(0, 'Gui', 'Trace', a:action, get(a:000, 0, ''))
+endfunction
+command! -nargs=+ -complete=file GuiTrace call GuiTrace(<f-args>)
+
+" Show a minimap of the current buffer (1 is enabled, 0 disabled)
+function! GuiMinimap(enabled) abort
+  augroup GuiMinimap
+    autocmd!
+    if a:enabled
+      autocmd BufEnter * call rpcnotify(0, 'Gui', 'Minimap', 'buffer', bufnr('%'))
+      autocmd CursorMoved,CursorMovedI,VimResized * call rpcnotify(0, 'Gui', 'Minimap', 'viewport', line('w0'), line('w$'))
+    endif
+  augroup END
+  if a:enabled
+    call rpcnotify(0, 'Gui', 'Minimap', 'show', bufnr('%'))
+    call rpcnotify(0, 'Gui', 'Minimap', 'viewport', line('w0'), line('w$'))
+  else
+    call rpcnotify(0, 'Gui', 'Minimap', 'hide')
+  endif
+endfunction
+
 " The GuiFont command. For compatibility there is also Guifont
 function s:GuiFontCommand(fname, bang) abort
   if a:fname ==# ''
@@ -7,10 +7,12 @@
 #include <QApplication>
 #include <QKeyEvent>
 #include <QMimeData>
+#include <QElapsedTimer>
 #include "msgpackrequest.h"
 #include "input.h"
 #include "konsole_wcwidth.h"
 #include "util.h"
+#include "latencytrace.h"
 
 namespace NeovimQt {
 
@@ -20,10 +22,12 @@ Shell::Shell(NeovimConnector *nvim, ShellOptions opts, QWidget *parent)
 	m_mouseHide(true),
 	m_hg_foreground(Qt::black), m_hg_background(Qt::white), m_hg_special(QColor()),
 	m_cursor_color(Qt::white), m_cursor_pos(0,0), m_insertMode(false),
+	m_cursor_style_enabled(false), m_mode_idx(-1), m_cursor_visible(true),
 	m_resizing(false),
 	m_mouse_wheel_delta_fraction(0, 0),
 	m_neovimBusy(false),
 	m_options(opts),
+	m_multigrid(false), m_cursor_grid(1), m_shm(NULL), m_shm_resync(false),
   m_popupmenu(this, [this]{ return cellSize(); }),
   m_signature(this, [this]{ return cellSize(); }, [this] { return m_cursor_pos; })
 {
@@ -31,10 +35,16 @@ Shell::Shell(NeovimConnector *nvim, ShellOptions opts, QWidget *parent)
 
 	setAcceptDrops(true);
 	setMouseTracking(true);
+	// Frames are committed after each redraw batch, see
+	// handleNeovimNotification
+	frameScheduler()->setAutoCommit(false);
 	m_mouseclick_timer.setInterval(QApplication::doubleClickInterval());
 	m_mouseclick_timer.setSingleShot(true);
 	connect(&m_mouseclick_timer, &QTimer::timeout,
 			this, &Shell::mouseClickReset);
+	m_cursor_blink.setSingleShot(true);
+	connect(&m_cursor_blink, &QTimer::timeout,
+			this, &Shell::cursorBlink);
 
 	// IM Tooltip
 	setAttribute(Qt::WA_InputMethodEnabled, true);
@@ -129,6 +139,8 @@ Shell::~Shell()
 	if (m_nvim && m_attached) {
 		m_nvim->api0()->ui_detach();
 	}
+	qDeleteAll(m_grids);
+	delete m_shm;
 }
 
 void Shell::setAttached(bool attached)
@@ -137,6 +149,7 @@ void Shell::setAttached(bool attached)
 	if (attached) {
 		updateWindowId();
 		m_nvim->api0()->vim_set_var("GuiFont", fontDesc());
+		m_nvim->api0()->vim_set_var("GuiChannel", QVariant((quint64)m_nvim->channel()));
 
 		if (isWindow()) {
 			updateGuiWindowState(windowState());
@@ -172,9 +185,10 @@ QRect Shell::neovimCursorRect() const
 /// position
 QRect Shell::neovimCursorRect(QPoint at) const
 {
-	const Cell& c = contents().constValue(at.y(), at.x());
+	const Cell& c = shellCell(at);
 	bool wide = c.doubleWidth;
-	QRect r(neovimCursorTopLeft(), cellSize());
+	QRect r(QPoint(at.x()*cellSize().width(), at.y()*cellSize().height()),
+			cellSize());
 	if (wide) {
 		r.setWidth(r.width()*2);
 	}
@@ -203,6 +217,27 @@ void Shell::init()
 	}
   options.insert("ext_popupmenu", true);
 	options.insert("rgb", true);
+	if (m_options.enable_ext_multigrid && m_nvim->hasUIOption("ext_multigrid")) {
+		options.insert("ext_linegrid", true);
+		options.insert("ext_multigrid", true);
+		m_multigrid = true;
+	}
+	if (m_options.enable_shm_grid && !m_multigrid && m_nvim->api2()
+			&& m_nvim->connectionType() == NeovimConnector::SpawnedConnection) {
+		// Room for the whole desktop, the grid is sent as grid_line
+		// events while it is larger than this
+		QRect desktop = QApplication::desktop()->geometry();
+		int shm_rows = qMax(60, desktop.height()/cellSize().height());
+		int shm_cols = qMax(200, desktop.width()/cellSize().width());
+		m_shm = new ShmGrid();
+		if (m_shm->create(shm_rows, shm_cols)) {
+			options.insert("ext_newgrid", true);
+			options.insert("shm_path", m_shm->path());
+		} else {
+			delete m_shm;
+			m_shm = NULL;
+		}
+	}
 
 	MsgpackRequest *req;
 	if (m_nvim->api2()) {
@@ -220,6 +255,7 @@ void Shell::init()
 
 	// Subscribe to GUI events
 	m_nvim->api0()->vim_subscribe("Gui");
+	m_nvim->setRequestHandler(this);
 }
 
 void Shell::neovimError(NeovimConnector::NeovimError err)
@@ -301,10 +337,8 @@ void Shell::handlePut(const QVariantList& args)
 				m_hg_foreground, m_hg_background, m_hg_special,
 				m_font_bold, m_font_italic,
 				m_font_underline, m_font_undercurl);
-		// Move cursor ahead
-		update(neovimCursorRect());
+		// Move cursor ahead, the cells were already damaged by put()
 		setNeovimCursor(m_cursor_pos.y(), m_cursor_pos.x()+cols);
-		update(neovimCursorRect());
 	}
 
 }
@@ -326,18 +360,18 @@ void Shell::handleScroll(const QVariantList& args)
 	}
 	qint64 count = args.at(0).toULongLong();
 
-	// Keep track of the cursor position, repaint
-	// over its old position after the scroll
-	if (m_scroll_region.contains(m_cursor_pos)) {
-		QPoint old_cursor_pos = m_cursor_pos;
-		old_cursor_pos.setY(old_cursor_pos.y()-count);
-		QRect cr = neovimCursorRect(old_cursor_pos);
-		update(cr);
-	}
-
 	scrollShellRegion(m_scroll_region.top(), m_scroll_region.bottom(),
 			m_scroll_region.left(), m_scroll_region.right(),
 			count);
+
+	// The painted cursor is scrolled along with the cells, restore
+	// the cells where it ends up and paint it again in place
+	if (m_scroll_region.contains(m_cursor_pos)) {
+		QPoint scrolled_cursor_pos = m_cursor_pos;
+		scrolled_cursor_pos.setY(scrolled_cursor_pos.y()-count);
+		damageOverlay(neovimCursorRect(scrolled_cursor_pos));
+		damageOverlay(neovimCursorRect());
+	}
 }
 
 void Shell::handleSetScrollRegion(const QVariantList& opargs)
@@ -380,7 +414,7 @@ void Shell::handleRedraw(const QByteArray& name, const QVariantList& opargs)
 			setBackground(QRgb(val));
 		}
 		m_hg_background = background();
-		update();
+		frameScheduler()->damageAll();
 	} else if (name == "update_sp") {
 		if (opargs.size() < 1 || !opargs.at(0).canConvert<quint64>()) {
 			qWarning() << "Unexpected arguments for redraw:" << name << opargs;
@@ -428,13 +462,19 @@ void Shell::handleRedraw(const QByteArray& name, const QVariantList& opargs)
 		// See :h mouse
 	} else if (name == "mouse_off"){
 		// See :h mouse
+	} else if (name == "mode_info_set"){
+		handleModeInfoSet(opargs);
 	} else if (name == "mode_change"){
 		if (opargs.size() < 1 || !opargs.at(0).canConvert<QByteArray>()) {
 			qWarning() << "Unexpected argument for change_mode:" << opargs;
 			return;
 		}
 		QString mode = m_nvim->decode(opargs.at(0).toByteArray());
-		handleModeChange(mode);
+		int mode_idx = -1;
+		if (opargs.size() > 1 && opargs.at(1).canConvert<qint64>()) {
+			mode_idx = opargs.at(1).toInt();
+		}
+		handleModeChange(mode, mode_idx);
 	} else if (name == "cursor_on"){
 	} else if (name == "set_title"){
 		handleSetTitle(opargs);
@@ -474,20 +514,532 @@ void Shell::handleRedraw(const QByteArray& name, const QVariantList& opargs)
     return m_popupmenu.select(opargs);
 	} else if (name == "popupmenu_hide") {
     m_popupmenu.hide();
+	} else if (name == "default_colors_set") {
+		handleDefaultColorsSet(opargs);
+	} else if (name == "hl_attr_define") {
+		handleHlAttrDefine(opargs);
+	} else if (name == "grid_resize") {
+		handleGridResize(opargs);
+	} else if (name == "grid_clear") {
+		handleGridClear(opargs);
+	} else if (name == "grid_cursor_goto") {
+		handleGridCursorGoto(opargs);
+	} else if (name == "grid_line") {
+		handleGridLine(opargs);
+	} else if (name == "grid_scroll") {
+		handleGridScroll(opargs);
+	} else if (name == "grid_destroy") {
+		handleGridDestroy(opargs);
+	} else if (name == "win_pos") {
+		handleWinPos(opargs);
+	} else if (name == "win_float_pos") {
+		handleWinFloatPos(opargs);
+	} else if (name == "win_hide" || name == "win_close") {
+		handleWinHide(opargs);
+	} else if (name == "msg_set_pos") {
+		handleMsgSetPos(opargs);
+	} else if (name == "grid_shm") {
+		handleGridShm(opargs);
+	} else if (name == "flush") {
+		frameScheduler()->commit();
+		LatencyTrace::mark(LatencyTrace::FlushApplied);
+	} else if (name == "win_external_pos") {
 	} else {
 		qDebug() << "Received unknown redraw notification" << name << opargs;
 	}
 
 }
 
+/// True if the first count arguments can be used as integers
+static bool checkIntArgs(const QVariantList& opargs, int count)
+{
+	if (opargs.size() < count) {
+		return false;
+	}
+	for (int i=0; i<count; i++) {
+		if (!opargs.at(i).canConvert<qint64>()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Shell::handleDefaultColorsSet(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 3)) {
+		qWarning() << "Unexpected arguments for redraw:default_colors_set" << opargs;
+		return;
+	}
+	qint64 fg = opargs.at(0).toLongLong();
+	qint64 bg = opargs.at(1).toLongLong();
+	qint64 sp = opargs.at(2).toLongLong();
+	if (fg != -1) {
+		setForeground(QRgb(fg));
+	}
+	if (bg != -1) {
+		setBackground(QRgb(bg));
+	}
+	if (sp != -1) {
+		setSpecial(QRgb(sp));
+	}
+	m_hg_foreground = foreground();
+	m_hg_background = background();
+	m_hg_special = special();
+	frameScheduler()->damageAll();
+}
+
+void Shell::handleHlAttrDefine(const QVariantList& opargs)
+{
+	if (opargs.size() < 2 || !opargs.at(0).canConvert<qint64>() ||
+			(QMetaType::Type)opargs.at(1).type() != QMetaType::QVariantMap) {
+		qWarning() << "Unexpected arguments for redraw:hl_attr_define" << opargs;
+		return;
+	}
+
+	const QVariantMap& attrs = opargs.at(1).toMap();
+	HighlightAttr hl;
+	if (attrs.contains("foreground")) {
+		hl.foreground = color(attrs.value("foreground").toLongLong());
+	}
+	if (attrs.contains("background")) {
+		hl.background = color(attrs.value("background").toLongLong());
+	}
+	if (attrs.contains("special")) {
+		hl.special = color(attrs.value("special").toLongLong());
+	}
+	hl.reverse = attrs.value("reverse").toBool();
+	hl.bold = attrs.value("bold").toBool();
+	hl.italic = attrs.value("italic").toBool();
+	hl.underline = attrs.value("underline").toBool();
+	hl.undercurl = attrs.value("undercurl").toBool();
+	m_hl_attrs.insert(opargs.at(0).toLongLong(), hl);
+}
+
+void Shell::handleGridResize(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 3)) {
+		qWarning() << "Unexpected arguments for redraw:grid_resize" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	int n_cols = opargs.at(1).toInt();
+	int n_rows = opargs.at(2).toInt();
+	if (grid == 1) {
+		handleResize(n_cols, n_rows);
+		return;
+	}
+
+	ShellGrid *g = m_grids.value(grid);
+	if (!g) {
+		g = new ShellGrid(n_rows, n_cols);
+		m_grids.insert(grid, g);
+		m_grid_order.append(grid);
+		return;
+	}
+	if (g->isVisible()) {
+		frameScheduler()->damage(gridRect(g));
+	}
+	g->resize(n_rows, n_cols);
+	if (g->isVisible()) {
+		frameScheduler()->damage(gridRect(g));
+	}
+}
+
+void Shell::handleGridClear(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 1)) {
+		qWarning() << "Unexpected arguments for redraw:grid_clear" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	if (grid == 1) {
+		clearShell(background());
+		return;
+	}
+
+	ShellGrid *g = m_grids.value(grid);
+	if (g) {
+		g->clear(background());
+		if (g->isVisible()) {
+			frameScheduler()->damage(gridRect(g));
+		}
+	}
+}
+
+void Shell::handleGridCursorGoto(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 3)) {
+		qWarning() << "Unexpected arguments for redraw:grid_cursor_goto" << opargs;
+		return;
+	}
+	m_cursor_grid = opargs.at(0).toLongLong();
+	m_grid_cursor_pos = QPoint(opargs.at(2).toInt(), opargs.at(1).toInt());
+	updateGridCursor();
+}
+
+/// Move the shell cursor to the cursor position in its grid, e.g. after the
+/// cursor grid was moved
+void Shell::updateGridCursor()
+{
+	QPoint pos = m_grid_cursor_pos;
+	ShellGrid *g = m_grids.value(m_cursor_grid);
+	if (g) {
+		pos += g->position();
+	}
+	setNeovimCursor(pos.y(), pos.x());
+}
+
+/// [grid, row, col_start, [[text, hl_id, repeat], ...]]
+///
+/// The hl_id and repeat items are optional, if hl_id is missing the
+/// previous one is used.
+void Shell::handleGridLine(const QVariantList& opargs)
+{
+	if (opargs.size() < 4 || !checkIntArgs(opargs, 3) ||
+			(QMetaType::Type)opargs.at(3).type() != QMetaType::QVariantList) {
+		qWarning() << "Unexpected arguments for redraw:grid_line" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	int row = opargs.at(1).toInt();
+	int col = opargs.at(2).toInt();
+	if (grid != 1 && !m_grids.contains(grid)) {
+		qWarning() << "Received redraw:grid_line for unknown grid" << grid;
+		return;
+	}
+
+	qint64 hl_id = 0;
+	foreach(const QVariant& cellv, opargs.at(3).toList()) {
+		const QVariantList& cell = cellv.toList();
+		if (cell.isEmpty()) {
+			qWarning() << "Unexpected cell in redraw:grid_line" << cellv;
+			return;
+		}
+		if (cell.size() > 1) {
+			hl_id = cell.at(1).toLongLong();
+		}
+		int repeat = cell.size() > 2 ? cell.at(2).toInt() : 1;
+
+		// Empty cells follow double width characters, those were
+		// already written along with the character
+		QString text = m_nvim->decode(cell.at(0).toByteArray());
+		if (!text.isEmpty() && repeat > 0) {
+			putGrid(grid, text.repeated(repeat), row, col, hl_id);
+		}
+		col += repeat;
+	}
+}
+
+void Shell::putGrid(qint64 grid, const QString& text, int row, int col,
+		qint64 hl_id)
+{
+	const HighlightAttr& hl = m_hl_attrs.value(hl_id);
+	QColor fg = hl.foreground.isValid() ? hl.foreground : foreground();
+	QColor bg = hl.background.isValid() ? hl.background : background();
+	QColor sp = hl.special.isValid() ? hl.special : special();
+	if (hl.reverse) {
+		qSwap(fg, bg);
+	}
+
+	ShellGrid *g = m_grids.value(grid);
+	if (!g) {
+		put(text, row, col, fg, bg, sp, hl.bold, hl.italic,
+				hl.underline, hl.undercurl);
+		return;
+	}
+
+	int cols = g->put(text, row, col, fg, bg, sp, hl.bold, hl.italic,
+				hl.underline, hl.undercurl);
+	if (cols > 0 && g->isVisible()) {
+		frameScheduler()->damage(gridRect(g, row, col, 1, cols));
+	}
+}
+
+/// [grid, top, bot, left, right, rows, cols]
+///
+/// Only the pixels of the scrolled grid are touched, other windows are
+/// neither redrawn nor repainted.
+void Shell::handleGridScroll(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 6)) {
+		qWarning() << "Unexpected arguments for redraw:grid_scroll" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	int top = opargs.at(1).toInt();
+	int bot = opargs.at(2).toInt();
+	int left = opargs.at(3).toInt();
+	int right = opargs.at(4).toInt();
+	int count = opargs.at(5).toInt();
+
+	if (grid == 1) {
+		scrollShellRegion(top, bot, left, right, count);
+		// QWidget::scroll also moved the pixels of windows composited
+		// over grid 1
+		if (!m_grids.isEmpty()) {
+			frameScheduler()->damage(absoluteShellRect(top, left, bot-top, right-left));
+		}
+		return;
+	}
+
+	ShellGrid *g = m_grids.value(grid);
+	if (g) {
+		g->scrollRegion(top, bot, left, right, count);
+		if (g->isVisible()) {
+			frameScheduler()->damage(gridRect(g, top, left, bot-top, right-left));
+		}
+	}
+}
+
+void Shell::handleGridDestroy(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 1)) {
+		qWarning() << "Unexpected arguments for redraw:grid_destroy" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	ShellGrid *g = m_grids.take(grid);
+	if (g) {
+		if (g->isVisible()) {
+			frameScheduler()->damage(gridRect(g));
+		}
+		m_grid_order.removeOne(grid);
+		delete g;
+	}
+}
+
+/// [grid, win, start_row, start_col, width, height]
+void Shell::handleWinPos(const QVariantList& opargs)
+{
+	if (opargs.size() < 6 || !opargs.at(0).canConvert<qint64>() ||
+			!opargs.at(2).canConvert<qint64>() ||
+			!opargs.at(3).canConvert<qint64>()) {
+		qWarning() << "Unexpected arguments for redraw:win_pos" << opargs;
+		return;
+	}
+	placeGrid(opargs.at(0).toLongLong(), opargs.at(2).toInt(),
+			opargs.at(3).toInt());
+}
+
+/// [grid, win, anchor, anchor_grid, anchor_row, anchor_col, focusable]
+void Shell::handleWinFloatPos(const QVariantList& opargs)
+{
+	if (opargs.size() < 6 || !opargs.at(0).canConvert<qint64>() ||
+			!opargs.at(3).canConvert<qint64>()) {
+		qWarning() << "Unexpected arguments for redraw:win_float_pos" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	ShellGrid *g = m_grids.value(grid);
+	if (!g) {
+		return;
+	}
+
+	QString anchor = m_nvim->decode(opargs.at(2).toByteArray());
+	QPoint base;
+	ShellGrid *anchor_grid = m_grids.value(opargs.at(3).toLongLong());
+	if (anchor_grid) {
+		base = anchor_grid->position();
+	}
+	int row = base.y() + int(opargs.at(4).toDouble());
+	int col = base.x() + int(opargs.at(5).toDouble());
+	if (anchor.startsWith('S')) {
+		row -= g->rows();
+	}
+	if (anchor.endsWith('E')) {
+		col -= g->columns();
+	}
+
+	// Floating windows are painted over regular windows
+	m_grid_order.removeOne(grid);
+	m_grid_order.append(grid);
+	placeGrid(grid, row, col);
+}
+
+void Shell::handleWinHide(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 1)) {
+		qWarning() << "Unexpected arguments for redraw:win_hide" << opargs;
+		return;
+	}
+	hideGrid(opargs.at(0).toLongLong());
+}
+
+/// [grid, row, scrolled, sep_char]
+void Shell::handleMsgSetPos(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 2)) {
+		qWarning() << "Unexpected arguments for redraw:msg_set_pos" << opargs;
+		return;
+	}
+	qint64 grid = opargs.at(0).toLongLong();
+	m_grid_order.removeOne(grid);
+	m_grid_order.append(grid);
+	placeGrid(grid, opargs.at(1).toInt(), 0);
+}
+
+/// [grid, generation, slot, top, bot], rows [top, bot) changed and can be
+/// read from the shared memory snapshot
+void Shell::handleGridShm(const QVariantList& opargs)
+{
+	if (!checkIntArgs(opargs, 5)) {
+		qWarning() << "Unexpected arguments for redraw:grid_shm" << opargs;
+		return;
+	}
+	if (!m_shm || opargs.at(0).toLongLong() != 1) {
+		qWarning() << "Received redraw:grid_shm without a shared grid" << opargs;
+		return;
+	}
+	quint64 generation = opargs.at(1).toULongLong();
+	int top = opargs.at(3).toInt();
+	int bot = opargs.at(4).toInt();
+	if (m_shm_resync) {
+		top = 0;
+		bot = rows();
+	}
+
+	QVector<ShmGrid::Row> cells;
+	if (!m_shm->readRows(generation, opargs.at(2).toInt(), top, bot, cells)) {
+		// Neovim is ahead of us, the next snapshot has all of our rows
+		m_shm_resync = true;
+		return;
+	}
+	m_shm_resync = false;
+
+	for (int i=0; i<cells.size(); i++) {
+		foreach(const ShmGrid::Row::Run& run, cells.at(i).runs()) {
+			putGrid(1, run.text, top + i, run.col, run.attr);
+		}
+	}
+}
+
+/// Show a grid at the given position in grid 1, nothing is repainted
+/// if the grid was already visible there
+void Shell::placeGrid(qint64 grid, int row, int col)
+{
+	ShellGrid *g = m_grids.value(grid);
+	if (!g) {
+		qWarning() << "Trying to position unknown grid" << grid;
+		return;
+	}
+	if (g->isVisible() && g->position() == QPoint(col, row)) {
+		return;
+	}
+	if (g->isVisible()) {
+		frameScheduler()->damage(gridRect(g));
+	}
+	g->setPosition(row, col);
+	g->setVisible(true);
+	frameScheduler()->damage(gridRect(g));
+	if (grid == m_cursor_grid) {
+		updateGridCursor();
+	}
+}
+
+void Shell::hideGrid(qint64 grid)
+{
+	ShellGrid *g = m_grids.value(grid);
+	if (g && g->isVisible()) {
+		g->setVisible(false);
+		frameScheduler()->damage(gridRect(g));
+	}
+}
+
+/// The area covered by a grid, in pixels
+QRect Shell::gridRect(const ShellGrid *g) const
+{
+	return gridRect(g, 0, 0, g->rows(), g->columns());
+}
+
+/// The area covered by a region of a grid, in pixels
+QRect Shell::gridRect(const ShellGrid *g, int row, int col, int rowcount, int colcount) const
+{
+	return QRect((g->position().x() + col)*cellSize().width(),
+			(g->position().y() + row)*cellSize().height(),
+			colcount*cellSize().width(), rowcount*cellSize().height());
+}
+
+/// The cell that is visible at a position of the shell, i.e. from the
+/// topmost grid that covers it
+const Cell& Shell::shellCell(QPoint at) const
+{
+	for (int i=m_grid_order.size()-1; i>=0; i--) {
+		const ShellGrid *g = m_grids.value(m_grid_order.at(i));
+		if (!g || !g->isVisible()) {
+			continue;
+		}
+		QPoint pos = at - g->position();
+		if (pos.x() >= 0 && pos.y() >= 0 &&
+				pos.x() < g->columns() && pos.y() < g->rows()) {
+			return g->contents().constValue(pos.y(), pos.x());
+		}
+	}
+	return contents().constValue(at.y(), at.x());
+}
+
+/// Composite visible grids over grid 1, grids are only rendered when
+/// they are visible and part of the repainted region
+void Shell::paintGrids(QPainter& p, const QRegion& region)
+{
+	foreach(qint64 id, m_grid_order) {
+		ShellGrid *g = m_grids.value(id);
+		if (!g || !g->isVisible()) {
+			continue;
+		}
+		QRect target = gridRect(g);
+		QRegion damaged = region.intersected(target);
+		if (damaged.isEmpty()) {
+			continue;
+		}
+		const QImage& img = g->render(*this);
+		foreach(QRect r, damaged.rects()) {
+			p.drawImage(r, img, r.translated(-target.topLeft()));
+		}
+	}
+}
+
+/// Move the cursor, the cursor is painted over the cells so only its
+/// old and new area are restored from the cell image
 void Shell::setNeovimCursor(quint64 row, quint64 col)
 {
-	update(neovimCursorRect());
+	damageOverlay(neovimCursorRect());
 	m_cursor_pos = QPoint(col, row);
-	update(neovimCursorRect());
+	damageOverlay(neovimCursorRect());
+	restartCursorBlink();
 }
 
-void Shell::handleModeChange(const QString& mode)
+void Shell::handleModeInfoSet(const QVariantList& opargs)
+{
+	if (opargs.size() < 2 || !opargs.at(1).canConvert<QVariantList>()) {
+		qWarning() << "Unexpected arguments for redraw:mode_info_set" << opargs;
+		return;
+	}
+
+	m_cursor_style_enabled = opargs.at(0).toBool();
+	m_mode_info.clear();
+	foreach(const QVariant& v, opargs.at(1).toList()) {
+		QVariantMap info = v.toMap();
+		CursorStyle style;
+		QString shape = m_nvim->decode(info.value("cursor_shape").toByteArray());
+		if (shape == "horizontal") {
+			style.shape = CursorStyle::Horizontal;
+		} else if (shape == "vertical") {
+			style.shape = CursorStyle::Vertical;
+		}
+		if (info.contains("cell_percentage")) {
+			style.percentage = info.value("cell_percentage").toInt();
+		}
+		style.blinkwait = info.value("blinkwait").toInt();
+		style.blinkon = info.value("blinkon").toInt();
+		style.blinkoff = info.value("blinkoff").toInt();
+		style.attr_id = info.value("attr_id").toLongLong();
+		m_mode_info.append(style);
+	}
+	damageOverlay(neovimCursorRect());
+	restartCursorBlink();
+}
+
+void Shell::handleModeChange(const QString& mode, int mode_idx)
 {
 	// TODO: Implement visual aids for other modes
 	if (mode == "insert") {
@@ -495,6 +1047,103 @@ void Shell::handleModeChange(const QString& mode)
 	} else {
 		m_insertMode = false;
 	}
+	m_mode_idx = mode_idx;
+	damageOverlay(neovimCursorRect());
+	restartCursorBlink();
+}
+
+/// The cursor style for the current mode. If Neovim does not send
+/// cursor styles the cursor is a block, or a bar in insert mode.
+CursorStyle Shell::cursorStyle() const
+{
+	if (m_cursor_style_enabled && m_mode_idx >= 0 &&
+			m_mode_idx < m_mode_info.size()) {
+		return m_mode_info.at(m_mode_idx);
+	}
+	CursorStyle style;
+	if (m_insertMode) {
+		style.shape = CursorStyle::Vertical;
+		style.percentage = 25;
+	}
+	return style;
+}
+
+/// Show the cursor and start blinking again after blinkwait, called
+/// when the cursor moves or the mode changes
+void Shell::restartCursorBlink()
+{
+	m_cursor_blink.stop();
+	if (!m_cursor_visible) {
+		m_cursor_visible = true;
+		damageOverlay(neovimCursorRect());
+	}
+
+	CursorStyle style = cursorStyle();
+	if (hasFocus() && style.blinkwait > 0 && style.blinkon > 0 &&
+			style.blinkoff > 0) {
+		m_cursor_blink.start(style.blinkwait);
+	}
+}
+
+/// Toggle the cursor, this only repaints the cursor area
+void Shell::cursorBlink()
+{
+	CursorStyle style = cursorStyle();
+	if (style.blinkon <= 0 || style.blinkoff <= 0) {
+		restartCursorBlink();
+		frameScheduler()->commit();
+		return;
+	}
+	m_cursor_visible = !m_cursor_visible;
+	m_cursor_blink.start(m_cursor_visible ? style.blinkon : style.blinkoff);
+	damageOverlay(neovimCursorRect());
+	frameScheduler()->commit();
+}
+
+/// Paint the cursor over the cells. The cursor uses the colors of its
+/// highlight group, if it has none the cell colors are inverted.
+void Shell::paintCursor(QPainter& p)
+{
+	if (!m_cursor_visible) {
+		return;
+	}
+
+	CursorStyle style = cursorStyle();
+	QRect r = neovimCursorRect();
+	if (style.shape == CursorStyle::Vertical) {
+		r.setWidth(qMax(1, cellSize().width()*style.percentage/100));
+	} else if (style.shape == CursorStyle::Horizontal) {
+		r.setTop(r.bottom() + 1 -
+			qMax(1, cellSize().height()*style.percentage/100));
+	}
+
+	const HighlightAttr attr = m_hl_attrs.value(style.attr_id);
+	if (style.attr_id == 0 || !attr.background.isValid()) {
+		p.setCompositionMode(QPainter::RasterOp_SourceXorDestination);
+		p.fillRect(r, m_cursor_color);
+		p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		return;
+	}
+
+	if (style.shape != CursorStyle::Block) {
+		p.fillRect(r, attr.background);
+		return;
+	}
+
+	// Paint the character under the cursor with the cursor colors
+	const Cell& c = shellCell(m_cursor_pos);
+	QColor fg = attr.foreground;
+	if (!fg.isValid()) {
+		fg = c.backgroundColor.isValid() ? c.backgroundColor : background();
+	}
+	ShellContents cell(1, 2);
+	cell.put(QString(c.c), 0, 0, fg, attr.background, QColor(),
+			c.bold, c.italic, false, false);
+	p.save();
+	p.translate(r.topLeft());
+	p.setClipRect(QRect(QPoint(0, 0), r.size()));
+	paintContents(p, cell, QRect(QPoint(0, 0), r.size()));
+	p.restore();
 }
 
 void Shell::handleSetTitle(const QVariantList& opargs)
@@ -561,6 +1210,23 @@ void Shell::handleNeovimNotification(const QByteArray &name, const QVariantList&
 			m_mouseHide = variant_not_zero(args.at(1));
 			int val = m_mouseHide ? 1 : 0;
 			m_nvim->api0()->vim_set_var("GuiMousehide", val);
+		} else if (guiEvName == "FrameStats" && args.size() == 1) {
+			const FrameStats& stats = frameStats();
+			QVariantMap val;
+			val.insert("frames", stats.frames);
+			val.insert("skipped", stats.skipped);
+			val.insert("frame_time_us", stats.lastFrameTime);
+			val.insert("frame_time_max_us", stats.maxFrameTime);
+			val.insert("latency_us", stats.lastLatency);
+			val.insert("latency_max_us", stats.maxLatency);
+			if (stats.frames) {
+				val.insert("frame_time_avg_us", stats.totalFrameTime/stats.frames);
+				val.insert("latency_avg_us", stats.totalLatency/stats.frames);
+			}
+			m_nvim->api0()->vim_set_var("GuiFrameStats", val);
+		} else if (guiEvName == "Trace" && args.size() >= 2) {
+			handleTrace(m_nvim->decode(args.at(1).toByteArray()),
+				args.size() > 2 ? m_nvim->decode(args.at(2).toByteArray()) : QString());
 		} else if (guiEvName == "Close" && args.size() == 1) {
 			qDebug() << "Neovim requested a GUI close";
 			emit neovimGuiCloseRequest();
@@ -594,6 +1260,8 @@ void Shell::handleNeovimNotification(const QByteArray &name, const QVariantList&
 
 		const QByteArray& name = redrawupdate.at(0).toByteArray();
 		const QVariantList& update_args = redrawupdate.mid(1);
+		QElapsedTimer timer;
+		timer.start();
 
 		foreach (const QVariant& opargs_var, update_args) {
 			if ((QMetaType::Type)opargs_var.type() != QMetaType::QVariantList) {
@@ -604,6 +1272,14 @@ void Shell::handleNeovimNotification(const QByteArray &name, const QVariantList&
 			const QVariantList& opargs = opargs_var.toList();
 			handleRedraw(name, opargs);
 		}
+		m_nvim->rpcStats()->addHandlerTime("redraw:" + name, timer.nsecsElapsed());
+	}
+
+	// With ext_linegrid Neovim sends redraw:flush when the screen is
+	// consistent, otherwise every redraw notification is a full batch
+	if (!m_multigrid) {
+		frameScheduler()->commit();
+		LatencyTrace::mark(LatencyTrace::FlushApplied);
 	}
 }
 
@@ -622,6 +1298,45 @@ void Shell::handleSetOption(const QString& name, const QVariant& value)
 	}
 }
 
+/// Handle RPC requests from Neovim, i.e. rpcrequest(g:GuiChannel, 'Gui', ...)
+///
+/// - RpcStats: returns the traffic counters of the connection, see GuiRpcStats()
+void Shell::handleRequest(MsgpackIODevice* dev, quint32 msgid, const QByteArray& method, const QVariantList& args)
+{
+	if (method == "Gui" && args.size() > 0 &&
+			m_nvim->decode(args.at(0).toByteArray()) == "RpcStats") {
+		dev->sendResponse(msgid, QVariant(), dev->stats().toVariant());
+	} else {
+		dev->sendResponse(msgid, QByteArray("Unknown GUI request"), QVariant());
+	}
+}
+
+/// Handle the GuiTrace command
+///
+/// - start: clear previous records and start tracing input latency
+/// - stop: stop tracing
+/// - save {path}: write the trace in the Chrome trace format
+/// - report: show latency percentiles
+void Shell::handleTrace(const QString& action, const QString& path)
+{
+	if (action == "start") {
+		LatencyTrace::clear();
+		LatencyTrace::setEnabled(true);
+	} else if (action == "stop") {
+		LatencyTrace::setEnabled(false);
+	} else if (action == "save") {
+		if (path.isEmpty() || !LatencyTrace::writeChromeTrace(path)) {
+			m_nvim->api0()->vim_report_error(m_nvim->encode(
+				QString("GuiTrace: unable to write trace to \"%1\"").arg(path)));
+		}
+	} else if (action == "report") {
+		m_nvim->api0()->vim_out_write(m_nvim->encode(LatencyTrace::report() + "\n"));
+	} else {
+		m_nvim->api0()->vim_report_error(m_nvim->encode(
+			QString("GuiTrace: unknown action \"%1\"").arg(action)));
+	}
+}
+
 void Shell::paintEvent(QPaintEvent *ev)
 {
 	if (!m_attached) {
@@ -632,22 +1347,17 @@ void Shell::paintEvent(QPaintEvent *ev)
 
 	ShellWidget::paintEvent(ev);
 
-	// paint cursor - we are not actually using Neovim colors yet,
-	// just invert the shell colors by painting white with XoR
-	if (ev->region().contains(neovimCursorTopLeft())) {
-		bool wide = contents().constValue(m_cursor_pos.y(),
-						m_cursor_pos.x()).doubleWidth;
-		QRect cursorRect(neovimCursorTopLeft(), cellSize());
-
-		if (m_insertMode) {
-			cursorRect.setWidth(2);
-		} else if (wide) {
-			cursorRect.setWidth(cursorRect.width()*2);
-		}
-		QPainter painter(this);
-		painter.setCompositionMode(QPainter::RasterOp_SourceXorDestination);
-		painter.fillRect(cursorRect, m_cursor_color);
+	QPainter painter(this);
+	if (!m_grids.isEmpty()) {
+		paintGrids(painter, ev->region());
+	}
+
+	// The cursor is an overlay, the cells under it were
+	// restored from the cell image by ShellWidget::paintEvent
+	if (ev->region().intersects(neovimCursorRect())) {
+		paintCursor(painter);
 	}
+	LatencyTrace::mark(LatencyTrace::PaintEnd);
 }
 
 void Shell::keyPressEvent(QKeyEvent *ev)
@@ -668,6 +1378,7 @@ void Shell::keyPressEvent(QKeyEvent *ev)
 		return;
 	}
 
+	LatencyTrace::input(inp);
 	m_nvim->api0()->vim_input(m_nvim->encode(inp));
 	// FIXME: bytes might not be written, and need to be buffered
 }
@@ -816,7 +1527,7 @@ bool Shell::event(QEvent *event)
 		updateWindowId();
 	}
 
-	return QWidget::event(event);
+	return ShellWidget::event(event);
 }
 
 /// Resize remote Neovim (pixel coordinates)
@@ -918,6 +1629,8 @@ void Shell::focusInEvent(QFocusEvent *ev)
 		// See neovim-qt/issues/329 the FocusGained key no longer exists, use autocmd instead
 		m_nvim->api0()->vim_command("if exists('#FocusGained') | doautocmd FocusGained | endif");
 	}
+	restartCursorBlink();
+	frameScheduler()->commit();
 	QWidget::focusInEvent(ev);
 }
 
@@ -926,6 +1639,9 @@ void Shell::focusOutEvent(QFocusEvent *ev)
 	if (m_attached) {
 		m_nvim->api0()->vim_command("if exists('#FocusLost') | doautocmd FocusLost | endif");
 	}
+	// Stop blinking while the shell has no focus
+	restartCursorBlink();
+	frameScheduler()->commit();
 	QWidget::focusOutEvent(ev);
 }
 
@@ -9,10 +9,14 @@
 #include <QTimer>
 #include <QUrl>
 #include <QList>
+#include <QHash>
 #include "neovimconnector.h"
+#include "msgpackiodevice.h"
 #include "shellwidget/shellwidget.h"
+#include "shellwidget/shellgrid.h"
 #include "popupmenu.h"
 #include "signature.h"
+#include "shmgrid.h"
 
 namespace NeovimQt {
 
@@ -31,11 +35,48 @@ class ShellOptions {
 public:
 	ShellOptions() {
 		enable_ext_tabline = true;
+		enable_ext_multigrid = true;
+		enable_shm_grid = false;
 	}
 	bool enable_ext_tabline;
+	/// Only used if the running Neovim supports it
+	bool enable_ext_multigrid;
+	/// Read grid 1 from shared memory, only used for a spawned Neovim that
+	/// supports the shm_path UI option
+	bool enable_shm_grid;
 };
 
-class Shell: public ShellWidget
+/// A highlight definition, as sent by redraw:hl_attr_define
+class HighlightAttr {
+public:
+	HighlightAttr()
+	:bold(false), italic(false), underline(false), undercurl(false),
+	reverse(false) {}
+	QColor foreground, background, special;
+	bool bold, italic, underline, undercurl, reverse;
+};
+
+/// Cursor shape and blinking for a mode, as sent by redraw:mode_info_set.
+/// Blink times are in ms, the cursor does not blink if any of them is 0.
+class CursorStyle {
+public:
+	enum Shape {
+		Block,
+		Horizontal,
+		Vertical,
+	};
+	CursorStyle()
+	:shape(Block), percentage(100), blinkwait(0), blinkon(0), blinkoff(0),
+	attr_id(0) {}
+	Shape shape;
+	/// Size of Horizontal and Vertical cursors, in percent of the cell
+	int percentage;
+	int blinkwait, blinkon, blinkoff;
+	/// Highlight for the cursor colors, 0 to invert the cell colors
+	qint64 attr_id;
+};
+
+class Shell: public ShellWidget, public MsgpackRequestHandler
 {
 	Q_OBJECT
 	Q_PROPERTY(bool neovimBusy READ neovimBusy() NOTIFY neovimBusy())
@@ -50,6 +91,7 @@ public:
 	bool neovimBusy() const;
 	bool neovimAttached() const;
 	QString fontDesc();
+	virtual void handleRequest(MsgpackIODevice*, quint32 msgid, const QByteArray&, const QVariantList&) Q_DECL_OVERRIDE;
 
 signals:
 	void neovimTitleChanged(const QString &title);
@@ -79,6 +121,7 @@ protected slots:
 	void neovimResizeFinished();
 	void mouseClickReset();
 	void mouseClickIncrement(Qt::MouseButton bt);
+	void cursorBlink();
 	void init();
 	void fontError(const QString& msg);
 	void updateWindowId();
@@ -110,11 +153,28 @@ protected:
 	virtual void handleHighlightSet(const QVariantMap& args);
 	virtual void handleRedraw(const QByteArray& name, const QVariantList& args);
 	virtual void handleScroll(const QVariantList& args);
-	virtual void handleModeChange(const QString& mode);
+	virtual void handleModeInfoSet(const QVariantList& opargs);
+	virtual void handleModeChange(const QString& mode, int mode_idx=-1);
 	virtual void handleSetTitle(const QVariantList& opargs);
 	virtual void handleSetScrollRegion(const QVariantList& opargs);
 	virtual void handleBusy(bool);
 	virtual void handleSetOption(const QString& name, const QVariant& value);
+	virtual void handleTrace(const QString& action, const QString& path);
+
+	// ext_linegrid/ext_multigrid
+	virtual void handleDefaultColorsSet(const QVariantList& opargs);
+	virtual void handleHlAttrDefine(const QVariantList& opargs);
+	virtual void handleGridResize(const QVariantList& opargs);
+	virtual void handleGridClear(const QVariantList& opargs);
+	virtual void handleGridCursorGoto(const QVariantList& opargs);
+	virtual void handleGridLine(const QVariantList& opargs);
+	virtual void handleGridScroll(const QVariantList& opargs);
+	virtual void handleGridDestroy(const QVariantList& opargs);
+	virtual void handleWinPos(const QVariantList& opargs);
+	virtual void handleWinFloatPos(const QVariantList& opargs);
+	virtual void handleWinHide(const QVariantList& opargs);
+	virtual void handleMsgSetPos(const QVariantList& opargs);
+	virtual void handleGridShm(const QVariantList& opargs);
 
 	void neovimMouseEvent(QMouseEvent *ev);
 	virtual void mousePressEvent(QMouseEvent *ev) Q_DECL_OVERRIDE;
@@ -125,6 +185,18 @@ private slots:
         void setAttached(bool attached=true);
 
 private:
+	void putGrid(qint64 grid, const QString& text, int row, int col, qint64 hl_id);
+	QRect gridRect(const ShellGrid *g) const;
+	QRect gridRect(const ShellGrid *g, int row, int col, int rowcount, int colcount) const;
+	void placeGrid(qint64 grid, int row, int col);
+	void hideGrid(qint64 grid);
+	void updateGridCursor();
+	const Cell& shellCell(QPoint at) const;
+	void paintGrids(QPainter& p, const QRegion& region);
+	CursorStyle cursorStyle() const;
+	void paintCursor(QPainter& p);
+	void restartCursorBlink();
+
 	bool m_attached;
 
 	NeovimConnector *m_nvim;
@@ -144,6 +216,14 @@ private:
 	QPoint m_cursor_pos;
 	bool m_cursor;
 	bool m_insertMode;
+	/// Cursor styles from redraw:mode_info_set, indexed by the mode
+	/// index in redraw:mode_change
+	bool m_cursor_style_enabled;
+	QList<CursorStyle> m_mode_info;
+	int m_mode_idx;
+	/// False while the cursor blinks off
+	bool m_cursor_visible;
+	QTimer m_cursor_blink;
 	bool m_resizing;
 	QSize m_resize_neovim_pending;
 	QLabel *m_tooltip;
@@ -159,6 +239,22 @@ private:
 	bool m_neovimBusy;
 	ShellOptions m_options;
 
+	/// True if ext_multigrid was negotiated, window grids are
+	/// composited over grid 1 (i.e. the ShellWidget contents)
+	bool m_multigrid;
+	QHash<qint64, HighlightAttr> m_hl_attrs;
+	QHash<qint64, ShellGrid*> m_grids;
+	/// Grid ids in paint order, the last grid is on top
+	QList<qint64> m_grid_order;
+	qint64 m_cursor_grid;
+	/// Cursor position in the coordinates of m_cursor_grid
+	QPoint m_grid_cursor_pos;
+	/// Shared memory for grid 1, NULL if not in use
+	ShmGrid *m_shm;
+	/// True if a snapshot was overwritten before it was read, the whole
+	/// grid is read from the next snapshot
+	bool m_shm_resync;
+
   PopupMenuDecoding m_popupmenu;
   SignatureDecoding m_signature;
 };
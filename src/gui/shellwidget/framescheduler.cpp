@@ -0,0 +1,150 @@
+#include <QGuiApplication>
+#include <QScreen>
+#include <QWidget>
+#include <QWindow>
+#include "framescheduler.h"
+
+FrameScheduler::FrameScheduler(QWidget *target)
+:QObject(target), m_target(target), m_autoCommit(true), m_pending(0)
+{
+	m_timer.setSingleShot(true);
+	m_timer.setTimerType(Qt::PreciseTimer);
+	connect(&m_timer, &QTimer::timeout,
+			this, &FrameScheduler::frame);
+}
+
+/// If auto commit is enabled (the default) every change schedules a
+/// frame. Otherwise a frame is only scheduled when commit() is called,
+/// i.e. when the owner knows the state is complete.
+void FrameScheduler::setAutoCommit(bool enabled)
+{
+	m_autoCommit = enabled;
+}
+
+bool FrameScheduler::autoCommit() const
+{
+	return m_autoCommit;
+}
+
+/// The refresh interval (in ms) of the screen showing the target widget
+int FrameScheduler::refreshInterval() const
+{
+	QWindow *w = m_target->window()->windowHandle();
+	QScreen *screen = w ? w->screen() : QGuiApplication::primaryScreen();
+	qreal rate = screen ? screen->refreshRate() : 0;
+	if (rate < 1) {
+		rate = 60;
+	}
+	return qMax(1, qRound(1000/rate));
+}
+
+/// Mark area as changed, it is repainted in the next frame
+void FrameScheduler::damage(const QRect& area)
+{
+	if (!m_firstChange.isValid()) {
+		m_firstChange.start();
+	}
+	m_damage += area;
+	if (m_autoCommit) {
+		commit();
+	}
+}
+
+void FrameScheduler::damageAll()
+{
+	damage(m_target->rect());
+}
+
+/// Scroll area by dy pixels in the next frame. Damage that is pending
+/// inside the area moves along with the content.
+void FrameScheduler::scroll(const QRect& area, int dy)
+{
+	if (!m_firstChange.isValid()) {
+		m_firstChange.start();
+	}
+	QRegion moved = m_damage.intersected(area).translated(0, dy);
+	m_damage = m_damage.subtracted(area) + moved.intersected(area);
+	m_scrolls.append(qMakePair(area, dy));
+	if (m_autoCommit) {
+		commit();
+	}
+}
+
+/// The current state is complete and can be painted. If a frame is
+/// already scheduled this state replaces the previous one.
+void FrameScheduler::commit()
+{
+	m_pending++;
+	if (m_timer.isActive()) {
+		return;
+	}
+
+	int delay = 0;
+	if (m_lastFrame.isValid()) {
+		delay = qMax(qint64(0), refreshInterval() - m_lastFrame.elapsed());
+	}
+	m_timer.start(delay);
+}
+
+/// Hand over the accumulated changes to Qt, the widget is painted
+/// in the next paint event
+void FrameScheduler::frame()
+{
+	m_lastFrame.start();
+	if (m_pending > 1) {
+		m_stats.skipped += m_pending - 1;
+	}
+	m_pending = 0;
+	if (!m_latency.isValid()) {
+		m_latency = m_firstChange;
+	}
+	m_firstChange.invalidate();
+
+	for (int i=0; i<m_scrolls.size(); i++) {
+		const QPair<QRect, int>& s = m_scrolls.at(i);
+		m_target->scroll(0, s.second, s.first);
+	}
+	m_scrolls.clear();
+	if (!m_damage.isEmpty()) {
+		m_target->update(m_damage);
+		m_damage = QRegion();
+	}
+}
+
+/// Call at the start of the target paint event
+void FrameScheduler::beginFrame()
+{
+	m_paint.start();
+}
+
+/// Call at the end of the target paint event. Paint events that were not
+/// caused by a scheduled frame (e.g. expose events) are not counted.
+void FrameScheduler::endFrame()
+{
+	if (!m_latency.isValid() || !m_paint.isValid()) {
+		return;
+	}
+
+	qint64 frameTime = m_paint.nsecsElapsed() / 1000;
+	qint64 latency = m_latency.nsecsElapsed() / 1000;
+	m_paint.invalidate();
+	m_latency.invalidate();
+
+	m_stats.frames++;
+	m_stats.lastFrameTime = frameTime;
+	m_stats.maxFrameTime = qMax(m_stats.maxFrameTime, frameTime);
+	m_stats.totalFrameTime += frameTime;
+	m_stats.lastLatency = latency;
+	m_stats.maxLatency = qMax(m_stats.maxLatency, latency);
+	m_stats.totalLatency += latency;
+}
+
+const FrameStats& FrameScheduler::stats() const
+{
+	return m_stats;
+}
+
+void FrameScheduler::resetStats()
+{
+	m_stats = FrameStats();
+}
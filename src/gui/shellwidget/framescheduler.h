@@ -0,0 +1,78 @@
+#ifndef QSHELLWIDGET2_FRAMESCHEDULER
+#define QSHELLWIDGET2_FRAMESCHEDULER
+
+/// Paces the repaints of a widget to the display refresh rate. Changes to
+/// the widget state are applied immediately, but the damaged area is
+/// accumulated and painted at most once per refresh interval. States that
+/// are replaced before they are painted are dropped.
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPair>
+#include <QRegion>
+#include <QTimer>
+
+class QWidget;
+
+/// Frame counters, all times are in microseconds
+class FrameStats {
+public:
+	FrameStats()
+	:frames(0), skipped(0), lastFrameTime(0), maxFrameTime(0),
+	totalFrameTime(0), lastLatency(0), maxLatency(0), totalLatency(0) {}
+	/// Number of frames painted
+	quint64 frames;
+	/// Number of committed states that were never painted, because a
+	/// newer state arrived before the next frame
+	quint64 skipped;
+	/// Time spent painting a frame
+	qint64 lastFrameTime, maxFrameTime, totalFrameTime;
+	/// Time between the first change in a frame and the end of the paint
+	qint64 lastLatency, maxLatency, totalLatency;
+};
+
+class FrameScheduler: public QObject
+{
+	Q_OBJECT
+public:
+	FrameScheduler(QWidget *target);
+
+	void setAutoCommit(bool);
+	bool autoCommit() const;
+	int refreshInterval() const;
+
+	void damage(const QRect&);
+	void damageAll();
+	void scroll(const QRect&, int dy);
+	void commit();
+
+	void beginFrame();
+	void endFrame();
+
+	const FrameStats& stats() const;
+	void resetStats();
+
+private slots:
+	void frame();
+
+private:
+	QWidget *m_target;
+	QTimer m_timer;
+	bool m_autoCommit;
+	/// Area that changed since the last frame
+	QRegion m_damage;
+	/// Scroll operations since the last frame, applied in order
+	QList<QPair<QRect, int> > m_scrolls;
+	/// Number of states committed since the last frame
+	int m_pending;
+	/// Time since the last frame was scheduled
+	QElapsedTimer m_lastFrame;
+	/// Time since the first change after the last frame
+	QElapsedTimer m_firstChange;
+	/// Time since the first change in the frame being painted
+	QElapsedTimer m_latency;
+	QElapsedTimer m_paint;
+	FrameStats m_stats;
+};
+
+#endif
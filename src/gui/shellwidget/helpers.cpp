@@ -1,3 +1,4 @@
+#include <cstring>
 #include <QImage>
 #include <QPainter>
 #include <QDebug>
@@ -101,3 +102,28 @@ bool isBadMonospace(const QFont& f)
 
 	return false;
 }
+
+/// Move the pixels of img in area by dy, the exposed lines are left
+/// untouched. area and dy are in image pixels.
+void scrollImage(QImage& img, const QRect& area, int dy)
+{
+	QRect r = area.intersected(img.rect());
+	if (r.isEmpty() || qAbs(dy) >= r.height()) {
+		return;
+	}
+
+	const int bpp = 4;
+	int offset = r.left()*bpp;
+	int len = r.width()*bpp;
+	if (dy < 0) {
+		for (int y=r.top(); y<=r.bottom()+dy; y++) {
+			memmove(img.scanLine(y) + offset,
+				img.constScanLine(y-dy) + offset, len);
+		}
+	} else {
+		for (int y=r.bottom(); y>=r.top()+dy; y--) {
+			memmove(img.scanLine(y) + offset,
+				img.constScanLine(y-dy) + offset, len);
+		}
+	}
+}
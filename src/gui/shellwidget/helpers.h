@@ -1,9 +1,11 @@
 #ifndef QSHELLWIDGET2_UTIL
 #define QSHELLWIDGET2_UTIL
 
+#include <QImage>
 #include "shellcontents.h"
 
 bool saveShellContents(const ShellContents& s, const QString& filename);
 bool isBadMonospace(const QFont& f);
+void scrollImage(QImage& img, const QRect& area, int dy);
 
 #endif
@@ -0,0 +1,178 @@
+#include <QPainter>
+#include <QFontMetrics>
+#include "shellfont.h"
+
+/// Glyph slots in each atlas page (columns x rows)
+static const int ATLAS_COLUMNS = 16;
+static const int ATLAS_ROWS = 16;
+/// When all pages are used the atlas is cleared
+static const int ATLAS_MAX_PAGES = 8;
+
+static QHash<QString, QWeakPointer<ShellFont> >& registry()
+{
+	static QHash<QString, QWeakPointer<ShellFont> > fonts;
+	return fonts;
+}
+
+uint qHash(const ShellFont::GlyphKey& key, uint seed)
+{
+	return qHash(key.c, seed) ^ qHash(key.fg, seed) ^
+		(qHash(key.bg, seed) << 1) ^ key.style;
+}
+
+/// The resources for a font, created if no other widget is using them
+QSharedPointer<ShellFont> ShellFont::get(const QFont& font, int lineSpace, int dpr)
+{
+	QString key = QString("%1/%2/%3").arg(font.key()).arg(lineSpace).arg(dpr);
+	QSharedPointer<ShellFont> res = registry().value(key).toStrongRef();
+	if (!res) {
+		res = QSharedPointer<ShellFont>(new ShellFont(font, lineSpace, dpr));
+		res->m_key = key;
+		registry().insert(key, res);
+	}
+	return res;
+}
+
+/// Number of font resources in use, for testing
+int ShellFont::instanceCount()
+{
+	return registry().size();
+}
+
+ShellFont::ShellFont(const QFont& font, int lineSpace, int dpr)
+:m_lineSpace(lineSpace), m_dpr(dpr), m_nextSlot(0)
+{
+	for (int i=0; i<4; i++) {
+		m_fonts[i] = font;
+		m_fonts[i].setBold(i & 1);
+		m_fonts[i].setItalic(i & 2);
+	}
+
+	// Height is either the line spacing or the font height, the leading
+	// may be negative and we want the larger value. Width is the width
+	// of the "W" character
+	QFontMetrics fm(font);
+	m_ascent = fm.ascent();
+	m_cellSize = QSize(fm.width('W'),
+			qMax(fm.lineSpacing(), fm.height()) + m_lineSpace);
+}
+
+ShellFont::~ShellFont()
+{
+	registry().remove(m_key);
+}
+
+const QFont& ShellFont::font(bool bold, bool italic) const
+{
+	return m_fonts[(bold ? 1 : 0) | (italic ? 2 : 0)];
+}
+
+QSize ShellFont::cellSize() const
+{
+	return m_cellSize;
+}
+
+int ShellFont::ascent() const
+{
+	return m_ascent;
+}
+
+int ShellFont::lineSpace() const
+{
+	return m_lineSpace;
+}
+
+int ShellFont::devicePixelRatio() const
+{
+	return m_dpr;
+}
+
+/// Number of glyphs in the atlas
+int ShellFont::glyphCount() const
+{
+	return m_glyphs.size();
+}
+
+/// Paint the character c over the background color bg, r is the area
+/// of the cell (or two cells for double width characters). Glyphs are
+/// rendered once into the atlas and copied from there.
+void ShellFont::drawGlyph(QPainter& p, const QRect& r, QChar c, bool bold,
+		bool italic, const QColor& fg, const QColor& bg)
+{
+	bool wide = r.width() > m_cellSize.width();
+	GlyphKey key;
+	key.c = c.unicode();
+	key.style = (bold ? 1 : 0) | (italic ? 2 : 0) | (wide ? 4 : 0);
+	key.fg = fg.rgb();
+	key.bg = bg.rgb();
+
+	QHash<GlyphKey, Glyph>::const_iterator it = m_glyphs.constFind(key);
+	if (it == m_glyphs.constEnd()) {
+		it = m_glyphs.insert(key, renderGlyph(key, r.width()));
+	}
+	p.drawImage(r, m_pages.at(it->page), it->rect);
+}
+
+ShellFont::Glyph ShellFont::renderGlyph(const GlyphKey& key, int width)
+{
+	int perPage = ATLAS_COLUMNS * ATLAS_ROWS;
+	if (m_nextSlot == perPage * ATLAS_MAX_PAGES) {
+		m_glyphs.clear();
+		m_nextSlot = 0;
+	}
+	int page = m_nextSlot / perPage;
+	int slot = m_nextSlot % perPage;
+	m_nextSlot++;
+
+	QSize slotSize(m_cellSize.width()*2, m_cellSize.height());
+	if (page == m_pages.size()) {
+		QImage img(QSize(slotSize.width()*ATLAS_COLUMNS,
+				slotSize.height()*ATLAS_ROWS)*m_dpr, QImage::Format_RGB32);
+		img.setDevicePixelRatio(m_dpr);
+		m_pages.append(img);
+	}
+
+	QRect cell(QPoint((slot % ATLAS_COLUMNS) * slotSize.width(),
+				(slot / ATLAS_COLUMNS) * slotSize.height()),
+			QSize(qMin(width, slotSize.width()), slotSize.height()));
+	QPainter p(&m_pages[page]);
+	p.setClipRect(cell);
+	p.fillRect(cell, QColor(key.bg));
+	p.setPen(QColor(key.fg));
+	p.setFont(font(key.style & 1, key.style & 2));
+	// Draw chars at the baseline
+	p.drawText(QPoint(cell.left(), cell.top()+m_ascent+m_lineSpace),
+			QString(QChar(key.c)));
+
+	Glyph g;
+	g.page = page;
+	g.rect = QRect(cell.topLeft()*m_dpr, cell.size()*m_dpr);
+	return g;
+}
+
+/// A tile with the pattern for a decoration. Tiles are created once
+/// per decoration and color, and repeated along runs of cells.
+const QPixmap& ShellFont::decorationTile(Decoration deco, const QColor& color)
+{
+	QPair<int, QRgb> key(deco, color.rgba());
+	QHash<QPair<int, QRgb>, QPixmap>::const_iterator it =
+		m_decorationTiles.constFind(key);
+	if (it != m_decorationTiles.constEnd()) {
+		return it.value();
+	}
+
+	QImage tile;
+	if (deco == Undercurl) {
+		// Offsets from the bottom, the pattern repeats every 8 pixels
+		static const int val[8] = {1, 0, 0, 1, 1, 2, 2, 2};
+		tile = QImage(8, 3, QImage::Format_ARGB32_Premultiplied);
+		tile.fill(Qt::transparent);
+		for (int x=0; x<8; x++) {
+			tile.setPixel(x, 2 - val[x], color.rgba());
+		}
+	} else {
+		tile = QImage(8, 1, QImage::Format_ARGB32_Premultiplied);
+		tile.fill(color);
+	}
+	return *m_decorationTiles.insert(key, QPixmap::fromImage(tile));
+}
@@ -0,0 +1,79 @@
+#ifndef QSHELLWIDGET2_SHELLFONT
+#define QSHELLWIDGET2_SHELLFONT
+
+/// Font resources shared by all shell widgets in the process that use the
+/// same font, line space and device pixel ratio: the font variants, cell
+/// metrics, a glyph atlas and the decoration tiles. Resources are reference
+/// counted and released when the last widget using them goes away.
+///
+/// Not thread safe, only use from the GUI thread.
+#include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QSharedPointer>
+#include <QVector>
+
+class QPainter;
+
+class ShellFont
+{
+public:
+	enum Decoration {
+		NoDecoration,
+		Underline,
+		Undercurl,
+	};
+
+	static QSharedPointer<ShellFont> get(const QFont& font, int lineSpace, int dpr);
+	static int instanceCount();
+	~ShellFont();
+
+	const QFont& font(bool bold=false, bool italic=false) const;
+	QSize cellSize() const;
+	int ascent() const;
+	int lineSpace() const;
+	int devicePixelRatio() const;
+	int glyphCount() const;
+
+	void drawGlyph(QPainter& p, const QRect& r, QChar c, bool bold,
+			bool italic, const QColor& fg, const QColor& bg);
+	const QPixmap& decorationTile(Decoration, const QColor&);
+
+private:
+	ShellFont(const QFont& font, int lineSpace, int dpr);
+	class GlyphKey {
+	public:
+		ushort c;
+		/// bold, italic and double width bits
+		uchar style;
+		QRgb fg, bg;
+		bool operator==(const GlyphKey& o) const {
+			return c == o.c && style == o.style && fg == o.fg && bg == o.bg;
+		}
+	};
+	friend uint qHash(const ShellFont::GlyphKey& key, uint seed);
+	class Glyph {
+	public:
+		int page;
+		/// Source rect in the atlas page, in device pixels
+		QRect rect;
+	};
+	Glyph renderGlyph(const GlyphKey& key, int width);
+
+	QString m_key;
+	QFont m_fonts[4];
+	QSize m_cellSize;
+	int m_ascent;
+	int m_lineSpace;
+	int m_dpr;
+	/// The glyph atlas, rendered glyphs with their fg/bg colors in fixed
+	/// size slots of two cells
+	QVector<QImage> m_pages;
+	int m_nextSlot;
+	QHash<GlyphKey, Glyph> m_glyphs;
+	/// Pre-rendered underline/undercurl patterns by decoration and color
+	QHash<QPair<int, QRgb>, QPixmap> m_decorationTiles;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <QPainter>
+#include "shellgrid.h"
+#include "shellwidget.h"
+#include "helpers.h"
+
+ShellGrid::ShellGrid(int rows, int columns)
+:m_contents(rows, columns), m_position(0, 0), m_visible(false)
+{
+	invalidate();
+}
+
+const ShellContents& ShellGrid::contents() const
+{
+	return m_contents;
+}
+
+void ShellGrid::resize(int n_rows, int n_columns)
+{
+	if (n_rows != rows() || n_columns != columns()) {
+		m_contents.resize(n_rows, n_columns);
+		invalidate();
+	}
+}
+
+QPoint ShellGrid::position() const
+{
+	return m_position;
+}
+
+void ShellGrid::setPosition(int row, int column)
+{
+	m_position = QPoint(column, row);
+}
+
+bool ShellGrid::isVisible() const
+{
+	return m_visible;
+}
+
+void ShellGrid::setVisible(bool visible)
+{
+	m_visible = visible;
+}
+
+/// Put text in position, returns the amount of columns used
+int ShellGrid::put(const QString& text, int row, int column,
+		QColor fg, QColor bg, QColor sp, bool bold, bool italic,
+		bool underline, bool undercurl)
+{
+	int cols_changed = m_contents.put(text, row, column, fg, bg, sp,
+				bold, italic, underline, undercurl);
+	if (cols_changed > 0) {
+		markDirty(row, column, 1, cols_changed);
+	}
+	return cols_changed;
+}
+
+void ShellGrid::clear(QColor bg)
+{
+	m_contents.clearAll(bg);
+	invalidate();
+}
+
+/// Scroll an area, count rows (positive numbers move content up). The
+/// backing image is scrolled as well, only the exposed rows are repainted.
+void ShellGrid::scrollRegion(int row0, int row1, int col0, int col1, int count)
+{
+	if (count == 0) {
+		return;
+	}
+	m_contents.scrollRegion(row0, row1, col0, col1, count);
+
+	QRect area(col0, row0, col1-col0, row1-row0);
+	if (m_image.isNull() || QRegion(area).subtracted(m_dirty).isEmpty()) {
+		markDirty(row0, col0, row1-row0, col1-col0);
+		return;
+	}
+
+	// Pending damage moves with the content
+	QRegion moved = m_dirty.intersected(area).translated(0, -count);
+	m_dirty = m_dirty.subtracted(area).united(moved.intersected(area));
+
+	scrollImage(m_image, QRect(col0*m_cellSize.width(), row0*m_cellSize.height(),
+			area.width()*m_cellSize.width(), area.height()*m_cellSize.height()),
+			-count*m_cellSize.height());
+
+	if (count > 0) {
+		markDirty(row1-count, col0, count, col1-col0);
+	} else {
+		markDirty(row0, col0, -count, col1-col0);
+	}
+}
+
+/// Mark the whole grid for repainting, e.g. when the font changed
+void ShellGrid::invalidate()
+{
+	m_dirty = QRegion(0, 0, columns(), rows());
+}
+
+void ShellGrid::markDirty(int row0, int col0, int rowcount, int colcount)
+{
+	m_dirty += QRect(col0, row0, colcount, rowcount);
+}
+
+/// Paint cells that changed since the last call and return the backing image
+const QImage& ShellGrid::render(const ShellWidget& renderer)
+{
+	QSize cellSize = renderer.cellSize();
+	QSize size(columns()*cellSize.width(), rows()*cellSize.height());
+	if (cellSize != m_cellSize || m_image.size() != size) {
+		m_cellSize = cellSize;
+		m_image = QImage(size, QImage::Format_RGB32);
+		invalidate();
+	}
+
+	if (!m_dirty.isEmpty()) {
+		QPainter p(&m_image);
+		p.setFont(renderer.font());
+		foreach(QRect cells, m_dirty.rects()) {
+			QRect r(cells.left()*cellSize.width(), cells.top()*cellSize.height(),
+				cells.width()*cellSize.width(), cells.height()*cellSize.height());
+			// Cells outside the region are left alone, clip wide chars
+			p.setClipRect(r);
+			renderer.paintContents(p, m_contents, r);
+		}
+		m_dirty = QRegion();
+	}
+	return m_image;
+}
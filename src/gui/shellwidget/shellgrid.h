@@ -0,0 +1,56 @@
+#ifndef QSHELLWIDGET2_SHELLGRID
+#define QSHELLWIDGET2_SHELLGRID
+
+/// A grid of cells with its own backing image. Grids are meant to be
+/// composited over a ShellWidget (e.g. one grid per Neovim window), only
+/// the cells that changed since the last render are painted again.
+#include <QImage>
+#include <QRegion>
+#include "shellcontents.h"
+
+class ShellWidget;
+
+class ShellGrid
+{
+public:
+	ShellGrid(int rows, int columns);
+
+	inline int columns() const {
+		return m_contents.columns();
+	}
+	inline int rows() const {
+		return m_contents.rows();
+	}
+
+	const ShellContents& contents() const;
+	void resize(int rows, int columns);
+
+	/// Position of the top left cell, in the cells of the parent shell
+	QPoint position() const;
+	void setPosition(int row, int column);
+	bool isVisible() const;
+	void setVisible(bool);
+
+	int put(const QString&, int row, int column,
+			QColor fg, QColor bg, QColor sp,
+			bool bold, bool italic,
+			bool underline, bool undercurl);
+	void clear(QColor bg);
+	void scrollRegion(int row0, int row1, int col0, int col1, int count);
+	void invalidate();
+
+	const QImage& render(const ShellWidget& renderer);
+
+private:
+	void markDirty(int row0, int col0, int rowcount, int colcount);
+
+	ShellContents m_contents;
+	QImage m_image;
+	QSize m_cellSize;
+	/// Cells that need to be painted again, in cell coordinates
+	QRegion m_dirty;
+	QPoint m_position;
+	bool m_visible;
+};
+
+#endif
@@ -8,6 +8,7 @@ ShellWidget::ShellWidget(QWidget *parent)
 :QWidget(parent), m_contents(0,0), m_bgColor(Qt::white),
 	m_fgColor(Qt::black), m_spColor(QColor()), m_lineSpace(0)
 {
+	m_frames = new FrameScheduler(this);
 	setAttribute(Qt::WA_OpaquePaintEvent);
 	setAttribute(Qt::WA_KeyCompression, false);
 	setFocusPolicy(Qt::StrongFocus);
@@ -22,6 +23,7 @@ ShellWidget* ShellWidget::fromFile(const QString& path)
 {
 	ShellWidget *w = new ShellWidget();
 	w->m_contents.fromFile(path);
+	w->invalidateCells();
 	return w;
 }
 
@@ -82,126 +84,231 @@ void ShellWidget::setLineSpace(int height)
 	}
 }
 
-/// Changed the cell size based on font metrics:
-/// - Height is either the line spacing or the font
-///   height, the leading may be negative and we want the
-///   larger value
-/// - Width is the width of the "W" character
+/// Changed the cell size based on font metrics, see ShellFont
 void ShellWidget::setCellSize()
 {
-	QFontMetrics fm(font());
-	m_ascent = fm.ascent();
-	m_cellSize = QSize(fm.width('W'),
-			qMax(fm.lineSpacing(), fm.height()) + m_lineSpace);
+	m_font = ShellFont::get(font(), m_lineSpace, devicePixelRatio());
+	m_cellSize = m_font->cellSize();
 	setSizeIncrement(m_cellSize);
+	invalidateCells();
 }
 QSize ShellWidget::cellSize() const
 {
 	return m_cellSize;
 }
 
-void ShellWidget::paintEvent(QPaintEvent *ev)
+/// Paint the cells of contents that intersect rect, rect is in pixels
+/// relative to the top left corner of contents
+void ShellWidget::paintContents(QPainter& p, const ShellContents& contents,
+		const QRect& rect) const
 {
-	QPainter p(this);
-	foreach(QRect rect, ev->region().rects()) {
-		int start_row = rect.top() / m_cellSize.height();
-		int end_row = rect.bottom() / m_cellSize.height();
-		int start_col = rect.left() / m_cellSize.width();
-		int end_col = rect.right() / m_cellSize.width();
-
-		// Paint margins
-		if (end_col > m_contents.columns()) {
-			end_col = m_contents.columns();
-		}
-		if (end_row > m_contents.rows()) {
-			end_col = m_contents.columns();
-		}
+	int start_row = rect.top() / m_cellSize.height();
+	int end_row = rect.bottom() / m_cellSize.height();
+	int start_col = rect.left() / m_cellSize.width();
+	int end_col = rect.right() / m_cellSize.width();
+
+	// Paint margins
+	if (end_col > contents.columns()) {
+		end_col = contents.columns();
+	}
+	if (end_row > contents.rows()) {
+		end_col = contents.columns();
+	}
 
-		// end_col/row is inclusive
-		for (int i=start_row; i<=end_row && i < m_contents.rows(); i++) {
-			for (int j=start_col; j<=end_col && j < m_contents.columns();
-					j++) {
+	// Glyphs are rendered for the pixel ratio of the target device
+	QSharedPointer<ShellFont> font = m_font;
+	int dpr = p.device() ? p.device()->devicePixelRatio() : 1;
+	if (font->devicePixelRatio() != dpr) {
+		font = ShellFont::get(this->font(), m_lineSpace, dpr);
+	}
 
-				const Cell& cell = m_contents.constValue(i,j);
-				int chars = cell.doubleWidth ? 2 : 1;
-				QRect r = absoluteShellRect(i, j, 1, chars);
+	// end_col/row is inclusive
+	for (int i=start_row; i<=end_row && i < contents.rows(); i++) {
+		// Adjacent cells with the same decoration are painted as one run
+		ShellFont::Decoration run = ShellFont::NoDecoration;
+		QColor runColor;
+		int runStart = 0, runEnd = 0;
+		int bottom = 0;
+		for (int j=start_col; j<=end_col && j < contents.columns();
+				j++) {
+
+			const Cell& cell = contents.constValue(i,j);
+			int chars = cell.doubleWidth ? 2 : 1;
+			QRect r(j*m_cellSize.width(), i*m_cellSize.height(),
+				chars*m_cellSize.width(), m_cellSize.height());
+
+			if (j <= 0 || !contents.constValue(i, j-1).doubleWidth) {
+				// Only paint bg/fg if this is not the second cell
+				// of a wide char
+				QColor bg = cell.backgroundColor.isValid() ?
+					cell.backgroundColor : m_bgColor;
+				if (cell.c == ' ') {
+					p.fillRect(r, bg);
+					continue;
+				}
 
-				if (j <= 0 || !contents().constValue(i, j-1).doubleWidth) {
-					// Only paint bg/fg if this is not the second cell
-					// of a wide char
-					if (cell.backgroundColor.isValid()) {
-						p.fillRect(r, cell.backgroundColor);
+				QColor fg = cell.foregroundColor.isValid() ?
+					cell.foregroundColor : m_fgColor;
+				font->drawGlyph(p, r, cell.c, cell.bold, cell.italic,
+						fg, bg);
+			}
+
+			// Draw "undercurl" at the bottom of the cell
+			if (cell.underline || cell.undercurl) {
+				QColor color;
+				if (cell.undercurl) {
+					if (cell.specialColor.isValid()) {
+						color = cell.specialColor;
+					} else if (m_spColor.isValid()) {
+						color = m_spColor;
+					} else if (cell.foregroundColor.isValid()) {
+						color = cell.foregroundColor;
 					} else {
-						p.fillRect(r, m_bgColor);
+						color = m_fgColor;
 					}
+				} else if (cell.foregroundColor.isValid()) {
+					color = cell.foregroundColor;
+				} else {
+					color = m_fgColor;
+				}
+				ShellFont::Decoration deco = cell.underline ?
+					ShellFont::Underline : ShellFont::Undercurl;
+
+				if (deco != run || color != runColor || r.left() > runEnd) {
+					paintDecoration(p, *font, run, runColor, runStart, runEnd, bottom);
+					run = deco;
+					runColor = color;
+					runStart = r.left();
+				}
+				runEnd = qMax(runEnd, r.right()+1);
+				bottom = r.bottom();
+			}
+		}
+		paintDecoration(p, *font, run, runColor, runStart, runEnd, bottom);
+	}
+}
 
-					if (cell.c == ' ') {
-						continue;
-					}
+/// Paint a decoration from x=left up to (not including) right, above
+/// the bottom line of a cell row
+void ShellWidget::paintDecoration(QPainter& p, ShellFont& font,
+		ShellFont::Decoration deco, const QColor& color,
+		int left, int right, int bottom) const
+{
+	if (deco == ShellFont::NoDecoration || right <= left) {
+		return;
+	}
+	const QPixmap& tile = font.decorationTile(deco, color);
+	QRect r(left, bottom - tile.height(), right - left, tile.height());
+	// The pattern is aligned to x=0, so runs painted separately match
+	p.drawTiledPixmap(r, tile, QPoint(left % tile.width(), 0));
+}
 
-					if (cell.foregroundColor.isValid()) {
-						p.setPen(cell.foregroundColor);
-					} else {
-						p.setPen(m_fgColor);
-					}
+FrameScheduler* ShellWidget::frameScheduler() const
+{
+	return m_frames;
+}
 
-					if (cell.bold || cell.italic) {
-						QFont f = p.font();
-						f.setBold(cell.bold);
-						f.setItalic(cell.italic);
-						p.setFont(f);
-					} else {
-						p.setFont(font());
-					}
+const FrameStats& ShellWidget::frameStats() const
+{
+	return m_frames->stats();
+}
 
-					// Draw chars at the baseline
-					QPoint pos(r.left(), r.top()+m_ascent+m_lineSpace);
-					p.drawText(pos, QString(cell.c));
-				}
+/// Paint events are timed here, so the time spent painting in subclasses
+/// is included in the frame time
+bool ShellWidget::event(QEvent *ev)
+{
+	if (ev->type() != QEvent::Paint) {
+		return QWidget::event(ev);
+	}
+	m_frames->beginFrame();
+	bool res = QWidget::event(ev);
+	m_frames->endFrame();
+	return res;
+}
 
-				// Draw "undercurl" at the bottom of the cell
-				if (cell.underline || cell.undercurl) {
-					QPen pen = QPen();
-					if (cell.undercurl) {
-						if (cell.specialColor.isValid()) {
-							pen.setColor(cell.specialColor);
-						} else if (m_spColor.isValid()) {
-							pen.setColor(m_spColor);
-						} else if (cell.foregroundColor.isValid()) {
-							pen.setColor(cell.foregroundColor);
-						} else {
-							pen.setColor(m_fgColor);
-						}
-					} else if (cell.underline) {
-						if (cell.foregroundColor.isValid()) {
-							pen.setColor(cell.foregroundColor);
-						} else {
-							pen.setColor(m_fgColor);
-						}
-					}
+/// Repaint rect without painting the cells under it again, for content
+/// that subclasses paint over the cells (e.g. a cursor). The area is
+/// restored from the cell image.
+void ShellWidget::damageOverlay(const QRect& rect)
+{
+	m_frames->damage(rect);
+}
 
-					p.setPen(pen);
-					QPoint start = r.bottomLeft();
-					QPoint end = r.bottomRight();
-					start.ry()--; end.ry()--;
-					if (cell.underline) {
-						p.drawLine(start, end);
-					} else if (cell.undercurl) {
-						static const int val[8] = {1, 0, 0, 1, 1, 2, 2, 2};
-						QPainterPath path(start);
-						for (int i = start.x() + 1; i <= end.x(); i++) {
-							int offset = val[i % 8];
-							path.lineTo(QPoint(i, start.y() - offset));
-						}
-						p.drawPath(path);
-					}
-				}
-			}
-		}
+/// Mark an area (in pixels) of the cell image for repainting
+void ShellWidget::markDirty(const QRect& rect)
+{
+	m_dirty += rect;
+}
+
+void ShellWidget::invalidateCells()
+{
+	m_dirty = QRegion(absoluteShellRect(0, 0,
+				m_contents.rows(), m_contents.columns()));
+}
+
+/// Scroll the cell image along with the contents, rect and dy are
+/// in pixels. Only the exposed rows need to be painted again.
+void ShellWidget::scrollCells(const QRect& rect, int dy)
+{
+	if (m_image.isNull() || QRegion(rect).subtracted(m_dirty).isEmpty()) {
+		markDirty(rect);
+		return;
+	}
+
+	// Pending damage moves with the content
+	QRegion moved = m_dirty.intersected(rect).translated(0, dy);
+	m_dirty = m_dirty.subtracted(rect).united(moved.intersected(rect));
+
+	int dpr = m_image.devicePixelRatio();
+	scrollImage(m_image, QRect(rect.topLeft()*dpr, rect.size()*dpr), dy*dpr);
+
+	if (dy < 0) {
+		markDirty(QRect(rect.left(), rect.bottom()+1+dy, rect.width(), -dy));
+	} else {
+		markDirty(QRect(rect.left(), rect.top(), rect.width(), dy));
+	}
+}
+
+/// Paint the cells that changed since the last paint into the cell image
+void ShellWidget::renderCells()
+{
+	int dpr = devicePixelRatio();
+	QSize size = absoluteShellRect(0, 0,
+			m_contents.rows(), m_contents.columns()).size();
+	if (m_image.size() != size*dpr || m_image.devicePixelRatio() != dpr) {
+		m_image = QImage(size*dpr, QImage::Format_RGB32);
+		m_image.setDevicePixelRatio(dpr);
+		invalidateCells();
+	}
+	if (m_font->devicePixelRatio() != dpr) {
+		// Moved to a screen with a different pixel ratio
+		m_font = ShellFont::get(font(), m_lineSpace, dpr);
 	}
 
+	if (m_dirty.isEmpty() || m_image.isNull()) {
+		return;
+	}
+	QPainter p(&m_image);
+	foreach(QRect rect, m_dirty.rects()) {
+		p.setClipRect(rect);
+		paintContents(p, m_contents, rect);
+	}
+	m_dirty = QRegion();
+}
+
+void ShellWidget::paintEvent(QPaintEvent *ev)
+{
+	renderCells();
+
+	QPainter p(this);
 	QRect shellArea = absoluteShellRect(0, 0,
 				m_contents.rows(), m_contents.columns());
+	int dpr = m_image.devicePixelRatio();
+	foreach(QRect rect, ev->region().intersected(shellArea).rects()) {
+		p.drawImage(rect, m_image,
+			QRect(rect.topLeft()*dpr, rect.size()*dpr));
+	}
+
 	QRegion margins = QRegion(rect()).subtracted(shellArea);
 	foreach(QRect margin, margins.intersected(ev->region()).rects()) {
 		p.fillRect(margin, m_bgColor);
@@ -238,13 +345,17 @@ void ShellWidget::resizeShell(int n_rows, int n_columns)
 {
 	if (n_rows != rows() || n_columns != columns()) {
 		m_contents.resize(n_rows, n_columns);
+		invalidateCells();
 		updateGeometry();
 	}
 }
 
 void ShellWidget::setSpecial(const QColor& color)
 {
-	m_spColor = color;
+	if (color != m_spColor) {
+		m_spColor = color;
+		invalidateCells();
+	}
 }
 
 QColor ShellWidget::special() const
@@ -254,7 +365,10 @@ QColor ShellWidget::special() const
 
 void ShellWidget::setBackground(const QColor& color)
 {
-	m_bgColor = color;
+	if (color != m_bgColor) {
+		m_bgColor = color;
+		invalidateCells();
+	}
 }
 
 QColor ShellWidget::background() const
@@ -264,7 +378,10 @@ QColor ShellWidget::background() const
 
 void ShellWidget::setForeground(const QColor& color)
 {
-	m_fgColor = color;
+	if (color != m_fgColor) {
+		m_fgColor = color;
+		invalidateCells();
+	}
 }
 
 QColor ShellWidget::foreground() const
@@ -295,7 +412,8 @@ int ShellWidget::put(const QString& text, int row, int column,
 				bold, italic, underline, undercurl);
 	if (cols_changed > 0) {
 		QRect rect = absoluteShellRect(row, column, 1, cols_changed);
-		update(rect);
+		markDirty(rect);
+		m_frames->damage(rect);
 	}
 	return cols_changed;
 }
@@ -304,12 +422,14 @@ void ShellWidget::clearRow(int row)
 {
 	m_contents.clearRow(row);
 	QRect rect = absoluteShellRect(row, 0, 1, m_contents.columns());
-	update(rect);
+	markDirty(rect);
+	m_frames->damage(rect);
 }
 void ShellWidget::clearShell(QColor bg)
 {
 	m_contents.clearAll(bg);
-	update();
+	invalidateCells();
+	m_frames->damageAll();
 }
 
 /// Clear region (row0, col0) to - but not including (row1, col1)
@@ -317,7 +437,9 @@ void ShellWidget::clearRegion(int row0, int col0, int row1, int col1)
 {
 	m_contents.clearRegion(row0, col0, row1, col1);
 	// FIXME: check offset error
-	update(absoluteShellRect(row0, col0, row1-row0, col1-col0));
+	QRect rect = absoluteShellRect(row0, col0, row1-row0, col1-col0);
+	markDirty(rect);
+	m_frames->damage(rect);
 }
 
 /// Scroll count rows (positive numbers move content up)
@@ -326,7 +448,9 @@ void ShellWidget::scrollShell(int rows)
 	if (rows != 0) {
 		m_contents.scroll(rows);
 		// Qt's delta uses positive numbers to move down
-		scroll(0, -rows*m_cellSize.height());
+		scrollCells(absoluteShellRect(0, 0, m_contents.rows(),
+				m_contents.columns()), -rows*m_cellSize.height());
+		m_frames->scroll(rect(), -rows*m_cellSize.height());
 	}
 }
 /// Scroll an area, count rows (positive numbers move content up)
@@ -337,7 +461,8 @@ void ShellWidget::scrollShellRegion(int row0, int row1, int col0,
 		m_contents.scrollRegion(row0, row1, col0, col1, rows);
 		// Qt's delta uses positive numbers to move down
 		QRect r = absoluteShellRect(row0, col0, row1-row0, col1-col0);
-		scroll(0, -rows*m_cellSize.height(), r);
+		scrollCells(r, -rows*m_cellSize.height());
+		m_frames->scroll(r, -rows*m_cellSize.height());
 	}
 }
 
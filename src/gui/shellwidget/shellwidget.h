@@ -2,8 +2,14 @@
 #define QSHELLWIDGET2_SHELLWIDGET
 
 #include <QWidget>
+#include <QImage>
+#include <QSharedPointer>
 
 #include "shellcontents.h"
+#include "framescheduler.h"
+#include "shellfont.h"
+
+class QPainter;
 
 class ShellWidget: public QWidget
 {
@@ -31,6 +37,10 @@ public:
 	QSize cellSize() const;
 	const ShellContents& contents() const;
 	QSize sizeHint() const Q_DECL_OVERRIDE;
+	void paintContents(QPainter& p, const ShellContents& contents,
+			const QRect& rect) const;
+	FrameScheduler* frameScheduler() const;
+	const FrameStats& frameStats() const;
 signals:
 	void shellFontChanged();
 	void fontError(const QString& msg);
@@ -52,20 +62,34 @@ public slots:
 			int col1, int rows);
 	void setLineSpace(int height);
 protected:
+	virtual bool event(QEvent *ev) Q_DECL_OVERRIDE;
 	virtual void paintEvent(QPaintEvent *ev) Q_DECL_OVERRIDE;
 	virtual void resizeEvent(QResizeEvent *ev) Q_DECL_OVERRIDE;
 
 	void setCellSize();
 	QRect absoluteShellRect(int row0, int col0, int rowcount, int colcount);
+	void damageOverlay(const QRect&);
 
 private:
+	void paintDecoration(QPainter&, ShellFont&, ShellFont::Decoration,
+			const QColor&, int left, int right, int bottom) const;
 	void setFont(const QFont&);
+	void markDirty(const QRect&);
+	void invalidateCells();
+	void scrollCells(const QRect&, int dy);
+	void renderCells();
 
 	ShellContents m_contents;
+	FrameScheduler *m_frames;
+	/// Font resources, shared with other widgets using the same font
+	QSharedPointer<ShellFont> m_font;
 	QSize m_cellSize;
-	int m_ascent;
 	QColor m_bgColor, m_fgColor, m_spColor;
 	int m_lineSpace;
+	/// The painted cells, paint events are served from this image
+	QImage m_image;
+	/// Area of m_image that no longer matches m_contents, in pixels
+	QRegion m_dirty;
 };
 
 #endif
@@ -0,0 +1,136 @@
+#include <QtTest/QtTest>
+#include "shellwidget.h"
+
+#if defined(Q_OS_WIN) && defined(USE_STATIC_QT)
+#include <QtPlugin>
+Q_IMPORT_PLUGIN (QWindowsIntegrationPlugin);
+#endif
+
+/// Paint throughput for a grid of shell sizes and workloads. Each frame
+/// updates the widget through its slots and then renders it into a backing
+/// image with QWidget::render(), i.e. ShellWidget::paintEvent() runs with a
+/// real QPainter.
+///
+/// Besides the regular QBENCHMARK output (use -csv or -xml) each row
+/// prints a JSON line prefixed with BENCH, with the number of cells
+/// painted per frame, ms per frame and cells per second.
+class Test: public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Workload {
+		FullRepaint,
+		LineUpdate,
+		Scroll,
+		Attributes,
+		WideChars,
+		Undercurl,
+	};
+
+	static void fill(ShellWidget& g, Workload w, int seed) {
+		for (int row=0; row<g.rows(); row++) {
+			fillRow(g, w, row, row + seed);
+		}
+	}
+
+	/// Fill row with content for workload w, seed changes the content
+	static void fillRow(ShellWidget& g, Workload w, int row, int seed) {
+		if (w == WideChars) {
+			// Each wide char uses two columns
+			QString line(g.columns()/2, QChar(0x4e00 + seed % 64));
+			g.put(line, row, 0, Qt::black, Qt::white, QColor(),
+				false, false, false, false);
+			return;
+		}
+
+		if (w != Attributes) {
+			QString line(g.columns(), QChar('a' + seed % 26));
+			g.put(line, row, 0, Qt::black, Qt::white, Qt::red,
+				false, false, false, w == Undercurl);
+			return;
+		}
+
+		for (int col=0; col<g.columns(); col++) {
+			int n = seed + col;
+			g.put(QString(QChar('a' + n % 26)), row, col,
+				QColor::fromHsv((n*7) % 360, 200, 100),
+				QColor::fromHsv((n*13) % 360, 50, 240),
+				QColor::fromHsv((n*17) % 360, 255, 255),
+				n % 2, n % 3 == 0, n % 5 == 0, n % 7 == 0);
+		}
+	}
+
+private slots:
+	void benchPaint_data() {
+		QTest::addColumn<int>("rows");
+		QTest::addColumn<int>("columns");
+		QTest::addColumn<int>("workload");
+
+		QList<QSize> sizes;
+		sizes << QSize(80, 24) << QSize(120, 40) << QSize(250, 80)
+			<< QSize(500, 150);
+		QStringList names;
+		names << "full" << "line" << "scroll" << "attributes"
+			<< "wide" << "undercurl";
+		foreach(const QSize& size, sizes) {
+			for (int w=0; w<names.size(); w++) {
+				QString name = QString("%1 %2x%3").arg(names.at(w))
+					.arg(size.width()).arg(size.height());
+				QTest::newRow(name.toUtf8().constData())
+					<< size.height() << size.width() << w;
+			}
+		}
+	}
+
+	void benchPaint() {
+		QFETCH(int, rows);
+		QFETCH(int, columns);
+		QFETCH(int, workload);
+		Workload w = Workload(workload);
+
+		ShellWidget widget;
+		widget.resizeShell(rows, columns);
+		widget.resize(widget.sizeHint());
+		QImage target(widget.size(), QImage::Format_RGB32);
+		fill(widget, w, 0);
+		widget.render(&target);
+
+		qint64 cells = rows*columns;
+		if (w == LineUpdate || w == Scroll) {
+			cells = columns;
+		}
+
+		int frames = 0;
+		QElapsedTimer timer;
+		timer.start();
+		QBENCHMARK {
+			switch (w) {
+			case LineUpdate:
+				fillRow(widget, w, frames % rows, frames);
+				break;
+			case Scroll:
+				widget.scrollShell(1);
+				fillRow(widget, w, rows-1, frames);
+				break;
+			default:
+				fill(widget, w, frames + 1);
+			}
+			widget.render(&target);
+			frames++;
+		}
+		qint64 elapsed = timer.nsecsElapsed();
+
+		double ms = elapsed / 1000000.0 / frames;
+		QString row = QString("{\"name\": \"%1\", \"rows\": %2, \"columns\": %3, "
+				"\"cells_per_frame\": %4, \"ms_per_frame\": %5, "
+				"\"cells_per_second\": %6}")
+			.arg(QTest::currentDataTag()).arg(rows).arg(columns)
+			.arg(cells).arg(ms, 0, 'f', 4)
+			.arg(qint64(cells*frames*1e9/elapsed));
+		qDebug().noquote() << "BENCH" << row;
+	}
+};
+
+QTEST_MAIN(Test)
+#include "bench_paint.moc"
@@ -0,0 +1,60 @@
+#include <QtTest/QtTest>
+#include "shellwidget.h"
+
+#if defined(Q_OS_WIN) && defined(USE_STATIC_QT)
+#include <QtPlugin>
+Q_IMPORT_PLUGIN (QWindowsIntegrationPlugin);
+#endif
+
+class Test: public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void coalesce();
+	void manualCommit();
+};
+
+/// Changes that arrive faster than the refresh rate are painted in a
+/// single frame, the intermediate states are counted as skipped
+void Test::coalesce()
+{
+	ShellWidget w;
+	w.resizeShell(10, 20);
+	w.show();
+	QVERIFY(QTest::qWaitForWindowExposed(&w));
+	// Let the initial expose settle
+	QTest::qWait(100);
+	w.frameScheduler()->resetStats();
+
+	for (int i=0; i<5; i++) {
+		w.put("x", 0, i);
+	}
+	QTRY_COMPARE(w.frameStats().frames, quint64(1));
+	QCOMPARE(w.frameStats().skipped, quint64(4));
+	QVERIFY(w.frameStats().maxLatency >= w.frameStats().lastFrameTime);
+}
+
+/// Without auto commit nothing is painted until the state is committed
+void Test::manualCommit()
+{
+	ShellWidget w;
+	w.resizeShell(10, 20);
+	w.show();
+	QVERIFY(QTest::qWaitForWindowExposed(&w));
+	QTest::qWait(100);
+	w.frameScheduler()->resetStats();
+	w.frameScheduler()->setAutoCommit(false);
+
+	w.put("x", 0, 0);
+	w.scrollShell(1);
+	QTest::qWait(100);
+	QCOMPARE(w.frameStats().frames, quint64(0));
+
+	w.frameScheduler()->commit();
+	QTRY_COMPARE(w.frameStats().frames, quint64(1));
+	QCOMPARE(w.frameStats().skipped, quint64(0));
+}
+
+QTEST_MAIN(Test)
+#include "test_framescheduler.moc"
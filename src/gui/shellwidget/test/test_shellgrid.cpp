@@ -0,0 +1,80 @@
+#include <QtTest/QtTest>
+#include "shellgrid.h"
+#include "shellwidget.h"
+
+#if defined(Q_OS_WIN) && defined(USE_STATIC_QT)
+#include <QtPlugin>
+Q_IMPORT_PLUGIN (QWindowsIntegrationPlugin);
+#endif
+
+class Test: public QObject
+{
+	Q_OBJECT
+
+public:
+	// Fill rows [row0, row1) with
+	//     a a a a
+	//     b b b b
+	//     ...
+	void fillRows(ShellGrid& g, int row0, int row1, int offset=0) {
+		for (int i=row0; i<row1; i++) {
+			QString line(g.columns(), QChar('a'+i+offset));
+			g.put(line, i, 0, Qt::black, Qt::white, QColor(),
+				false, false, false, false);
+		}
+	}
+
+private slots:
+	void renderSize() {
+		ShellWidget w;
+		ShellGrid g(10, 20);
+		const QImage& img = g.render(w);
+		QCOMPARE(img.size(), QSize(20*w.cellSize().width(),
+					10*w.cellSize().height()));
+	}
+
+	void scrollMatchesRepaint() {
+		ShellWidget w;
+		ShellGrid g(10, 20);
+		fillRows(g, 0, 10);
+		g.render(w);
+
+		// Scroll up 3 rows, and redraw the exposed rows
+		g.scrollRegion(0, 10, 0, 20, 3);
+		fillRows(g, 7, 10, 3);
+		QImage scrolled = g.render(w);
+
+		ShellGrid expected(10, 20);
+		fillRows(expected, 0, 10, 3);
+		QCOMPARE(scrolled, expected.render(w));
+	}
+
+	void scrollDown() {
+		ShellWidget w;
+		ShellGrid g(10, 20);
+		fillRows(g, 0, 10);
+		g.render(w);
+
+		g.scrollRegion(2, 8, 0, 20, -2);
+		fillRows(g, 2, 4, -2);
+		QImage scrolled = g.render(w);
+
+		ShellGrid expected(10, 20);
+		fillRows(expected, 0, 10);
+		fillRows(expected, 2, 8, -2);
+		QCOMPARE(scrolled, expected.render(w));
+	}
+
+	void resize() {
+		ShellWidget w;
+		ShellGrid g(10, 20);
+		g.resize(5, 7);
+		QCOMPARE(g.rows(), 5);
+		QCOMPARE(g.columns(), 7);
+		QCOMPARE(g.render(w).size(), QSize(7*w.cellSize().width(),
+					5*w.cellSize().height()));
+	}
+};
+
+QTEST_MAIN(Test)
+#include "test_shellgrid.moc"
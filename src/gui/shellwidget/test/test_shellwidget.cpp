@@ -12,6 +12,20 @@ class Test: public QObject
 
 private slots:
 	void clearRegion();
+	void scrollMatchesRepaint();
+	void sharedFontResources();
+
+private:
+	void setup(ShellWidget& w) {
+		w.resizeShell(10, 20);
+		w.resize(20*w.cellSize().width(), 10*w.cellSize().height());
+	}
+	void fillRows(ShellWidget& w, int row0, int row1, int offset=0) {
+		for (int i=row0; i<row1; i++) {
+			w.put(QString(20, QChar('a' + (i+offset) % 26)), i, 0,
+				QColor::fromHsv((i+offset)*30 % 360, 255, 255));
+		}
+	}
 };
 
 
@@ -22,5 +36,58 @@ void Test::clearRegion()
 	w->resizeShell(2, 2);
 }
 
+/// Cells are painted from an image that is scrolled along with the
+/// contents, the result must match painting everything again
+void Test::scrollMatchesRepaint()
+{
+	ShellWidget w;
+	setup(w);
+	fillRows(w, 0, 10);
+	w.grab();
+	w.scrollShellRegion(2, 8, 0, 20, 3);
+	fillRows(w, 5, 8, 10);
+	QImage scrolled = w.grab().toImage();
+
+	ShellWidget expected;
+	setup(expected);
+	fillRows(expected, 0, 2);
+	fillRows(expected, 2, 5, 3);
+	fillRows(expected, 5, 8, 10);
+	fillRows(expected, 8, 10);
+	QCOMPARE(scrolled, expected.grab().toImage());
+}
+
+/// Widgets with the same font share the font resources, glyphs are
+/// rendered once for all of them
+void Test::sharedFontResources()
+{
+	int before = ShellFont::instanceCount();
+	ShellWidget *a = new ShellWidget();
+	ShellWidget *b = new ShellWidget();
+	// The line space makes the key unique to this test
+	a->setLineSpace(3);
+	b->setLineSpace(3);
+	setup(*a);
+	setup(*b);
+	QCOMPARE(ShellFont::instanceCount(), before + 1);
+
+	QSharedPointer<ShellFont> font = ShellFont::get(a->font(), 3,
+			a->devicePixelRatio());
+	QCOMPARE(font->cellSize(), a->cellSize());
+	fillRows(*a, 0, 10);
+	QImage painted = a->grab().toImage();
+	int glyphs = font->glyphCount();
+	QVERIFY(glyphs > 0);
+	fillRows(*b, 0, 10);
+	QCOMPARE(b->grab().toImage(), painted);
+	QCOMPARE(font->glyphCount(), glyphs);
+
+	delete a;
+	delete b;
+	QCOMPARE(ShellFont::instanceCount(), before + 1);
+	font.clear();
+	QCOMPARE(ShellFont::instanceCount(), before);
+}
+
 QTEST_MAIN(Test)
 #include "test_shellwidget.moc"
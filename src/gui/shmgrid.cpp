@@ -0,0 +1,183 @@
+#include "shmgrid.h"
+#include <atomic>
+#include <cstring>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+namespace NeovimQt {
+
+// Keep in sync with src/nvim/ui_shm.h
+static const char SHM_MAGIC[] = "NVQTSHM1";
+static const int SHM_TEXT_BYTES = 32;
+static const int SHM_HEADER_SIZE = 64;
+static const int SHM_SLOT_HEADER_SIZE = 32;
+
+struct ShmCell {
+	char text[SHM_TEXT_BYTES];
+	qint32 attr;
+};
+
+struct ShmHeader {
+	char magic[8];
+	quint32 rows, cols, slots, text_bytes;
+};
+
+struct ShmSlotHeader {
+	quint64 gen_begin, gen_end;
+	quint32 rows, cols;
+};
+
+static qint64 slotSize(int rows, int cols)
+{
+	return SHM_SLOT_HEADER_SIZE + qint64(rows) * cols * sizeof(ShmCell);
+}
+
+ShmGrid::ShmGrid()
+:m_map(nullptr), m_rows(0), m_cols(0), m_slots(0)
+{
+}
+
+ShmGrid::~ShmGrid()
+{
+	if (m_map) {
+		m_file.unmap(m_map);
+	}
+}
+
+/// Create a shared grid with room for rows x cols cells. The file is
+/// created in /dev/shm when it exists, so that it is never written to disk.
+bool ShmGrid::create(int rows, int cols, int slots)
+{
+	if (m_map || rows <= 0 || cols <= 0 || slots <= 0) {
+		return false;
+	}
+	QString dir = QFileInfo("/dev/shm").isDir() ? "/dev/shm" : QDir::tempPath();
+	m_file.setFileTemplate(dir + "/nvim-qt-shm-XXXXXX");
+	qint64 size = SHM_HEADER_SIZE + slots * slotSize(rows, cols);
+	if (!m_file.open() || !m_file.resize(size)) {
+		qWarning() << "Unable to create shared grid" << m_file.errorString();
+		return false;
+	}
+	m_map = m_file.map(0, size);
+	if (!m_map) {
+		qWarning() << "Unable to map shared grid" << m_file.errorString();
+		return false;
+	}
+	memset(m_map, 0, size);
+
+	ShmHeader *header = reinterpret_cast<ShmHeader*>(m_map);
+	memcpy(header->magic, SHM_MAGIC, sizeof(header->magic));
+	header->rows = rows;
+	header->cols = cols;
+	header->slots = slots;
+	header->text_bytes = SHM_TEXT_BYTES;
+	m_rows = rows;
+	m_cols = cols;
+	m_slots = slots;
+	return true;
+}
+
+bool ShmGrid::isValid() const
+{
+	return m_map != nullptr;
+}
+
+QString ShmGrid::path() const
+{
+	return m_file.fileName();
+}
+
+int ShmGrid::rows() const
+{
+	return m_rows;
+}
+
+int ShmGrid::cols() const
+{
+	return m_cols;
+}
+
+/// Split the row into runs of cells with the same highlight, empty cells
+/// (after double width characters) add no text
+QVector<ShmGrid::Row::Run> ShmGrid::Row::runs() const
+{
+	QVector<Run> out;
+	int width = attrs.size();
+	int col = 0;
+	Run run = {0, QString(), width ? attrs.at(0) : 0};
+	foreach(const QChar& c, text) {
+		if (col == width) {
+			break;
+		}
+		if (!c.isNull()) {
+			run.text += c;
+			continue;
+		}
+		col++;
+		if (col == width || attrs.at(col) != run.attr) {
+			out.append(run);
+			run.col = col;
+			run.text.clear();
+			if (col < width) {
+				run.attr = attrs.at(col);
+			}
+		}
+	}
+	return out;
+}
+
+/// Read rows [top, bot) from the snapshot with the given generation,
+/// each row holds as many cells as the grid had columns.
+///
+/// Returns false if the slot was reused for a later snapshot while it was
+/// being read, in that case the contents of out are undefined.
+bool ShmGrid::readRows(quint64 generation, int slot, int top, int bot,
+		QVector<Row>& out) const
+{
+	if (!m_map || slot < 0 || slot >= m_slots) {
+		return false;
+	}
+	const uchar *base = m_map + SHM_HEADER_SIZE + slot * slotSize(m_rows, m_cols);
+	const volatile ShmSlotHeader *header =
+		reinterpret_cast<const volatile ShmSlotHeader*>(base);
+
+	if (header->gen_end != generation) {
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	int rows = qMin<int>(header->rows, m_rows);
+	int width = qMin<int>(header->cols, m_cols);
+	top = qMax(top, 0);
+	bot = qMin(bot, rows);
+	out.resize(qMax(bot - top, 0));
+	// Copy the text out of the snapshot, it is decoded once the
+	// snapshot is known to be complete
+	QVector<QByteArray> text(out.size());
+	const ShmCell *cells = reinterpret_cast<const ShmCell*>(base + SHM_SLOT_HEADER_SIZE);
+	for (int row = top; row < bot; row++) {
+		QByteArray& bytes = text[row - top];
+		QVector<qint32>& attrs = out[row - top].attrs;
+		bytes.reserve(width * 2);
+		attrs.resize(width);
+		for (int col = 0; col < width; col++) {
+			const ShmCell& c = cells[qint64(row) * m_cols + col];
+			bytes.append(c.text, qstrnlen(c.text, SHM_TEXT_BYTES));
+			bytes.append('\0');
+			attrs[col] = c.attr;
+		}
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (header->gen_begin != generation) {
+		return false;
+	}
+	for (int i = 0; i < out.size(); i++) {
+		// The QByteArray overload stops at the first NUL, pass the size
+		out[i].text = QString::fromUtf8(text.at(i).constData(), text.at(i).size());
+	}
+	return true;
+}
+
+} // Namespace
@@ -0,0 +1,53 @@
+#ifndef NEOVIM_QT_SHMGRID
+#define NEOVIM_QT_SHMGRID
+
+#include <QByteArray>
+#include <QString>
+#include <QTemporaryFile>
+#include <QVector>
+
+namespace NeovimQt {
+
+/// The GUI side of the shared memory grid used by Neovim's shm_path UI
+/// option (see src/nvim/ui_shm.c). The GUI creates and owns the file,
+/// Neovim writes grid snapshots to it and sends redraw:grid_shm events
+/// with the rows that changed.
+class ShmGrid
+{
+public:
+	/// A row of cells. The text of each cell is followed by a NUL, the
+	/// cell after a double width character has no text.
+	class Row {
+	public:
+		/// Cells with the same highlight, starting at column col
+		class Run {
+		public:
+			int col;
+			QString text;
+			qint32 attr;
+		};
+		QVector<Run> runs() const;
+
+		QString text;
+		QVector<qint32> attrs;
+	};
+
+	ShmGrid();
+	~ShmGrid();
+	bool create(int rows, int cols, int slots=4);
+	bool isValid() const;
+	QString path() const;
+	int rows() const;
+	int cols() const;
+	bool readRows(quint64 generation, int slot, int top, int bot,
+			QVector<Row>& out) const;
+
+private:
+	QTemporaryFile m_file;
+	uchar *m_map;
+	int m_rows, m_cols, m_slots;
+};
+
+} // Namespace
+
+#endif
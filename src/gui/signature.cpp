@@ -6,78 +6,162 @@
 #include <QVariantMap>
 #include <QFontMetrics>
 #include <QListWidget>
-#include <QHBoxLayout>
-#include <QVBoxLayout>
-#include <QLabel>
 #include <QFrame>
-#include <QObjectCleanupHandler>
+#include <QPainter>
+#include <QTextLayout>
+#include <QtMath>
 #include <memory>
 
 namespace NeovimQt {
 
 
+/// One line of the signature popup, the text is laid out once with
+/// QTextLayout and only laid out again when it changes
+class SignatureLine : public QFrame {
+public:
+  SignatureLine(QWidget* p)
+    : QFrame(p),
+      activeStart(-1),
+      activeLength(0) {
+    setFrameStyle(QFrame::Panel | QFrame::Raised);
+    setFocusPolicy(Qt::NoFocus);
+    layout.setCacheEnabled(true);
+    hide();
+  }
+
+  /// Set the text, the range activeStart/activeLength is painted with
+  /// the active format. Returns false if nothing changed.
+  bool setText(QString const& text, int start, int length,
+      QFont const& font, QTextCharFormat const& active) {
+    if(text == layout.text() && start == activeStart
+        && length == activeLength && font == layout.font()) {
+      return false;
+    }
+    activeStart = start;
+    activeLength = length;
+    layout.setFont(font);
+    layout.setText(text);
+
+    QVector<QTextLayout::FormatRange> formats;
+    if(start >= 0 && length > 0) {
+      QTextLayout::FormatRange range;
+      range.start = start;
+      range.length = length;
+      range.format = active;
+      formats.append(range);
+    }
+    layout.setFormats(formats);
+
+    layout.beginLayout();
+    QTextLine line = layout.createLine();
+    if(line.isValid()) {
+      line.setPosition(QPointF(0, 0));
+    }
+    layout.endLayout();
+    update();
+    return true;
+  }
+
+  /// Width of the frame needed to show the whole text
+  int naturalWidth() const {
+    auto textWidth = layout.lineCount() ?
+      qCeil(layout.lineAt(0).naturalTextWidth()) : 0;
+    return textWidth + 2*frameWidth();
+  }
+
+protected:
+  void paintEvent(QPaintEvent* ev) override {
+    QFrame::paintEvent(ev);
+    QPainter p(this);
+    p.setPen(palette().color(QPalette::WindowText));
+    layout.draw(&p, contentsRect().topLeft());
+  }
+
+private:
+  QTextLayout layout;
+  int activeStart;
+  int activeLength;
+};
+
+/// A popup with one line per signature. Lines are created once and
+/// reused, showing the popup again with the same contents does not
+/// lay out or allocate widgets.
 class LabelVList {
 public:
+  /// Signatures after this are not shown
+  static const int maxLines = 16;
+
   LabelVList(QWidget* p)
     : parent(p),
       widget(new QFrame(p)),
-      layout(new QVBoxLayout(widget)),
+      visible(0),
       size(0, 0) {
     widget->hide();
     widget->setContentsMargins(0, 0, 0, 0);
     widget->setSizePolicy(QSizePolicy::Maximum,
                           QSizePolicy::Maximum);
     widget->setFocusPolicy(Qt::NoFocus);
-    widget->setStyleSheet(QString(
-          "color: %1"
-          "; background-color: %2")
-        .arg("#fdf4c1")
-        .arg("#494949") );
-    layout->setContentsMargins(0, 0, 0, 0);
-    layout->setSpacing(0);
-    widget->setLayout(layout);
+    widget->setAutoFillBackground(true);
+    QPalette pal = widget->palette();
+    pal.setColor(QPalette::WindowText, QColor("#fdf4c1"));
+    pal.setColor(QPalette::Window, QColor("#494949"));
+    widget->setPalette(pal);
     widget->setLineWidth(0);
+
+    activeFormat.setForeground(QColor(Qt::red));
+    activeFormat.setFontUnderline(true);
+
+    lines.reserve(maxLines);
+    for(auto idx = 0; idx < maxLines; idx++) {
+      lines.append(new SignatureLine(widget));
+    }
   }
 
-  QFrame* createSeperator() {
-    auto* line = new QFrame(widget);
-    line->setFrameShape(QFrame::HLine); // Horizontal line
-    line->setFrameShadow(QFrame::Plain);
-    line->setLineWidth(1);
-    return line;
+  /// Set the text of the next line, see SignatureLine::setText()
+  void addItem(QString const& text, int activeStart = -1,
+      int activeLength = 0) {
+    if(visible == lines.size()) {
+      return;
+    }
+    if(font != parent->font()) {
+      font = parent->font();
+      fm = QFontMetrics(font);
+    }
+    lines[visible++]->setText(text, activeStart, activeLength,
+        font, activeFormat);
   }
 
-  void addItem(QString const& text, bool last,
-      Qt::TextFormat format = Qt::RichText) {
-    auto* label = new QLabel(text);
-    label->setFrameStyle(QFrame::Panel | QFrame::Raised);
-
-    auto font = parent->font();
-    label->setFont(font);
-    label->setTextFormat(format);
-    layout->addWidget(label);
-    auto fm = QFontMetrics(font);
-    size = QSize(std::max(size.width(), label->minimumSizeHint().width()),
-                 fm.height() + size.height()+3);
+  /// Hide lines that were not set since clear(), and resize the popup
+  void finish() {
+    auto lineHeight = fm.height() + 3;
+    auto width = 0;
+    for(auto idx = 0; idx < visible; idx++) {
+      width = std::max(width, lines[idx]->naturalWidth());
+    }
+    for(auto idx = 0; idx < lines.size(); idx++) {
+      if(idx < visible) {
+        lines[idx]->setGeometry(0, idx*lineHeight, width, lineHeight);
+        lines[idx]->show();
+      } else if(!lines[idx]->isHidden()) {
+        lines[idx]->hide();
+      }
+    }
+    size = QSize(width, visible*lineHeight);
   }
 
   void clear() {
-    size = QSize(0, 0);
-    while(layout->count()) {
-      delete layout->takeAt(0);
-    }
+    visible = 0;
   }
 
-  int count() const { return layout->count(); }
+  int count() const { return visible; }
 
   bool isVisible() { return widget->isVisible(); }
   void move(int x, int y) { widget->move(x, y); }
 
   void show() {
-    widget->setMaximumHeight(size.height());
-    widget->setMaximumWidth(size.width());
-    widget->setMinimumHeight(size.height());
-    widget->setMinimumWidth(size.width());
+    if(widget->size() != size) {
+      widget->setFixedSize(size);
+    }
     widget->show();
   }
 
@@ -90,9 +174,13 @@ public:
 private:
   QWidget* parent;
   QFrame* widget;
-  QVBoxLayout* layout;
-  QFrame* frame;
+  QVector<SignatureLine*> lines;
+  /// Number of lines in use
+  int visible;
   QSize size;
+  QFont font;
+  QFontMetrics fm{QFont()};
+  QTextCharFormat activeFormat;
 };
 
 Signature::Signature(QWidget* p,
@@ -141,24 +229,29 @@ QString makeSigText(
   return text;
 }
 
+/// The signature text, the range of the active parameter is stored in
+/// activeStart/activeLength (-1 and 0 if there is none)
 QString makeActiveSigText(
     Signature::SigInfo const& signature,
     Signature::Seperators const& sep,
-    int active_param) {
-  if(active_param < 0) {
+    int active_param,
+    int* activeStart,
+    int* activeLength) {
+  *activeStart = -1;
+  *activeLength = 0;
+  if(active_param < 0 || active_param >= signature.params.size()) {
     return makeSigText(signature, sep);
   }
   auto seperator = QString("%1 ").arg(sep.sep);
-  auto text = QString("%1%2%3%4%5%6%7%8")
-    .arg(signature.label)
-    .arg(sep.start)
-    .arg(joinRange(signature.params, seperator, 0, active_param))
-    .arg(active_param > 0 ? seperator : "")
-    .arg(QString("<font style=\"text-decoration:underline\" color=\"red\">%1</font>")
-        .arg(signature.params[active_param]))
-    .arg(active_param + 1 < signature.params.size() ? seperator : "")
-    .arg(joinRange(signature.params, seperator, active_param + 1, signature.params.size()))
-    .arg(sep.stop);
+  auto text = signature.label + sep.start
+    + joinRange(signature.params, seperator, 0, active_param)
+    + (active_param > 0 ? seperator : "");
+  *activeStart = text.size();
+  *activeLength = signature.params[active_param].size();
+  text += signature.params[active_param]
+    + (active_param + 1 < signature.params.size() ? seperator : "")
+    + joinRange(signature.params, seperator, active_param + 1, signature.params.size())
+    + sep.stop;
   return text;
 }
 
@@ -180,11 +273,16 @@ void Signature::addItemsToWidget(
     int active_param,
     Seperators const& sep) {
   for(auto idx = 0; idx < signatures.size(); idx++) {
-    auto text = (idx != active_signature) ?
-      makeSigText(signatures[idx], sep) :
-      makeActiveSigText(signatures[idx], sep, active_param);
-    widget->addItem(text, idx == signatures.size()-1);
+    if(idx != active_signature) {
+      widget->addItem(makeSigText(signatures[idx], sep));
+    } else {
+      int start, length;
+      auto text = makeActiveSigText(signatures[idx], sep, active_param,
+          &start, &length);
+      widget->addItem(text, start, length);
+    }
   }
+  widget->finish();
 }
 
 void Signature::moveAndShowWidget() {
@@ -0,0 +1,78 @@
+#include <QSet>
+#include <QSignalBlocker>
+#include "tabline.h"
+
+namespace NeovimQt {
+
+/// Index of the tab with the given handle, starting the search at from,
+/// -1 if not found
+static int findTab(QTabBar *bar, int64_t handle, int from)
+{
+	for (int i=from; i<bar->count(); i++) {
+		if (bar->tabData(i).toLongLong() == handle) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/// Update the tabs in bar to match the tabs from redraw:tabline_update,
+/// tab data holds the tab handle. Tabs are matched by handle so only
+/// inserts, removes, moves and renames are applied, each of them makes
+/// QTabBar relayout. Returns the number of changes.
+///
+/// Signals are blocked during the update, the bar follows Neovim and
+/// must not send the tab changes back.
+int updateTabBar(QTabBar *bar, int64_t curtab, const QList<Tab>& tabs)
+{
+	QSignalBlocker blocker(bar);
+	// Paint once for all changes
+	bool updates = bar->updatesEnabled();
+	bar->setUpdatesEnabled(false);
+	int changes = 0;
+
+	QSet<int64_t> handles;
+	foreach(const Tab& tab, tabs) {
+		handles.insert(tab.tab);
+	}
+	for (int index=bar->count()-1; index>=0; index--) {
+		if (!handles.contains(bar->tabData(index).toLongLong())) {
+			bar->removeTab(index);
+			changes++;
+		}
+	}
+
+	for (int index=0; index<tabs.size(); index++) {
+		// Escape & in tab name otherwise it will be interpreted as
+		// a keyboard shortcut (#357) - escaping is done using &&
+		QString text = tabs[index].name;
+		text.replace("&", "&&");
+
+		int current = findTab(bar, tabs[index].tab, index);
+		if (current == -1) {
+			bar->insertTab(index, text);
+			bar->setTabData(index, QVariant::fromValue(tabs[index].tab));
+			changes++;
+			continue;
+		}
+		if (current != index) {
+			bar->moveTab(current, index);
+			changes++;
+		}
+		if (bar->tabText(index) != text) {
+			bar->setTabText(index, text);
+			changes++;
+		}
+	}
+
+	int curindex = findTab(bar, curtab, 0);
+	if (curindex != -1 && curindex != bar->currentIndex()) {
+		bar->setCurrentIndex(curindex);
+	}
+
+	bar->setUpdatesEnabled(updates);
+	Q_ASSERT(tabs.size() == bar->count());
+	return changes;
+}
+
+} // Namespace
@@ -0,0 +1,13 @@
+#ifndef NEOVIM_QT_TABLINE
+#define NEOVIM_QT_TABLINE
+
+#include <QTabBar>
+#include "shell.h"
+
+namespace NeovimQt {
+
+int updateTabBar(QTabBar *bar, int64_t curtab, const QList<Tab>& tabs);
+
+} // Namespace
+
+#endif
@@ -0,0 +1,238 @@
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#include "latencytrace.h"
+
+namespace NeovimQt {
+
+/**
+ * \class NeovimQt::LatencyTrace
+ *
+ * \brief Input to photon latency tracing
+ *
+ * Each input (e.g. a key press) opens a record, the tracepoints
+ * (RPC write, first redraw read, flush applied and paint end) are
+ * assigned to the oldest record that did not yet reach that point.
+ * A record is complete when a frame with its changes is painted.
+ *
+ * Tracing is disabled by default, when disabled every tracepoint
+ * is a single branch.
+ */
+
+bool LatencyTrace::s_enabled = false;
+QElapsedTimer LatencyTrace::s_clock;
+
+/// Records that were never completed after this time (us), e.g. an
+/// input that did not cause a redraw, are dropped
+static const qint64 PENDING_TIMEOUT = 2000000;
+/// Maximum number of completed records kept in memory
+static const int MAX_RECORDS = 100000;
+
+static const char *pointNames[] = {
+	"input",
+	"rpc write",
+	"redraw read",
+	"flush",
+	"paint",
+};
+
+QList<LatencyTrace::Record>& LatencyTrace::pending()
+{
+	static QList<Record> records;
+	return records;
+}
+
+QList<LatencyTrace::Record>& LatencyTrace::completed()
+{
+	static QList<Record> records;
+	return records;
+}
+
+void LatencyTrace::setEnabled(bool enabled)
+{
+	if (enabled && !s_clock.isValid()) {
+		s_clock.start();
+	}
+	s_enabled = enabled;
+}
+
+/// Discard all records
+void LatencyTrace::clear()
+{
+	pending().clear();
+	completed().clear();
+}
+
+/// Current trace time in microseconds
+qint64 LatencyTrace::now()
+{
+	return s_clock.nsecsElapsed() / 1000;
+}
+
+/// Start a new record for an input, name is a description of the input
+void LatencyTrace::input(const QString& name)
+{
+	if (!s_enabled) {
+		return;
+	}
+	Record r;
+	r.name = name;
+	r.time[InputCapture] = now();
+	for (int i=RpcWrite; i<PointCount; i++) {
+		r.time[i] = -1;
+	}
+	pending().append(r);
+}
+
+void LatencyTrace::mark(Point p)
+{
+	if (!s_enabled) {
+		return;
+	}
+	mark(p, now());
+}
+
+/// Mark tracepoint p, the timestamp is taken from now()
+///
+/// RpcWrite is assigned to one record, all other points to
+/// every record that reached the previous point. This way all
+/// inputs that are handled by the same redraw share its timing.
+void LatencyTrace::mark(Point p, qint64 timestamp)
+{
+	if (!s_enabled || p == InputCapture || pending().isEmpty()) {
+		return;
+	}
+
+	QList<Record>& records = pending();
+	for (int i=0; i<records.size(); i++) {
+		Record& r = records[i];
+		if (r.time[p] != -1 || r.time[p-1] == -1) {
+			continue;
+		}
+		r.time[p] = timestamp;
+		if (p == RpcWrite) {
+			break;
+		}
+	}
+
+	QList<Record>::iterator it = records.begin();
+	while (it != records.end()) {
+		if (it->time[PaintEnd] != -1) {
+			if (completed().size() >= MAX_RECORDS) {
+				completed().removeFirst();
+			}
+			completed().append(*it);
+			it = records.erase(it);
+		} else if (timestamp - it->time[InputCapture] > PENDING_TIMEOUT) {
+			it = records.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+/// The completed records in the Chrome trace event format, see
+/// chrome://tracing. Every input is an event with one nested
+/// event per stage.
+QByteArray LatencyTrace::chromeTrace()
+{
+	QJsonArray events;
+	int id = 0;
+	foreach(const Record& r, completed()) {
+		QJsonObject ev;
+		ev.insert("name", r.name);
+		ev.insert("cat", QString("input"));
+		ev.insert("ph", QString("X"));
+		ev.insert("pid", 1);
+		ev.insert("tid", 1);
+		ev.insert("ts", r.time[InputCapture]);
+		ev.insert("dur", r.time[PaintEnd] - r.time[InputCapture]);
+		QJsonObject args;
+		args.insert("id", id++);
+		ev.insert("args", args);
+		events.append(ev);
+
+		for (int i=InputCapture; i<PaintEnd; i++) {
+			QJsonObject stage;
+			stage.insert("name", QString("%1 -> %2")
+				.arg(pointNames[i]).arg(pointNames[i+1]));
+			stage.insert("cat", QString("stage"));
+			stage.insert("ph", QString("X"));
+			stage.insert("pid", 1);
+			stage.insert("tid", 1);
+			stage.insert("ts", r.time[i]);
+			stage.insert("dur", r.time[i+1] - r.time[i]);
+			events.append(stage);
+		}
+	}
+
+	QJsonObject root;
+	root.insert("traceEvents", events);
+	root.insert("displayTimeUnit", QString("ms"));
+	return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool LatencyTrace::writeChromeTrace(const QString& path)
+{
+	QFile f(path);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+	return f.write(chromeTrace()) != -1;
+}
+
+/// Value at percentile pct of a sorted list
+static qint64 percentile(const QVector<qint64>& sorted, int pct)
+{
+	if (sorted.isEmpty()) {
+		return 0;
+	}
+	int idx = (sorted.size() - 1) * pct / 100;
+	return sorted.at(idx);
+}
+
+static QString reportLine(const QString& name, QVector<qint64> values)
+{
+	std::sort(values.begin(), values.end());
+	return QString("%1 p50 %2ms p95 %3ms p99 %4ms")
+		.arg(name, -24)
+		.arg(percentile(values, 50)/1000.0, 0, 'f', 2)
+		.arg(percentile(values, 95)/1000.0, 0, 'f', 2)
+		.arg(percentile(values, 99)/1000.0, 0, 'f', 2);
+}
+
+/// A summary of the latency percentiles for the completed records,
+/// for the whole input to paint time and for each stage
+QString LatencyTrace::report()
+{
+	const QList<Record>& records = completed();
+	QStringList lines;
+	lines.append(QString("%1 inputs traced").arg(records.size()));
+	if (records.isEmpty()) {
+		return lines.join("\n");
+	}
+
+	QVector<qint64> total;
+	total.reserve(records.size());
+	foreach(const Record& r, records) {
+		total.append(r.time[PaintEnd] - r.time[InputCapture]);
+	}
+	lines.append(reportLine("input -> paint", total));
+
+	for (int i=InputCapture; i<PaintEnd; i++) {
+		QVector<qint64> stage;
+		stage.reserve(records.size());
+		foreach(const Record& r, records) {
+			stage.append(r.time[i+1] - r.time[i]);
+		}
+		lines.append(reportLine(QString("%1 -> %2")
+				.arg(pointNames[i]).arg(pointNames[i+1]), stage));
+	}
+	return lines.join("\n");
+}
+
+} // Namespace NeovimQt
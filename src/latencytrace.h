@@ -0,0 +1,52 @@
+#ifndef NEOVIM_QT_LATENCYTRACE
+#define NEOVIM_QT_LATENCYTRACE
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+namespace NeovimQt {
+
+class LatencyTrace
+{
+public:
+	/// Tracepoints in the order they are hit for a single input
+	enum Point {
+		InputCapture=0,
+		RpcWrite,
+		RedrawRead,
+		FlushApplied,
+		PaintEnd,
+		PointCount,
+	};
+
+	static inline bool isEnabled() {
+		return s_enabled;
+	}
+	static void setEnabled(bool);
+	static void clear();
+
+	static void input(const QString& name);
+	static void mark(Point p);
+	static void mark(Point p, qint64 timestamp);
+	static qint64 now();
+
+	static QByteArray chromeTrace();
+	static bool writeChromeTrace(const QString& path);
+	static QString report();
+
+private:
+	class Record {
+	public:
+		QString name;
+		qint64 time[PointCount];
+	};
+	static QList<Record>& pending();
+	static QList<Record>& completed();
+
+	static bool s_enabled;
+	static QElapsedTimer s_clock;
+};
+
+} // Namespace NeovimQt
+#endif
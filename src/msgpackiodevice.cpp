@@ -1,6 +1,9 @@
 #include <QAbstractSocket>
 #include <QTextCodec>
 #include <QSocketNotifier>
+#include <QElapsedTimer>
+#include <QDataStream>
+#include <QFile>
 
 // read/write
 #ifdef _WIN32
@@ -13,6 +16,7 @@
 #include "msgpackiodevice.h"
 #include "util.h"
 #include "msgpackrequest.h"
+#include "latencytrace.h"
 
 namespace NeovimQt {
 
@@ -23,6 +27,69 @@ namespace NeovimQt {
  *
  */
 
+/**
+ * The size of obj when encoded as msgpack, this is the number of bytes
+ * received for obj as long as the sender uses the smallest encoding
+ */
+static quint64 msgpackSize(const msgpack_object& obj)
+{
+	quint64 size;
+	switch (obj.type) {
+	case MSGPACK_OBJECT_POSITIVE_INTEGER:
+		if (obj.via.u64 < 128) {
+			return 1;
+		} else if (obj.via.u64 <= 0xff) {
+			return 2;
+		} else if (obj.via.u64 <= 0xffff) {
+			return 3;
+		} else if (obj.via.u64 <= 0xffffffff) {
+			return 5;
+		}
+		return 9;
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+		if (obj.via.i64 >= -32) {
+			return 1;
+		} else if (obj.via.i64 >= -128) {
+			return 2;
+		} else if (obj.via.i64 >= -32768) {
+			return 3;
+		} else if (obj.via.i64 >= -2147483648LL) {
+			return 5;
+		}
+		return 9;
+	case MSGPACK_OBJECT_FLOAT:
+		return 9;
+	case MSGPACK_OBJECT_STR:
+		size = obj.via.str.size;
+		return size + (size < 32 ? 1 : size < 256 ? 2 : size < 65536 ? 3 : 5);
+	case MSGPACK_OBJECT_BIN:
+		size = obj.via.bin.size;
+		return size + (size < 256 ? 2 : size < 65536 ? 3 : 5);
+	case MSGPACK_OBJECT_EXT:
+		size = obj.via.ext.size;
+		if (size == 1 || size == 2 || size == 4 || size == 8 || size == 16) {
+			return size + 2;
+		}
+		return size + (size < 256 ? 3 : size < 65536 ? 4 : 6);
+	case MSGPACK_OBJECT_ARRAY:
+		size = obj.via.array.size < 16 ? 1 : obj.via.array.size < 65536 ? 3 : 5;
+		for (uint32_t i=0; i<obj.via.array.size; i++) {
+			size += msgpackSize(obj.via.array.ptr[i]);
+		}
+		return size;
+	case MSGPACK_OBJECT_MAP:
+		size = obj.via.map.size < 16 ? 1 : obj.via.map.size < 65536 ? 3 : 5;
+		for (uint32_t i=0; i<obj.via.map.size; i++) {
+			size += msgpackSize(obj.via.map.ptr[i].key);
+			size += msgpackSize(obj.via.map.ptr[i].val);
+		}
+		return size;
+	default:
+		// nil, boolean
+		return 1;
+	}
+}
+
 /**
  * Build a MsgpackIODevice that reads from stdin and writes to
  * stdout
@@ -45,7 +112,9 @@ MsgpackIODevice* MsgpackIODevice::fromStdinOut(QObject *parent)
 }
 
 MsgpackIODevice::MsgpackIODevice(QIODevice *dev, QObject *parent)
-:QObject(parent), m_reqid(0), m_dev(dev), m_encoding(0), m_reqHandler(0), m_error(NoError)
+:QObject(parent), m_reqid(0), m_dev(dev), m_encoding(0), m_reqHandler(0), m_error(NoError),
+	m_readTime(0), m_outBytes(0), m_outPending(false), m_capture(0),
+	m_framed(false), m_compressionPending(false), m_compressionRequest(0)
 {
 	qRegisterMetaType<MsgpackError>("MsgpackError");
 	msgpack_unpacker_init(&m_uk, MSGPACK_UNPACKER_INIT_BUFFER_SIZE);
@@ -113,7 +182,10 @@ int MsgpackIODevice::msgpack_write_to_stdout(void* data, const char* buf, unsign
 	qint64 bytes = write(1, buf, len);
 	if (bytes == -1) {
 		c->setError(InvalidDevice, tr("Error writing to device"));
+	} else {
+		c->m_outBytes += bytes;
 	}
+	LatencyTrace::mark(LatencyTrace::RpcWrite);
 	return bytes;
 }
 
@@ -123,7 +195,10 @@ int MsgpackIODevice::msgpack_write_to_dev(void* data, const char* buf, unsigned
 	qint64 bytes = c->m_dev->write(buf, len);
 	if (bytes == -1) {
 		c->setError(InvalidDevice, tr("Error writing to device"));
+	} else {
+		c->m_outBytes += bytes;
 	}
+	LatencyTrace::mark(LatencyTrace::RpcWrite);
 	return bytes;
 }
 
@@ -138,13 +213,11 @@ void MsgpackIODevice::dataAvailableStdin(const QByteArray& data)
 		setError(InvalidDevice, tr("Error when reading from stdin, BUG(buffered data exceeds capaciy)"));
 		return;
 	} else if ( data.length() > 0 ) {
-		memcpy(msgpack_unpacker_buffer(&m_uk), data.constData(), data.length());
-		msgpack_unpacker_buffer_consumed(&m_uk, data.length());
-		msgpack_unpacked result;
-		msgpack_unpacked_init(&result);
-		while(msgpack_unpacker_next(&m_uk, &result)) {
-			dispatch(result.data);
+		if (LatencyTrace::isEnabled()) {
+			m_readTime = LatencyTrace::now();
 		}
+		memcpy(msgpack_unpacker_buffer(&m_uk), data.constData(), data.length());
+		inputReceived(data.length());
 	}
 }
 
@@ -165,12 +238,10 @@ void MsgpackIODevice::dataAvailableFd(int fd)
 	qint64 bytes = read(fd, msgpack_unpacker_buffer(&m_uk),
 			msgpack_unpacker_buffer_capacity(&m_uk));
 	if (bytes > 0) {
-		msgpack_unpacker_buffer_consumed(&m_uk, bytes);
-		msgpack_unpacked result;
-		msgpack_unpacked_init(&result);
-		while(msgpack_unpacker_next(&m_uk, &result)) {
-			dispatch(result.data);
+		if (LatencyTrace::isEnabled()) {
+			m_readTime = LatencyTrace::now();
 		}
+		inputReceived(bytes);
 	} else if (bytes == -1) {
 		setError(InvalidDevice, tr("Error when reading from device"));
 	}
@@ -194,16 +265,109 @@ void MsgpackIODevice::dataAvailable()
 
 		read = m_dev->read(msgpack_unpacker_buffer(&m_uk), msgpack_unpacker_buffer_capacity(&m_uk));
 		if ( read > 0 ) {
-			msgpack_unpacker_buffer_consumed(&m_uk, read);
-			msgpack_unpacked result;
-			msgpack_unpacked_init(&result);
-			while(msgpack_unpacker_next(&m_uk, &result)) {
-				dispatch(result.data);
+			if (LatencyTrace::isEnabled()) {
+				m_readTime = LatencyTrace::now();
 			}
+			inputReceived(read);
+		}
+	}
+}
+
+/**
+ * Process bytes that were read into the unpacker buffer
+ */
+void MsgpackIODevice::inputReceived(qint64 bytes)
+{
+	if (m_framed) {
+		m_frames.append(msgpack_unpacker_buffer(&m_uk), bytes);
+		decodeFrames();
+		return;
+	}
+
+	const char *data = msgpack_unpacker_buffer(&m_uk);
+	msgpack_unpacker_buffer_consumed(&m_uk, bytes);
+	unpackMessages();
+	if (m_framed) {
+		// Neovim enabled compression, the input after the last message
+		// are frames
+		qint64 rest = m_uk.used - m_uk.off;
+		m_frames.append(m_uk.buffer + m_uk.off, rest);
+		m_uk.used = m_uk.off;
+		if (m_capture) {
+			capture(data, bytes - rest);
+		}
+		decodeFrames();
+	} else if (m_capture) {
+		capture(data, bytes);
+	}
+}
+
+/**
+ * Dispatch the messages in the unpacker buffer, stops if compression
+ * is enabled by one of the messages
+ */
+void MsgpackIODevice::unpackMessages()
+{
+	bool framed = m_framed;
+	msgpack_unpacked result;
+	msgpack_unpacked_init(&result);
+	while(framed == m_framed && msgpack_unpacker_next(&m_uk, &result)) {
+		dispatch(result.data);
+	}
+}
+
+/**
+ * Decompress complete frames and dispatch their messages. Frames are
+ * counted as "frame" (bytes received) and "frame:decoded" (message bytes)
+ * in the stats.
+ */
+void MsgpackIODevice::decodeFrames()
+{
+	QByteArray msg;
+	int frameSize = 0;
+	QElapsedTimer timer;
+	timer.start();
+	FrameDecoder::Status status;
+	while ((status = m_frames.next(msg, &frameSize)) == FrameDecoder::FrameReady) {
+		m_stats.addIncoming("frame", 1, frameSize, timer.nsecsElapsed());
+		m_stats.addIncoming("frame:decoded", 1, msg.size(), 0);
+		if (m_capture) {
+			capture(msg.constData(), msg.size());
+		}
+		if ( !msgpack_unpacker_reserve_buffer(&m_uk, msg.size()) ) {
+			qFatal("Could not allocate memory in unpack buffer");
+			return;
 		}
+		memcpy(msgpack_unpacker_buffer(&m_uk), msg.constData(), msg.size());
+		msgpack_unpacker_buffer_consumed(&m_uk, msg.size());
+		unpackMessages();
+		timer.restart();
+	}
+	if (status == FrameDecoder::InvalidFrame) {
+		setError(InvalidMsgpack, tr("Received an invalid compressed frame"));
 	}
 }
 
+/**
+ * Ask Neovim to compress the messages it sends, see
+ * nvim_set_compression(). Messages after the response are decoded
+ * as compressed frames.
+ */
+MsgpackRequest* MsgpackIODevice::requestCompression()
+{
+	MsgpackRequest *r = startRequestUnchecked("nvim_set_compression", 1);
+	send(QByteArray("lz4"));
+	m_compressionPending = true;
+	m_compressionRequest = r->id;
+	return r;
+}
+
+/** True if Neovim is sending compressed frames */
+bool MsgpackIODevice::isCompressed() const
+{
+	return m_framed;
+}
+
 /**
  * Send error response for the given request message
  */
@@ -217,6 +381,7 @@ void MsgpackIODevice::sendError(const msgpack_object& req, const QString& msg)
 
 void MsgpackIODevice::sendError(uint64_t msgid, const QString& msg)
 {
+	beginOutgoing("error");
 	// [type(1), msgid, error, result(nil)]
 	msgpack_pack_array(&m_pk, 4);
 	msgpack_pack_int(&m_pk, 1); // 1 = Response
@@ -299,6 +464,8 @@ void MsgpackIODevice::dispatchRequest(msgpack_object& req)
 	QByteArray errmsg("Unknown method");
 	QVariant params;
 	QByteArray method;
+	QElapsedTimer timer;
+	timer.start();
 
 	if (!m_reqHandler) {
 		goto err;
@@ -312,11 +479,15 @@ void MsgpackIODevice::dispatchRequest(msgpack_object& req)
 		qDebug() << "Found unexpected parameters in request" << req;
 		goto err;
 	}
+	m_stats.addIncoming(method, 1, msgpackSize(req), timer.nsecsElapsed());
+	timer.restart();
 	m_reqHandler->handleRequest(this, msgid, method, params.toList());
+	m_stats.addHandlerTime(method, timer.nsecsElapsed());
 	return;
 
 err:
 	// Send error reply [type(1), msgid, error, NIL]
+	beginOutgoing("error");
 	msgpack_pack_array(&m_pk, 4);
 	msgpack_pack_int(&m_pk, 1);
 	msgpack_pack_int(&m_pk, msgid);
@@ -341,6 +512,7 @@ bool MsgpackIODevice::sendResponse(uint64_t msgid, const QVariant& err, const QV
 		return false;
 	}
 
+	beginOutgoing("response");
 	msgpack_pack_array(&m_pk, 4);
 	msgpack_pack_int(&m_pk, 1);
 	msgpack_pack_int(&m_pk, msgid);
@@ -359,6 +531,7 @@ bool MsgpackIODevice::sendNotification(const QByteArray& method, const QVariantL
 		return false;
 	}
 
+	beginOutgoing(method);
 	msgpack_pack_array(&m_pk, 3);
 	msgpack_pack_int(&m_pk, 2);
 	send(method);
@@ -381,7 +554,14 @@ void MsgpackIODevice::dispatchResponse(msgpack_object& resp)
 		return;
 	}
 
+	if (m_compressionPending && msgid == m_compressionRequest) {
+		m_compressionPending = false;
+		m_framed = resp.via.array.ptr[2].type == MSGPACK_OBJECT_NIL;
+	}
+
 	MsgpackRequest *req = m_requests.take(msgid);
+	QElapsedTimer timer;
+	timer.start();
 	if ( resp.via.array.ptr[2].type != MSGPACK_OBJECT_NIL ) {
 		// Error response
 		QVariant val;
@@ -389,6 +569,8 @@ void MsgpackIODevice::dispatchResponse(msgpack_object& resp)
 			qWarning() << "Error decoding response error object";
 			goto err;
 		}
+		m_stats.addIncoming("response", 1, msgpackSize(resp), timer.nsecsElapsed());
+		timer.restart();
 		emit req->error(req->id, req->function(), val);
 	} else {
 		QVariant val;
@@ -396,8 +578,11 @@ void MsgpackIODevice::dispatchResponse(msgpack_object& resp)
 			qWarning() << "Error decoding response object";
 			goto err;
 		}
+		m_stats.addIncoming("response", 1, msgpackSize(resp), timer.nsecsElapsed());
+		timer.restart();
 		emit req->finished(req->id, req->function(), val);
 	}
+	m_stats.addHandlerTime("response", timer.nsecsElapsed());
 err:
 	req->deleteLater();
 }
@@ -414,19 +599,128 @@ QList<quint32> MsgpackIODevice::pendingRequests() const
  */
 void MsgpackIODevice::dispatchNotification(msgpack_object& nt)
 {
+	QElapsedTimer timer;
+	timer.start();
 	QByteArray methodName;
 	if (decodeMsgpack(nt.via.array.ptr[1], methodName)) {
 		qDebug() << "Received Invalid notification: event MUST be a String";
 		return;
 	}
 
-	QVariant val; 
-	if (decodeMsgpack(nt.via.array.ptr[2], val) ||
+	const msgpack_object& params = nt.via.array.ptr[2];
+	QVariant val;
+	if (methodName == "redraw" && params.type == MSGPACK_OBJECT_ARRAY) {
+		// Decode each update on its own, to count them separately
+		QVariantList updates;
+		for (uint32_t i=0; i<params.via.array.size; i++) {
+			const msgpack_object& update = params.via.array.ptr[i];
+			QElapsedTimer updateTimer;
+			updateTimer.start();
+			QVariant v;
+			if (decodeMsgpack(update, v)) {
+				qDebug() << "Unable to unpack notification parameters" << nt;
+				return;
+			}
+			updates.append(v);
+
+			// [name, [args...], [args...], ...]
+			if (update.type == MSGPACK_OBJECT_ARRAY && update.via.array.size > 0) {
+				QByteArray name;
+				if (!decodeMsgpack(update.via.array.ptr[0], name)) {
+					m_stats.addIncoming("redraw:" + name,
+							update.via.array.size - 1,
+							msgpackSize(update),
+							updateTimer.nsecsElapsed());
+				}
+			}
+		}
+		val = updates;
+	} else if (decodeMsgpack(params, val) ||
 			(QMetaType::Type)val.type() != QMetaType::QVariantList  ) {
 		qDebug() << "Unable to unpack notification parameters" << nt;
 		return;
 	}
+	m_stats.addIncoming(methodName, 1, msgpackSize(nt), timer.nsecsElapsed());
+
+	if (methodName == "redraw") {
+		LatencyTrace::mark(LatencyTrace::RedrawRead, m_readTime);
+	}
+	timer.restart();
 	emit notification(methodName, val.toList());
+	m_stats.addHandlerTime(methodName, timer.nsecsElapsed());
+}
+
+/**
+ * Start counting written bytes for a new outgoing message
+ */
+void MsgpackIODevice::beginOutgoing(const QByteArray& method)
+{
+	flushOutgoing();
+	m_outMethod = method;
+	m_outPending = true;
+}
+
+/**
+ * Add the bytes written since the last call to the stats of the
+ * current outgoing message
+ */
+void MsgpackIODevice::flushOutgoing()
+{
+	if (m_outPending || m_outBytes) {
+		m_stats.addOutgoing(m_outMethod, m_outPending ? 1 : 0, m_outBytes);
+	}
+	m_outPending = false;
+	m_outBytes = 0;
+}
+
+/**
+ * Start writing all inbound data to a capture file, any previous
+ * capture is stopped. The capture can be replayed with ReplayDevice.
+ * Compressed frames are written after decoding.
+ *
+ * The file starts with the 8 byte magic "NVQTCAP1", followed by one
+ * record per read: the time since the capture started in microseconds
+ * (quint64), the data length (quint32) and the data, integers are big
+ * endian.
+ */
+bool MsgpackIODevice::startCapture(const QString& path)
+{
+	stopCapture();
+	QFile *f = new QFile(path, this);
+	if (!f->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning() << "Unable to open capture file" << path << f->errorString();
+		delete f;
+		return false;
+	}
+	f->write("NVQTCAP1", 8);
+	m_capture = f;
+	m_captureTime.start();
+	return true;
+}
+
+void MsgpackIODevice::stopCapture()
+{
+	if (m_capture) {
+		m_capture->close();
+		delete m_capture;
+		m_capture = 0;
+	}
+}
+
+void MsgpackIODevice::capture(const char *data, qint64 len)
+{
+	QDataStream out(m_capture);
+	out << (quint64)(m_captureTime.nsecsElapsed() / 1000) << (quint32)len;
+	out.writeRawData(data, len);
+}
+
+/**
+ * Traffic counters for this channel
+ */
+RpcStats& MsgpackIODevice::stats()
+{
+	flushOutgoing();
+	return m_stats;
 }
 
 /**
@@ -463,11 +757,12 @@ QString MsgpackIODevice::errorString() const
 MsgpackRequest* MsgpackIODevice::startRequestUnchecked(const QString& method, quint32 argcount)
 {
 	quint32 msgid = msgId();
+	const QByteArray& utf8 = method.toUtf8();
+	beginOutgoing(utf8);
 	// [type(0), msgid, method, args]
 	msgpack_pack_array(&m_pk, 4);
 	msgpack_pack_int(&m_pk, 0);
 	msgpack_pack_int(&m_pk, msgid);
-	const QByteArray& utf8 = method.toUtf8();
 	msgpack_pack_bin(&m_pk, utf8.size());
 	msgpack_pack_bin_body(&m_pk, utf8.constData(), utf8.size());
 	msgpack_pack_array(&m_pk, argcount);
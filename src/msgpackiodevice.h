@@ -3,7 +3,12 @@
 
 #include <QIODevice>
 #include <QHash>
+#include <QElapsedTimer>
 #include <msgpack.h>
+#include "rpcstats.h"
+#include "framedecoder.h"
+
+class QFile;
 
 namespace NeovimQt {
 
@@ -67,6 +72,12 @@ public:
 	void registerExtType(int8_t type, msgpackExtDecoder);
 
 	QList<quint32> pendingRequests() const;
+	RpcStats& stats();
+
+	bool startCapture(const QString& path);
+	void stopCapture();
+	MsgpackRequest* requestCompression();
+	bool isCompressed() const;
 signals:
 	void error(MsgpackError);
 	/** A notification with the given name and arguments was received */
@@ -79,6 +90,12 @@ protected:
 	void dispatchRequest(msgpack_object& obj);
 	void dispatchResponse(msgpack_object& obj);
 	void dispatchNotification(msgpack_object& obj);
+	void beginOutgoing(const QByteArray& method);
+	void flushOutgoing();
+	void capture(const char *data, qint64 len);
+	void inputReceived(qint64 bytes);
+	void unpackMessages();
+	void decodeFrames();
 
 	bool decodeMsgpack(const msgpack_object& in, int64_t& out);
 	bool decodeMsgpack(const msgpack_object& in, QVariant& out);
@@ -112,6 +129,21 @@ private:
 
 	QString m_errorString;
 	MsgpackError m_error;
+	/// Trace time of the last read, see LatencyTrace
+	qint64 m_readTime;
+	RpcStats m_stats;
+	/// Method of the message being written, and its size so far
+	QByteArray m_outMethod;
+	quint64 m_outBytes;
+	bool m_outPending;
+	/// Capture file for inbound data, see startCapture()
+	QFile *m_capture;
+	QElapsedTimer m_captureTime;
+	/// True once Neovim sends compressed frames, see requestCompression()
+	bool m_framed;
+	FrameDecoder m_frames;
+	bool m_compressionPending;
+	quint32 m_compressionRequest;
 };
 
 class MsgpackRequestHandler {
@@ -26,7 +26,8 @@ NeovimConnector::NeovimConnector(QIODevice *dev)
 
 NeovimConnector::NeovimConnector(MsgpackIODevice *dev)
 :QObject(), m_dev(dev), m_helper(0), m_error(NoError), m_api0(NULL), m_api1(NULL), m_api2(NULL),
-	m_channel(0), m_api_compat(0), m_api_supported(0), m_ctype(OtherConnection), m_ready(false), m_timeout(10000)
+	m_channel(0), m_api_compat(0), m_api_supported(0), m_ctype(OtherConnection), m_ready(false), m_timeout(10000),
+	m_compression(false)
 {
 	m_helper = new NeovimConnectorHelper(this);
 	qRegisterMetaType<NeovimError>("NeovimError");
@@ -373,18 +374,22 @@ NeovimConnector::NeovimConnectionType NeovimConnector::connectionType()
  */
 NeovimConnector* NeovimConnector::reconnect()
 {
+	NeovimConnector *c;
 	switch(m_ctype) {
 	case SpawnedConnection:
-		return NeovimConnector::spawn(m_spawnArgs, m_spawnExe);
+		c = NeovimConnector::spawn(m_spawnArgs, m_spawnExe);
+		break;
 	case HostConnection:
-		return NeovimConnector::connectToHost(m_connHost, m_connPort);
+		c = NeovimConnector::connectToHost(m_connHost, m_connPort);
+		break;
 	case SocketConnection:
-		return NeovimConnector::connectToSocket(m_connSocket);
+		c = NeovimConnector::connectToSocket(m_connSocket);
+		break;
 	default:
 		return NULL;
 	}
-	// NOT-REACHED
-	return NULL;
+	c->setCompression(m_compression);
+	return c;
 }
 
 /** The minimum API level supported by this instance */
@@ -398,6 +403,71 @@ quint64 NeovimConnector::apiLevel()
 	return m_api_supported;
 }
 
+/**
+ * True if this instance of Neovim supports the given UI option
+ * (e.g. ext_multigrid), as listed in the API metadata
+ */
+bool NeovimConnector::hasUIOption(const QString& option)
+{
+	return m_ui_options.contains(option);
+}
+
+/**
+ * Traffic counters for the connection to Neovim
+ */
+RpcStats* NeovimConnector::rpcStats()
+{
+	return &m_dev->stats();
+}
+
+/**
+ * Write all data received from Neovim to a capture file
+ *
+ * \see MsgpackIODevice::startCapture
+ */
+bool NeovimConnector::startCapture(const QString& path)
+{
+	return m_dev->startCapture(path);
+}
+
+/**
+ * Call a Neovim API function that has no generated binding, e.g. functions
+ * newer than the API level of the bindings. The caller should check that
+ * the function exists.
+ */
+MsgpackRequest* NeovimConnector::request(const QString& method, const QVariantList& args)
+{
+	MsgpackRequest *r = m_dev->startRequestUnchecked(method, args.size());
+	foreach(const QVariant& arg, args) {
+		m_dev->send(arg);
+	}
+	return r;
+}
+
+/**
+ * Ask Neovim to compress the data it sends, if it supports
+ * nvim_set_compression(). Useful for remote connections, call this
+ * before the connector is ready.
+ */
+void NeovimConnector::setCompression(bool enabled)
+{
+	m_compression = enabled;
+}
+
+/** True if Neovim is sending compressed data */
+bool NeovimConnector::isCompressed()
+{
+	return m_dev->isCompressed();
+}
+
+/**
+ * Set the handler for requests sent by Neovim
+ */
+void NeovimConnector::setRequestHandler(MsgpackRequestHandler *h)
+{
+	m_dev->setRequestHandler(h);
+}
+
 /**
  * \fn NeovimQt::NeovimConnector::error(NeovimError)
  *
@@ -12,7 +12,10 @@
 namespace NeovimQt {
 
 class MsgpackIODevice;
+class MsgpackRequest;
+class MsgpackRequestHandler;
 class NeovimConnectorHelper;
+class RpcStats;
 class NeovimConnector: public QObject
 {
 	friend class NeovimApi0;
@@ -82,6 +85,13 @@ public:
 
 	quint64 apiCompatibility();
 	quint64 apiLevel();
+	bool hasUIOption(const QString&);
+	RpcStats* rpcStats();
+	void setRequestHandler(MsgpackRequestHandler *);
+	bool startCapture(const QString& path);
+	MsgpackRequest* request(const QString& method, const QVariantList& args);
+	void setCompression(bool);
+	bool isCompressed();
 
 signals:
 	/** Emitted when Neovim is ready @see ready */
@@ -114,6 +124,7 @@ private:
 	quint64 m_channel;
 	quint64 m_api_compat;
 	quint64 m_api_supported;
+	QStringList m_ui_options;
 
 	// Store connection arguments for reconnect()
 	NeovimConnectionType m_ctype;
@@ -123,6 +134,7 @@ private:
 	int m_connPort;
 	bool m_ready;
 	int m_timeout;
+	bool m_compression;
 };
 } // namespace NeovimQt
 Q_DECLARE_METATYPE(NeovimQt::NeovimConnector::NeovimError)
@@ -54,6 +54,26 @@ void NeovimConnectorHelper::handleMetadata(quint32 msgid, quint64, const QVarian
 	m_c->m_api_compat = api_compat;
 	m_c->m_api_supported = api_level;
 
+	m_c->m_ui_options.clear();
+	foreach(const QVariant& opt, metadata.value("ui_options").toList()) {
+		m_c->m_ui_options.append(opt.toString());
+	}
+
+	if (m_c->m_compression) {
+		bool supported = false;
+		foreach(const QVariant& fun, metadata.value("functions").toList()) {
+			if (fun.toMap().value("name").toByteArray() == "nvim_set_compression") {
+				supported = true;
+				break;
+			}
+		}
+		if (supported) {
+			m_c->m_dev->requestCompression();
+		} else {
+			qWarning() << "Neovim does not support compression";
+		}
+	}
+
 #if 0
 	QMapIterator<QString,QVariant> it(metadata);
 	while (it.hasNext()) {
@@ -86,7 +86,7 @@ String buffer_get_line(Buffer buffer, Integer index, Error *err)
   String rv = { .size = 0 };
 
   index = convert_index(index);
-  Array slice = nvim_buf_get_lines(0, buffer, index, index+1, true, err);
+  Array slice = nvim_buf_get_lines(0, buffer, index, index+1, true, NULL, err);
 
   if (!ERROR_SET(err) && slice.size) {
     rv = slice.items[0].data.string;
@@ -209,7 +209,7 @@ ArrayOf(String) buffer_get_line_slice(Buffer buffer,
 {
   start = convert_index(start) + !include_start;
   end = convert_index(end) + include_end;
-  return nvim_buf_get_lines(0, buffer, start , end, false, err);
+  return nvim_buf_get_lines(0, buffer, start , end, false, NULL, err);
 }
 
 /// Gets a line-range from the buffer.
@@ -233,6 +233,7 @@ ArrayOf(String) nvim_buf_get_lines(uint64_t channel_id,
                                    Integer start,
                                    Integer end,
                                    Boolean strict_indexing,
+                                   Arena *arena,
                                    Error *err)
   FUNC_API_SINCE(1)
 {
@@ -262,21 +263,26 @@ ArrayOf(String) nvim_buf_get_lines(uint64_t channel_id,
     return rv;
   }
 
+  // Lines requested over RPC are allocated in the arena of the request, which
+  // is released at once after the response was sent
   rv.size = (size_t)(end - start);
-  rv.items = xcalloc(sizeof(Object), rv.size);
+  rv.items = arena ? arena_alloc(arena, rv.size * sizeof(Object))
+                   : xcalloc(sizeof(Object), rv.size);
 
   if (!buf_collect_lines(buf, rv.size, start,
-                         (channel_id != VIML_INTERNAL_CALL), &rv, err)) {
+                         (channel_id != VIML_INTERNAL_CALL), &rv, arena,
+                         err)) {
     goto end;
   }
 
 end:
   if (ERROR_SET(err)) {
-    for (size_t i = 0; i < rv.size; i++) {
-      xfree(rv.items[i].data.string.data);
+    if (!arena) {
+      for (size_t i = 0; i < rv.size; i++) {
+        xfree(rv.items[i].data.string.data);
+      }
+      xfree(rv.items);
     }
-
-    xfree(rv.items);
     rv.items = NULL;
   }
 
@@ -2,9 +2,11 @@
 #define NVIM_API_PRIVATE_DISPATCH_H
 
 #include "nvim/api/private/defs.h"
+#include "nvim/memory.h"
 
 typedef Object (*ApiDispatchWrapper)(uint64_t channel_id,
                                      Array args,
+                                     Arena *arena,
                                      Error *error);
 
 /// The rpc_method_handlers table, used in msgpack_rpc_dispatch(), stores
@@ -13,6 +15,8 @@ typedef struct {
   ApiDispatchWrapper fn;
   bool async;  // function is always safe to run immediately instead of being
                // put in a request queue for handling when nvim waits for input.
+  bool arena_return;  // the result is allocated in the arena passed to the
+                      // function (unless it is NULL) and must not be freed.
 } MsgpackRpcRequestHandler;
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
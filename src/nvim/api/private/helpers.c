@@ -740,10 +740,11 @@ String cstr_as_string(char *str) FUNC_ATTR_PURE
 /// @param replace_nl Replace newlines ("\n") with NUL
 /// @param start Line number to start from
 /// @param[out] l Lines are copied here
+/// @param arena Arena for the lines, NULL to allocate them on the heap
 /// @param err[out] Error, if any
 /// @return true unless `err` was set
 bool buf_collect_lines(buf_T *buf, size_t n, int64_t start, bool replace_nl,
-                       Array *l, Error *err)
+                       Array *l, Arena *arena, Error *err)
 {
   for (size_t i = 0; i < n; i++) {
     int64_t lnum = start + (int64_t)i;
@@ -756,7 +757,12 @@ bool buf_collect_lines(buf_T *buf, size_t n, int64_t start, bool replace_nl,
     }
 
     const char *bufstr = (char *)ml_get_buf(buf, (linenr_T)lnum, false);
-    Object str = STRING_OBJ(cstr_to_string(bufstr));
+    size_t len = strlen(bufstr);
+    Object str = STRING_OBJ(((String) {
+      .data = arena ? arena_memdupz(arena, bufstr, len)
+                    : xmemdupz(bufstr, len),
+      .size = len
+    }));
 
     if (replace_nl) {
       // Vim represents NULs as NLs, but this may confuse clients.
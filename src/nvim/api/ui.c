@@ -5,33 +5,54 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include <msgpack.h>
 
 #include "nvim/vim.h"
 #include "nvim/ui.h"
 #include "nvim/memory.h"
 #include "nvim/map.h"
 #include "nvim/msgpack_rpc/channel.h"
+#include "nvim/msgpack_rpc/helpers.h"
+#include "nvim/event/wstream.h"
 #include "nvim/api/ui.h"
 #include "nvim/api/private/defs.h"
 #include "nvim/api/private/helpers.h"
 #include "nvim/popupmnu.h"
 #include "nvim/cursor_shape.h"
 #include "nvim/highlight.h"
+#include "nvim/ui_shm.h"
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "api/ui.c.generated.h"
 # include "ui_events_remote.generated.h"
 #endif
 
+/// Memory kept by the redraw buffer of an UI between flushes
+#define UI_BUF_KEEP (1024 * 1024)
+
 typedef struct {
   uint64_t channel_id;
-  Array buffer;
+
+  // Pending redraw notification, events are packed as they are emitted
+  // and the message is sent by remote_ui_flush(). Array sizes are not
+  // known in advance, they are written as array32 and filled in later.
+  msgpack_sbuffer buf;
+  msgpack_packer pac;
+  size_t nevents;  // Number of events, 0 if the buffer is empty
+  size_t nevents_pos;  // Offset of the array of events
+  size_t ncalls;  // Number of calls bundled in the last event
+  size_t ncalls_pos;  // Offset of the array of the last event
+  size_t name_pos, name_len;  // Name of the last event, in buf
 
   int hl_id;  // current higlight for legacy put event
   Integer cursor_row, cursor_col;  // Intended visibule cursor position
 
   // Position of legacy cursor, used both for drawing and visible user cursor.
   Integer client_row, client_col;
+
+  UIShm *shm;  // Shared memory grid, see ui_shm.c
 } UIData;
 
 static PMap(uint64_t) *connected_uis = NULL;
@@ -50,7 +71,8 @@ void remote_ui_disconnect(uint64_t channel_id)
     return;
   }
   UIData *data = ui->data;
-  api_free_array(data->buffer);  // Destroy pending screen updates.
+  msgpack_sbuffer_destroy(&data->buf);  // Destroy pending screen updates.
+  ui_shm_close(data->shm);
   pmap_del(uint64_t)(connected_uis, channel_id);
   xfree(ui->data);
   ui->data = NULL;  // Flag UI as "stopped".
@@ -130,11 +152,30 @@ void nvim_ui_attach(uint64_t channel_id, Integer width, Integer height,
     ui->ui_ext[kUINewgrid] = true;
   }
 
+  UIShm *shm = NULL;
+  for (size_t i = 0; i < options.size; i++) {
+    if (strequal(options.items[i].key.data, "shm_path")) {
+      if (!ui->ui_ext[kUINewgrid]) {
+        api_set_error(err, kErrorTypeValidation,
+                      "shm_path requires ext_newgrid");
+      } else {
+        shm = ui_shm_open(options.items[i].value.data.string.data, err);
+      }
+      if (ERROR_SET(err)) {
+        xfree(ui);
+        return;
+      }
+    }
+  }
+
   UIData *data = xmalloc(sizeof(UIData));
   data->channel_id = channel_id;
-  data->buffer = (Array)ARRAY_DICT_INIT;
+  msgpack_sbuffer_init(&data->buf);
+  msgpack_packer_init(&data->pac, &data->buf, msgpack_sbuffer_write);
+  data->nevents = 0;
   data->hl_id = 0;
   data->client_col = -1;
+  data->shm = shm;
   ui->data = data;
 
   pmap_put(uint64_t)(connected_uis, channel_id, ui);
@@ -215,6 +256,17 @@ static void ui_set_option(UI *ui, bool init, String name, Object value,
     return;
   }
 
+  if (strequal(name.data, "shm_path")) {
+    // Opened by nvim_ui_attach(), once all options are known
+    if (!init) {
+      api_set_error(error, kErrorTypeValidation,
+                    "shm_path option cannot be changed");
+    } else if (value.type != kObjectTypeString) {
+      api_set_error(error, kErrorTypeValidation, "shm_path must be a String");
+    }
+    return;
+  }
+
   // LEGACY: Deprecated option, use `ext_cmdline` instead.
   bool is_popupmenu = strequal(name.data, "popupmenu_external");
 
@@ -245,27 +297,75 @@ static void ui_set_option(UI *ui, bool init, String name, Object value,
                 name.data);
 }
 
-/// Pushes data into UI.UIData, to be consumed later by remote_ui_flush().
-static void push_call(UI *ui, const char *name, Array args)
+/// Writes an array32 header with a size to be filled in by set_array_size()
+///
+/// @return offset of the header in the buffer
+static size_t pack_array_placeholder(UIData *data)
 {
-  Array call = ARRAY_DICT_INIT;
-  UIData *data = ui->data;
+  static const char header[5] = { (char)0xdd, 0, 0, 0, 0 };
+  size_t pos = data->buf.size;
+  msgpack_sbuffer_write(&data->buf, header, sizeof(header));
+  return pos;
+}
 
-  // To optimize data transfer(especially for "put"), we bundle adjacent
-  // calls to same method together, so only add a new call entry if the last
-  // method call is different from "name"
-  if (kv_size(data->buffer)) {
-    call = kv_A(data->buffer, kv_size(data->buffer) - 1).data.array;
-  }
+static void set_array_size(UIData *data, size_t pos, size_t size)
+{
+  assert(size <= UINT32_MAX);
+  uint8_t *p = (uint8_t *)data->buf.data + pos + 1;
+  p[0] = (uint8_t)(size >> 24);
+  p[1] = (uint8_t)(size >> 16);
+  p[2] = (uint8_t)(size >> 8);
+  p[3] = (uint8_t)size;
+}
 
-  if (!kv_size(call) || strcmp(kv_A(call, 0).data.string.data, name)) {
-    call = (Array)ARRAY_DICT_INIT;
-    ADD(data->buffer, ARRAY_OBJ(call));
-    ADD(call, STRING_OBJ(cstr_to_string(name)));
+/// Starts a call to the "name" UI event, the caller packs the arguments
+/// array into UIData.pac. Consumed later by remote_ui_flush().
+static void prepare_call(UI *ui, const char *name)
+{
+  UIData *data = ui->data;
+  size_t name_len = strlen(name);
+
+  if (!data->nevents) {
+    msgpack_pack_array(&data->pac, 3);
+    msgpack_pack_int(&data->pac, 2);
+    msgpack_pack_str(&data->pac, sizeof("redraw") - 1);
+    msgpack_pack_str_body(&data->pac, "redraw", sizeof("redraw") - 1);
+    data->nevents_pos = pack_array_placeholder(data);
+  } else if (name_len == data->name_len
+             && !memcmp(data->buf.data + data->name_pos, name, name_len)) {
+    // To optimize data transfer(especially for "put"), we bundle adjacent
+    // calls to same method together, so only add a new call entry if the
+    // last method call is different from "name"
+    data->ncalls++;
+    return;
+  } else {
+    set_array_size(data, data->ncalls_pos, data->ncalls + 1);
   }
 
-  ADD(call, ARRAY_OBJ(args));
-  kv_A(data->buffer, kv_size(data->buffer) - 1).data.array = call;
+  data->nevents++;
+  data->ncalls = 1;
+  data->ncalls_pos = pack_array_placeholder(data);
+  msgpack_pack_str(&data->pac, name_len);
+  data->name_pos = data->buf.size;
+  data->name_len = name_len;
+  msgpack_pack_str_body(&data->pac, name, name_len);
+}
+
+/// Pushes data into UI.UIData, to be consumed later by remote_ui_flush().
+/// Consumes args.
+static void push_call(UI *ui, const char *name, Array args)
+{
+  UIData *data = ui->data;
+  prepare_call(ui, name);
+  msgpack_rpc_from_array(args, &data->pac);
+  api_free_array(args);
+}
+
+static void pack_cstr(msgpack_packer *pac, const char *str)
+{
+  size_t len = strlen(str);
+  msgpack_pack_str(pac, len);
+  msgpack_pack_str_body(pac, str, len);
 }
 
 static void remote_ui_grid_clear(UI *ui, Integer grid)
@@ -276,6 +376,11 @@ static void remote_ui_grid_clear(UI *ui, Integer grid)
   }
   const char *name = ui->ui_ext[kUINewgrid] ? "grid_clear" : "clear";
   push_call(ui, name, args);
+
+  UIData *data = ui->data;
+  if (data->shm && grid == 1) {
+    ui_shm_clear(data->shm);
+  }
 }
 
 static void remote_ui_grid_resize(UI *ui, Integer grid,
@@ -289,6 +394,11 @@ static void remote_ui_grid_resize(UI *ui, Integer grid,
   ADD(args, INTEGER_OBJ(height));
   const char *name = ui->ui_ext[kUINewgrid] ? "grid_resize" : "resize";
   push_call(ui, name, args);
+
+  UIData *data = ui->data;
+  if (data->shm && grid == 1) {
+    ui_shm_resize(data->shm, (int)width, (int)height);
+  }
 }
 
 static void remote_ui_grid_scroll(UI *ui, Integer grid, Integer top,
@@ -305,6 +415,12 @@ static void remote_ui_grid_scroll(UI *ui, Integer grid, Integer top,
     ADD(args, INTEGER_OBJ(rows));
     ADD(args, INTEGER_OBJ(cols));
     push_call(ui, "grid_scroll", args);
+
+    UIData *data = ui->data;
+    if (data->shm && grid == 1) {
+      ui_shm_scroll(data->shm, (int)top, (int)bot, (int)left, (int)right,
+                    (int)rows);
+    }
   } else {
     Array args = ARRAY_DICT_INIT;
     ADD(args, INTEGER_OBJ(top));
@@ -430,9 +546,9 @@ static void remote_ui_put(UI *ui, const char *cell)
 {
   UIData *data = ui->data;
   data->client_col++;
-  Array args = ARRAY_DICT_INIT;
-  ADD(args, STRING_OBJ(cstr_to_string(cell)));
-  push_call(ui, "put", args);
+  prepare_call(ui, "put");
+  msgpack_pack_array(&data->pac, 1);
+  pack_cstr(&data->pac, cell);
 }
 
 static void remote_ui_raw_line(UI *ui, Integer grid, Integer row,
@@ -442,12 +558,21 @@ static void remote_ui_raw_line(UI *ui, Integer grid, Integer row,
                                const sattr_T *attrs)
 {
   UIData *data = ui->data;
-  if (ui->ui_ext[kUINewgrid]) {
-    Array args = ARRAY_DICT_INIT;
-    ADD(args, INTEGER_OBJ(grid));
-    ADD(args, INTEGER_OBJ(row));
-    ADD(args, INTEGER_OBJ(startcol));
-    Array cells = ARRAY_DICT_INIT;
+  if (data->shm && grid == 1
+      && ui_shm_raw_line(data->shm, row, startcol, endcol, clearcol,
+                         clearattr, chunk, attrs)) {
+    // Sent by remote_ui_flush() as a grid_shm event
+    return;
+  } else if (ui->ui_ext[kUINewgrid]) {
+    // Cells are packed directly, this is the bulk of the redraw traffic
+    msgpack_packer *pac = &data->pac;
+    prepare_call(ui, "grid_line");
+    msgpack_pack_array(pac, 4);
+    msgpack_pack_int64(pac, grid);
+    msgpack_pack_int64(pac, row);
+    msgpack_pack_int64(pac, startcol);
+    size_t cells_pos = pack_array_placeholder(data);
+    size_t cells = 0;
     int repeat = 0;
     size_t ncells = (size_t)(endcol-startcol);
     int last_hl = -1;
@@ -455,29 +580,28 @@ static void remote_ui_raw_line(UI *ui, Integer grid, Integer row,
       repeat++;
       if (i == ncells-1 || attrs[i] != attrs[i+1]
           || STRCMP(chunk[i], chunk[i+1])) {
-        Array cell = ARRAY_DICT_INIT;
-        ADD(cell, STRING_OBJ(cstr_to_string((const char *)chunk[i])));
-        if (attrs[i] != last_hl || repeat > 1) {
-          ADD(cell, INTEGER_OBJ(attrs[i]));
+        bool send_hl = attrs[i] != last_hl || repeat > 1;
+        msgpack_pack_array(pac, 1 + (send_hl ? 1 : 0) + (repeat > 1 ? 1 : 0));
+        pack_cstr(pac, (const char *)chunk[i]);
+        if (send_hl) {
+          msgpack_pack_int(pac, attrs[i]);
           last_hl = attrs[i];
         }
         if (repeat > 1) {
-          ADD(cell, INTEGER_OBJ(repeat));
+          msgpack_pack_int(pac, repeat);
         }
-        ADD(cells, ARRAY_OBJ(cell));
+        cells++;
         repeat = 0;
       }
     }
     if (endcol < clearcol) {
-      Array cell = ARRAY_DICT_INIT;
-      ADD(cell, STRING_OBJ(cstr_to_string(" ")));
-      ADD(cell, INTEGER_OBJ(clearattr));
-      ADD(cell, INTEGER_OBJ(clearcol-endcol));
-      ADD(cells, ARRAY_OBJ(cell));
+      msgpack_pack_array(pac, 3);
+      pack_cstr(pac, " ");
+      msgpack_pack_int64(pac, clearattr);
+      msgpack_pack_int64(pac, clearcol-endcol);
+      cells++;
     }
-    ADD(args, ARRAY_OBJ(cells));
-
-    push_call(ui, "grid_line", args);
+    set_array_size(data, cells_pos, cells);
   } else {
     for (int i = 0; i < endcol-startcol; i++) {
       remote_ui_cursor_goto(ui, row, startcol+i);
@@ -504,15 +628,67 @@ static void remote_ui_raw_line(UI *ui, Integer grid, Integer row,
   }
 }
 
+/// Copies the shared grid to the next snapshot, and tells the UI which
+/// rows changed with grid_shm events, [grid, generation, slot, top, bot]
+static void remote_ui_flush_shm(UI *ui)
+{
+  UIData *data = ui->data;
+  UIShm *shm = data->shm;
+  if (!shm || !shm->active) {
+    return;
+  }
+  bool dirty = false;
+  for (int row = 0; row < shm->height && !dirty; row++) {
+    dirty = shm->dirty[row];
+  }
+  if (!dirty) {
+    return;
+  }
+
+  uint32_t slot;
+  uint64_t generation = ui_shm_publish(shm, &slot);
+  int row = 0;
+  while (row < shm->height) {
+    if (!shm->dirty[row]) {
+      row++;
+      continue;
+    }
+    int top = row;
+    while (row < shm->height && shm->dirty[row]) {
+      shm->dirty[row++] = false;
+    }
+    Array args = ARRAY_DICT_INIT;
+    ADD(args, INTEGER_OBJ(1));
+    ADD(args, INTEGER_OBJ((Integer)generation));
+    ADD(args, INTEGER_OBJ(slot));
+    ADD(args, INTEGER_OBJ(top));
+    ADD(args, INTEGER_OBJ(row));
+    push_call(ui, "grid_shm", args);
+  }
+}
+
 static void remote_ui_flush(UI *ui)
 {
   UIData *data = ui->data;
-  if (data->buffer.size > 0) {
+  remote_ui_flush_shm(ui);
+  if (data->nevents > 0) {
     if (!ui->ui_ext[kUINewgrid]) {
       remote_ui_cursor_goto(ui, data->cursor_row, data->cursor_col);
     }
-    rpc_send_event(data->channel_id, "redraw", data->buffer);
-    data->buffer = (Array)ARRAY_DICT_INIT;
+    set_array_size(data, data->ncalls_pos, data->ncalls + 1);
+    set_array_size(data, data->nevents_pos, data->nevents);
+    WBuffer *buf = wstream_new_buffer(xmemdup(data->buf.data, data->buf.size),
+                                      data->buf.size, 1, xfree);
+    rpc_write_raw(data->channel_id, buf);
+
+    data->nevents = 0;
+    if (data->buf.alloc > UI_BUF_KEEP) {
+      // Don't hold on to the memory of a large redraw
+      msgpack_sbuffer_destroy(&data->buf);
+      msgpack_sbuffer_init(&data->buf);
+    } else {
+      msgpack_sbuffer_clear(&data->buf);
+    }
   }
 }
 
@@ -574,18 +750,10 @@ static void remote_ui_event(UI *ui, char *name, Array args, bool *args_consumed)
     }
   }
 
-  Array my_args = ARRAY_DICT_INIT;
-  // Objects are currently single-reference
-  // make a copy, but only if necessary
-  if (*args_consumed) {
-    for (size_t i = 0; i < args.size; i++) {
-      ADD(my_args, copy_object(args.items[i]));
-    }
-  } else {
-    my_args = args;
-    *args_consumed = true;
-  }
-  push_call(ui, name, my_args);
+  // Packed right away, so args are never consumed
+  UIData *data = ui->data;
+  prepare_call(ui, name);
+  msgpack_rpc_from_array(args, &data->pac);
 }
 
 static void remote_ui_inspect(UI *ui, Dictionary *info)
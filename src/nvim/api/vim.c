@@ -1062,6 +1062,31 @@ void nvim_set_client_info(uint64_t channel_id, String name,
   rpc_set_client_info(channel_id, info);
 }
 
+/// Compresses the messages sent to this channel, for clients on slow
+/// connections.
+///
+/// Messages after the response to this request are sent as frames: the byte
+/// 0xc1 (never used by msgpack), the message size and the payload size as
+/// big endian 32-bit integers, and the payload. The payload is the message
+/// compressed with the LZ4 block format, or the message itself when both
+/// sizes are equal. Each frame is compressed on its own. Messages sent by
+/// the client are not compressed.
+///
+/// @param codec Compression format, only "lz4" is supported
+void nvim_set_compression(uint64_t channel_id, String codec, Error *err)
+  FUNC_API_SINCE(5) FUNC_API_REMOTE_ONLY
+{
+  if (!strequal(codec.data, "lz4")) {
+    api_set_error(err, kErrorTypeValidation, "Unsupported codec: %s",
+                  codec.data);
+    return;
+  }
+  if (!rpc_set_compression(channel_id)) {
+    api_set_error(err, kErrorTypeException,
+                  "Channel does not support compression");
+  }
+}
+
 /// Get information about a channel.
 ///
 /// @returns a Dictionary, describing a channel with the
@@ -1081,6 +1106,8 @@ void nvim_set_client_info(uint64_t channel_id, String name,
 ///                 still be present to indicate a pty is used. This is
 ///                 currently the case when using winpty on windows.
 ///    -  "buffer"  buffer with connected |terminal| instance (optional)
+///    -  "scrollback_bytes"  memory used by the scrollback of the
+///                 |terminal| instance, in bytes (optional)
 ///    -  "client"  information about the client on the other end of the
 ///                 RPC channel, if it has added it using
 ///                 |nvim_set_client_info()|. (optional)
@@ -1171,7 +1198,7 @@ Array nvim_call_atomic(uint64_t channel_id, Array calls, Error *err)
     if (ERROR_SET(&nested_error)) {
       break;
     }
-    Object result = handler.fn(channel_id, args, &nested_error);
+    Object result = handler.fn(channel_id, args, NULL, &nested_error);
     if (ERROR_SET(&nested_error)) {
       // error handled after loop
       break;
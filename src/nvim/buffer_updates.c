@@ -55,7 +55,7 @@ bool buf_updates_register(buf_T *buf, uint64_t channel_id, bool send_buffer)
       linedata.size = line_count;
       linedata.items = xcalloc(sizeof(Object), line_count);
 
-      buf_collect_lines(buf, line_count, 1, true, &linedata, NULL);
+      buf_collect_lines(buf, line_count, 1, true, &linedata, NULL, NULL);
     }
 
     args.items[4] = ARRAY_OBJ(linedata);
@@ -164,7 +164,7 @@ void buf_updates_send_changes(buf_T *buf,
         linedata.size = (size_t)num_added;
         linedata.items = xcalloc(sizeof(Object), (size_t)num_added);
         buf_collect_lines(buf, (size_t)num_added, firstline, true, &linedata,
-                          NULL);
+                          NULL, NULL);
     }
     args.items[4] = ARRAY_OBJ(linedata);
     args.items[5] = BOOLEAN_OBJ(false);
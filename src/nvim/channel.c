@@ -808,6 +808,8 @@ Dictionary channel_info(uint64_t id)
   } else if (chan->term) {
     mode_desc = "terminal";
     PUT(info, "buffer", BUFFER_OBJ(terminal_buf(chan->term)));
+    PUT(info, "scrollback_bytes",
+        INTEGER_OBJ((Integer)terminal_scrollback_bytes(chan->term)));
   } else {
     mode_desc = "bytes";
   }
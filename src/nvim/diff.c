@@ -19,6 +19,8 @@
 #include "nvim/ex_docmd.h"
 #include "nvim/fileio.h"
 #include "nvim/fold.h"
+#include "nvim/linediff.h"
+#include "nvim/map.h"
 #include "nvim/mark.h"
 #include "nvim/mbyte.h"
 #include "nvim/memline.h"
@@ -45,7 +47,9 @@ static int diff_busy = FALSE;    // ex_diffgetput() is busy
 #define DIFF_HORIZONTAL 8        // horizontal splits
 #define DIFF_VERTICAL   16       // vertical splits
 #define DIFF_HIDDEN_OFF 32       // diffoff when hidden
+#define DIFF_INTERNAL   64       // use the internal diff
 static int diff_flags = DIFF_FILLER;
+static LineDiffAlgorithm diff_algorithm = kLineDiffMyers;
 
 #define LBUFLEN 50               // length of line in diff file
 
@@ -53,6 +57,38 @@ static int diff_flags = DIFF_FILLER;
 // kNone when not checked yet
 static TriState diff_a_works = kNone;
 
+/// The internal diff drops its line ids and starts over when there are more
+/// distinct lines than this many times the lines in the diffed buffers.
+#define DIFF_IDS_GROWTH 4
+
+/// Number of unchanged lines around an edit the internal diff compares again.
+#define DIFF_RESYNC_LINES 8
+
+typedef kvec_t(int) DiffLineIds;
+
+/// Line ids of a buffer for the internal diff.
+typedef struct {
+  handle_T handle;           ///< buffer the ids belong to, 0 if unused
+  varnumber_T changedtick;   ///< b:changedtick when "ids" was computed
+  bool changed;              ///< "ids" changed in the last update
+  DiffLineIds ids;           ///< id of each line, equal lines have equal ids
+  DiffLineIds old_ids;       ///< "ids" before the last update
+} DiffIds;
+
+/// State the internal diff keeps for a tab page, so that after a change only
+/// the changed part of the buffers is compared again.
+typedef struct diff_cache_S DiffCache;
+struct diff_cache_S {
+  int flags;                          ///< "diff_flags" used for the ids
+  LineDiffAlgorithm algorithm;        ///< "diff_algorithm" used for "hunks"
+  PMap(cstr_t) *lines;                ///< normalized line -> id
+  int next_id;
+  kvec_t(char) norm;                  ///< buffer for a normalized line
+  DiffIds bufs[DB_COUNT];
+  LineDiffHunks hunks[DB_COUNT];      ///< changes from the first buffer
+  handle_T hunks_orig[DB_COUNT];      ///< first buffer for "hunks"
+  handle_T hunks_new[DB_COUNT];       ///< other buffer for "hunks"
+};
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "diff.c.generated.h"
@@ -638,7 +674,8 @@ static int diff_write(buf_T *buf, char_u *fname)
 
 /// Completely update the diffs for the buffers involved.
 ///
-/// This uses the ordinary "diff" command.
+/// This uses the ordinary "diff" command, or the internal diff when 'diffopt'
+/// contains "internal".
 /// The buffers are written to a file, also for unmodified buffers (the file
 /// could have been produced by autocommands, e.g. the netrw plugin).
 ///
@@ -673,6 +710,20 @@ void ex_diffupdate(exarg_T *eap)
     return;
   }
 
+  if (diff_internal()) {
+    // :diffupdate!
+    if ((eap != NULL) && eap->forceit) {
+      diff_check_timestamps(idx_orig);
+      diff_cache_clear(curtab->tp_diff_cache);
+    }
+    diff_internal_update(idx_orig);
+
+    // force updating cursor position on screen
+    curwin->w_valid_cursor.lnum = 0;
+    diff_redraw(true);
+    return;
+  }
+
   // We need three temp file names.
   char *tmp_orig = (char *) vim_tempname();
   char *tmp_new = (char *) vim_tempname();
@@ -762,12 +813,7 @@ void ex_diffupdate(exarg_T *eap)
 
   // :diffupdate!
   if ((eap != NULL) && eap->forceit) {
-    for (idx_new = idx_orig; idx_new < DB_COUNT; ++idx_new) {
-      buf_T *buf = curtab->tp_diffbuf[idx_new];
-      if (buf_valid(buf)) {
-        buf_check_timestamp(buf, FALSE);
-      }
-    }
+    diff_check_timestamps(idx_orig);
   }
 
   // Write the first buffer to a tempfile.
@@ -806,6 +852,373 @@ theend:
   xfree(tmp_diff);
 }
 
+/// Check if the diffed buffers, starting at "idx_orig", were changed outside
+/// of Vim, for ":diffupdate!".
+static void diff_check_timestamps(int idx_orig)
+{
+  for (int idx = idx_orig; idx < DB_COUNT; idx++) {
+    buf_T *buf = curtab->tp_diffbuf[idx];
+    if (buf_valid(buf)) {
+      buf_check_timestamp(buf, false);
+    }
+  }
+}
+
+/// Return true if the internal diff is used instead of the "diff" command.
+bool diff_internal(void)
+  FUNC_ATTR_PURE FUNC_ATTR_WARN_UNUSED_RESULT
+{
+  return (diff_flags & DIFF_INTERNAL) != 0 && *p_dex == NUL;
+}
+
+/// Called when the text of "buf" changed.  With the internal diff the diff is
+/// updated before the next redraw instead of waiting for ":diffupdate".
+///
+/// @param buf
+void diff_internal_changed(buf_T *buf)
+{
+  if (!diff_internal()) {
+    return;
+  }
+  FOR_ALL_TABS(tp) {
+    if (diff_buf_idx_tp(buf, tp) != DB_COUNT) {
+      tp->tp_diff_invalid = true;
+    }
+  }
+}
+
+/// Free the internal diff state of tab page "tp".
+///
+/// @param tp
+void diff_cache_free(tabpage_T *tp)
+{
+  DiffCache *dc = tp->tp_diff_cache;
+  if (dc == NULL) {
+    return;
+  }
+  diff_cache_clear(dc);
+  pmap_free(cstr_t)(dc->lines);
+  kv_destroy(dc->norm);
+  for (int idx = 0; idx < DB_COUNT; idx++) {
+    kv_destroy(dc->bufs[idx].ids);
+    kv_destroy(dc->bufs[idx].old_ids);
+    kv_destroy(dc->hunks[idx]);
+  }
+  xfree(dc);
+  tp->tp_diff_cache = NULL;
+}
+
+/// Forget all line ids and changes of "dc", the next update diffs the
+/// buffers from scratch.
+static void diff_cache_clear(DiffCache *dc)
+{
+  if (dc == NULL) {
+    return;
+  }
+  const char *key;
+  void *id;
+  map_foreach(dc->lines, key, id, {
+    (void)id;
+    xfree((char *)key);
+  });
+  pmap_clear(cstr_t)(dc->lines);
+  dc->next_id = 1;
+  for (int idx = 0; idx < DB_COUNT; idx++) {
+    dc->bufs[idx].handle = 0;
+    dc->hunks_orig[idx] = 0;
+    dc->hunks_new[idx] = 0;
+    kv_size(dc->hunks[idx]) = 0;
+  }
+}
+
+/// Return the id of "line", lines that are equal according to 'diffopt' have
+/// the same id.
+static int diff_line_id(DiffCache *dc, const char_u *line)
+{
+  const char_u *key = line;
+
+  if (diff_flags & (DIFF_ICASE | DIFF_IWHITE)) {
+    // Lines that diff_cmp() considers equal normalize to the same text.
+    kv_size(dc->norm) = 0;
+    const char_u *p = line;
+    while (*p != NUL) {
+      if ((diff_flags & DIFF_IWHITE) && ascii_iswhite(*p)) {
+        p = skipwhite(p);
+        if (*p != NUL) {
+          kv_push(dc->norm, ' ');
+        }
+      } else if (diff_flags & DIFF_ICASE) {
+        char_u buf[MB_MAXBYTES + 1];
+        int l = utf_ptr2len(p);
+        int n = l > 1 ? utf_char2bytes(utf_fold(utf_ptr2char(p)), buf) : 1;
+        if (l == 1) {
+          buf[0] = (char_u)TOLOWER_LOC(*p);
+        }
+        for (int i = 0; i < n; i++) {
+          kv_push(dc->norm, (char)buf[i]);
+        }
+        p += l;
+      } else {
+        kv_push(dc->norm, (char)*p++);
+      }
+    }
+    kv_push(dc->norm, NUL);
+    key = (const char_u *)dc->norm.items;
+  }
+
+  void *id = pmap_get(cstr_t)(dc->lines, (const char *)key);
+  if (id == NULL) {
+    id = (void *)(intptr_t)dc->next_id++;
+    pmap_put(cstr_t)(dc->lines, xstrdup((const char *)key), id);
+  }
+  return (int)(intptr_t)id;
+}
+
+/// Update the line ids of buffer "buf" with index "idx", when it changed
+/// since the last update.
+static void diff_update_ids(DiffCache *dc, int idx, buf_T *buf)
+{
+  DiffIds *di = &dc->bufs[idx];
+  varnumber_T changedtick = buf_get_changedtick(buf);
+
+  if (di->handle == buf->handle && di->changedtick == changedtick) {
+    di->changed = false;
+    return;
+  }
+  if (di->handle != buf->handle) {
+    // Also invalidates the changes involving the previous buffer.
+    di->handle = buf->handle;
+    kv_size(di->ids) = 0;
+  }
+  di->changedtick = changedtick;
+  di->changed = true;
+
+  // Keep the previous ids, to find the lines that changed.
+  DiffLineIds old_ids = di->old_ids;
+  di->old_ids = di->ids;
+  di->ids = old_ids;
+  kv_size(di->ids) = 0;
+  for (linenr_T lnum = 1; lnum <= buf->b_ml.ml_line_count; lnum++) {
+    kv_push(di->ids, diff_line_id(dc, ml_get_buf(buf, lnum, false)));
+  }
+}
+
+/// Make a diff between the first buffer "idx_orig" and every other buffer,
+/// with the internal diff, and add each change to the diff list.
+static void diff_internal_update(int idx_orig)
+{
+  if (curtab->tp_diff_cache == NULL) {
+    DiffCache *dc = xcalloc(1, sizeof(DiffCache));
+    dc->lines = pmap_new(cstr_t)();
+    dc->next_id = 1;
+    curtab->tp_diff_cache = dc;
+  }
+  DiffCache *dc = curtab->tp_diff_cache;
+
+  if (dc->flags != diff_flags || dc->algorithm != diff_algorithm) {
+    diff_cache_clear(dc);
+    dc->flags = diff_flags;
+    dc->algorithm = diff_algorithm;
+  }
+
+  // Ids of lines that were deleted are never freed, start over when there
+  // are too many of them.
+  size_t line_count = 0;
+  for (int idx = idx_orig; idx < DB_COUNT; idx++) {
+    buf_T *buf = curtab->tp_diffbuf[idx];
+    if (buf != NULL && buf->b_ml.ml_mfp != NULL) {
+      line_count += (size_t)buf->b_ml.ml_line_count;
+    }
+  }
+  if (kh_size(dc->lines->table) > DIFF_IDS_GROWTH * line_count + 1024) {
+    diff_cache_clear(dc);
+  }
+
+  buf_T *buf_orig = curtab->tp_diffbuf[idx_orig];
+  if (buf_orig->b_ml.ml_mfp == NULL) {
+    return;  // first buffer isn't loaded
+  }
+  diff_update_ids(dc, idx_orig, buf_orig);
+
+  for (int idx_new = idx_orig + 1; idx_new < DB_COUNT; idx_new++) {
+    buf_T *buf = curtab->tp_diffbuf[idx_new];
+    if (buf == NULL || buf->b_ml.ml_mfp == NULL) {
+      // skip buffer that isn't loaded, its changes are outdated when it is
+      // loaded again
+      dc->hunks_orig[idx_new] = 0;
+      continue;
+    }
+    diff_update_ids(dc, idx_new, buf);
+    diff_internal_pair(dc, idx_orig, idx_new);
+    diff_apply_hunks(idx_orig, idx_new, &dc->hunks[idx_new]);
+  }
+}
+
+/// Update the changes between buffers "idx_orig" and "idx_new" in
+/// "dc->hunks[idx_new]".  When the previous changes are known only the
+/// lines around the edited lines are compared again.
+static void diff_internal_pair(DiffCache *dc, int idx_orig, int idx_new)
+{
+  DiffIds *orig = &dc->bufs[idx_orig];
+  DiffIds *new = &dc->bufs[idx_new];
+  LineDiffHunks *hunks = &dc->hunks[idx_new];
+
+  if (dc->hunks_orig[idx_new] != orig->handle
+      || dc->hunks_new[idx_new] != new->handle
+      || (orig->changed && kv_size(orig->old_ids) == 0)
+      || (new->changed && kv_size(new->old_ids) == 0)) {
+    dc->hunks_orig[idx_new] = orig->handle;
+    dc->hunks_new[idx_new] = new->handle;
+    kv_size(*hunks) = 0;
+    linediff(orig->ids.items, (long)kv_size(orig->ids),
+             new->ids.items, (long)kv_size(new->ids), dc->algorithm, hunks);
+    return;
+  }
+  if (!orig->changed && !new->changed) {
+    return;
+  }
+
+  // Old and new ids of both buffers
+  const int *a0 = orig->changed ? orig->old_ids.items : orig->ids.items;
+  long na0 = (long)(orig->changed ? kv_size(orig->old_ids)
+                                  : kv_size(orig->ids));
+  const int *b0 = new->changed ? new->old_ids.items : new->ids.items;
+  long nb0 = (long)(new->changed ? kv_size(new->old_ids) : kv_size(new->ids));
+  const int *a1 = orig->ids.items;
+  long na1 = (long)kv_size(orig->ids);
+  const int *b1 = new->ids.items;
+  long nb1 = (long)kv_size(new->ids);
+
+  // Lines before "pre" and from "lim" were not edited.
+  long pre_a, lim_a, pre_b, lim_b;
+  bool edited_a = diff_edited_range(a0, na0, a1, na1, &pre_a, &lim_a);
+  bool edited_b = diff_edited_range(b0, nb0, b1, nb1, &pre_b, &lim_b);
+  if (!edited_a && !edited_b) {
+    return;
+  }
+  // Also compare a few unchanged lines around them again, a change may have
+  // a better match nearby.
+  if (edited_a) {
+    pre_a = MAX(pre_a - DIFF_RESYNC_LINES, 0);
+    lim_a = MIN(lim_a + DIFF_RESYNC_LINES, na0);
+  }
+  if (edited_b) {
+    pre_b = MAX(pre_b - DIFF_RESYNC_LINES, 0);
+    lim_b = MIN(lim_b + DIFF_RESYNC_LINES, nb0);
+  }
+
+  // Find the unchanged lines matched by the previous diff just before and
+  // just after the edited lines, the changes outside of them are still
+  // valid.  Run "r" are the equal lines before hunk "r".
+  size_t nhunks = kv_size(*hunks);
+  long lo_a = 0, lo_b = 0, hi_a = na0, hi_b = nb0;
+  size_t lo_idx = 0, hi_idx = nhunks;
+  for (size_t r = 0; r <= nhunks; r++) {
+    long ra = r ? kv_A(*hunks, r - 1).start_a + kv_A(*hunks, r - 1).count_a
+                : 0;
+    long rb = r ? kv_A(*hunks, r - 1).start_b + kv_A(*hunks, r - 1).count_b
+                : 0;
+    if (ra > pre_a || rb > pre_b) {
+      break;
+    }
+    long len = r < nhunks ? kv_A(*hunks, r).start_a - ra : na0 - ra;
+    long j = MIN(len, MIN(pre_a - ra, pre_b - rb));
+    lo_a = ra + j;
+    lo_b = rb + j;
+    lo_idx = r;
+  }
+  for (size_t r = nhunks + 1; r-- > 0;) {
+    long ea = r < nhunks ? kv_A(*hunks, r).start_a : na0;
+    long eb = r < nhunks ? kv_A(*hunks, r).start_b : nb0;
+    if (ea < lim_a || eb < lim_b) {
+      break;
+    }
+    long len = r ? ea - (kv_A(*hunks, r - 1).start_a
+                         + kv_A(*hunks, r - 1).count_a)
+                 : ea;
+    long j = MIN(len, MIN(ea - lim_a, eb - lim_b));
+    hi_a = ea - j;
+    hi_b = eb - j;
+    hi_idx = r;
+  }
+  if (hi_idx < lo_idx || hi_a < lo_a || hi_b < lo_b) {
+    // Only lines were added to an empty side, the other side doesn't limit
+    // the window: insert them after the unchanged lines before them.
+    hi_a = lo_a;
+    hi_b = lo_b;
+    hi_idx = lo_idx;
+  }
+
+  // Keep the changes before the window, compare the window again and keep
+  // the changes after it, moved by the number of added lines.
+  LineDiffHunks result = KV_INITIAL_VALUE;
+  for (size_t i = 0; i < lo_idx; i++) {
+    kv_push(result, kv_A(*hunks, i));
+  }
+  LineDiffHunks window = KV_INITIAL_VALUE;
+  long delta_a = na1 - na0;
+  long delta_b = nb1 - nb0;
+  linediff(a1 + lo_a, hi_a + delta_a - lo_a, b1 + lo_b, hi_b + delta_b - lo_b,
+           dc->algorithm, &window);
+  for (size_t i = 0; i < kv_size(window); i++) {
+    LineDiffHunk h = kv_A(window, i);
+    h.start_a += lo_a;
+    h.start_b += lo_b;
+    diff_push_hunk(&result, h);
+  }
+  kv_destroy(window);
+  for (size_t i = hi_idx; i < nhunks; i++) {
+    LineDiffHunk h = kv_A(*hunks, i);
+    h.start_a += delta_a;
+    h.start_b += delta_b;
+    diff_push_hunk(&result, h);
+  }
+  kv_destroy(*hunks);
+  *hunks = result;
+}
+
+/// Find the lines that were edited between "old" and "new": the lines before
+/// "*pre" and the lines from "*lim" (in "old") are not changed.
+///
+/// @return false when no line was edited, "*pre" is then "nold" and "*lim" is
+///         zero, so that they don't limit the lines to compare again.
+static bool diff_edited_range(const int *old, long nold, const int *new,
+                              long nnew, long *pre, long *lim)
+{
+  long n = MIN(nold, nnew);
+  long p = 0;
+  while (p < n && old[p] == new[p]) {
+    p++;
+  }
+  if (p == nold && nold == nnew) {
+    *pre = nold;
+    *lim = 0;
+    return false;
+  }
+  long s = 0;
+  while (s < n - p && old[nold - 1 - s] == new[nnew - 1 - s]) {
+    s++;
+  }
+  *pre = p;
+  *lim = nold - s;
+  return true;
+}
+
+/// Append "h" to "hunks", joining it with the last hunk when they touch.
+static void diff_push_hunk(LineDiffHunks *hunks, LineDiffHunk h)
+{
+  if (kv_size(*hunks) > 0) {
+    LineDiffHunk *last = &kv_last(*hunks);
+    if (last->start_a + last->count_a == h.start_a
+        && last->start_b + last->count_b == h.start_b) {
+      last->count_a += h.count_a;
+      last->count_b += h.count_b;
+      return;
+    }
+  }
+  kv_push(*hunks, h);
+}
+
 /// Make a diff between files "tmp_orig" and "tmp_new", results in "tmp_diff".
 ///
 /// @param tmp_orig
@@ -1215,18 +1628,11 @@ void ex_diffoff(exarg_T *eap)
 static void diff_read(int idx_orig, int idx_new, char_u *fname)
 {
   FILE *fd;
-  diff_T *dprev = NULL;
-  diff_T *dp = curtab->tp_first_diff;
-  diff_T *dn, *dpl;
   long f1, l1, f2, l2;
   char_u linebuf[LBUFLEN]; // only need to hold the diff line
   int difftype;
   char_u *p;
-  long off;
-  int i;
-  linenr_T lnum_orig, lnum_new;
-  long count_orig, count_new;
-  int notset = TRUE; // block "*dp" not set yet
+  LineDiffHunks hunks = KV_INITIAL_VALUE;
 
   fd = mch_fopen((char *)fname, "r");
 
@@ -1279,21 +1685,51 @@ static void diff_read(int idx_orig, int idx_new, char_u *fname)
       continue;
     }
 
+    // Line numbers in the diff output are 1-based, hunks are 0-based.
+    LineDiffHunk hunk;
     if (difftype == 'a') {
-      lnum_orig = f1 + 1;
-      count_orig = 0;
+      hunk.start_a = f1;
+      hunk.count_a = 0;
     } else {
-      lnum_orig = f1;
-      count_orig = l1 - f1 + 1;
+      hunk.start_a = f1 - 1;
+      hunk.count_a = l1 - f1 + 1;
     }
 
     if (difftype == 'd') {
-      lnum_new = f2 + 1;
-      count_new = 0;
+      hunk.start_b = f2;
+      hunk.count_b = 0;
     } else {
-      lnum_new = f2;
-      count_new = l2 - f2 + 1;
+      hunk.start_b = f2 - 1;
+      hunk.count_b = l2 - f2 + 1;
     }
+    kv_push(hunks, hunk);
+  }
+  fclose(fd);
+
+  diff_apply_hunks(idx_orig, idx_new, &hunks);
+  kv_destroy(hunks);
+}
+
+/// Add the changes between buffers "idx_orig" and "idx_new" to the diff list.
+///
+/// @param idx_orig idx of original file
+/// @param idx_new idx of new file
+/// @param hunks changes from "idx_orig" to "idx_new", in order
+static void diff_apply_hunks(int idx_orig, int idx_new,
+                             const LineDiffHunks *hunks)
+{
+  diff_T *dprev = NULL;
+  diff_T *dp = curtab->tp_first_diff;
+  diff_T *dn, *dpl;
+  long off;
+  int i;
+  int notset = TRUE; // block "*dp" not set yet
+
+  for (size_t h = 0; h < kv_size(*hunks); h++) {
+    linenr_T lnum_orig = (linenr_T)kv_A(*hunks, h).start_a + 1;
+    long count_orig = kv_A(*hunks, h).count_a;
+    linenr_T lnum_new = (linenr_T)kv_A(*hunks, h).start_b + 1;
+    long count_new = kv_A(*hunks, h).count_b;
 
     // Go over blocks before the change, for which orig and new are equal.
     // Copy blocks from orig to new.
@@ -1403,8 +1839,6 @@ static void diff_read(int idx_orig, int idx_new, char_u *fname)
     dp = dp->df_next;
     notset = TRUE;
   }
-
-  fclose(fd);
 }
 
 /// Copy an entry at "dp" from "idx_orig" to "idx_new".
@@ -1815,6 +2249,7 @@ int diffopt_changed(void)
   int diff_context_new = 6;
   int diff_flags_new = 0;
   int diff_foldcolumn_new = 2;
+  LineDiffAlgorithm diff_algorithm_new = kLineDiffMyers;
 
   char_u *p = p_dip;
   while (*p != NUL) {
@@ -1842,6 +2277,26 @@ int diffopt_changed(void)
     } else if (STRNCMP(p, "hiddenoff", 9) == 0) {
       p += 9;
       diff_flags_new |= DIFF_HIDDEN_OFF;
+    } else if (STRNCMP(p, "internal", 8) == 0) {
+      p += 8;
+      diff_flags_new |= DIFF_INTERNAL;
+    } else if (STRNCMP(p, "algorithm:", 10) == 0) {
+      p += 10;
+      if (STRNCMP(p, "myers", 5) == 0) {
+        p += 5;
+        diff_algorithm_new = kLineDiffMyers;
+      } else if (STRNCMP(p, "minimal", 7) == 0) {
+        p += 7;
+        diff_algorithm_new = kLineDiffMinimal;
+      } else if (STRNCMP(p, "patience", 8) == 0) {
+        p += 8;
+        diff_algorithm_new = kLineDiffPatience;
+      } else if (STRNCMP(p, "histogram", 9) == 0) {
+        p += 9;
+        diff_algorithm_new = kLineDiffHistogram;
+      } else {
+        return FAIL;
+      }
     }
 
     if ((*p != ',') && (*p != NUL)) {
@@ -1859,13 +2314,14 @@ int diffopt_changed(void)
   }
 
   // If "icase" or "iwhite" was added or removed, need to update the diff.
-  if (diff_flags != diff_flags_new) {
+  if (diff_flags != diff_flags_new || diff_algorithm != diff_algorithm_new) {
     FOR_ALL_TABS(tp) {
       tp->tp_diff_invalid = TRUE;
     }
   }
 
   diff_flags = diff_flags_new;
+  diff_algorithm = diff_algorithm_new;
   diff_context = diff_context_new;
   diff_foldcolumn = diff_foldcolumn_new;
 
@@ -6503,7 +6503,7 @@ static void api_wrapper(typval_T *argvars, typval_T *rettv, FunPtr fptr)
   }
 
   Error err = ERROR_INIT;
-  Object result = fn(VIML_INTERNAL_CALL, args, &err);
+  Object result = fn(VIML_INTERNAL_CALL, args, NULL, &err);
 
   if (ERROR_SET(&err)) {
     nvim_err_writeln(cstr_as_string(err.msg));
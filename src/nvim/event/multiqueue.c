@@ -57,17 +57,29 @@
 #include "nvim/memory.h"
 #include "nvim/os/time.h"
 
+// Items are intrusive: an item pushed to a child queue is also the link node
+// in the parent queue, so each event costs a single allocation. This works
+// because links keep the order of their child queue, removing a link always
+// removes the head of the child queue, which is the item the link belongs to.
+//
+// Freed items are kept in a freelist in the root queue (i.e. per loop) and
+// reused by the next push, up to MULTIQUEUE_POOL_MAX items.
+#define MULTIQUEUE_POOL_MAX 1024
+
+typedef struct {
+  QUEUE q;
+  bool link;  // true: node is the link in the parent queue
+} MultiQueueNode;
+
 typedef struct multiqueue_item MultiQueueItem;
 struct multiqueue_item {
+  Event event;
   union {
-    MultiQueue *queue;
-    struct {
-      Event event;
-      MultiQueueItem *parent_item;
-    } item;
+    MultiQueue *queue;  // child queue holding `node`, for linked items
+    MultiQueueItem *next_free;  // next item in the freelist
   } data;
-  bool link;  // true: current item is just a link to a node in a child queue
-  QUEUE node;
+  MultiQueueNode node;  // node in the queue the item was pushed to
+  MultiQueueNode link;  // node in the parent queue, self-linked if none
 };
 
 struct multiqueue {
@@ -76,6 +88,8 @@ struct multiqueue {
   put_callback put_cb;
   void *data;
   size_t size;
+  MultiQueueItem *free_items;  // freelist, only used by root queues
+  size_t free_count;
 };
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
@@ -106,20 +120,35 @@ static MultiQueue *multiqueue_new(MultiQueue *parent, put_callback put_cb,
   rv->parent = parent;
   rv->put_cb = put_cb;
   rv->data = data;
+  rv->free_items = NULL;
+  rv->free_count = 0;
   return rv;
 }
 
+/// Frees the queue and its pending events.
+///
+/// Child queues must be freed (or moved to another parent) before their
+/// parent, they share the item freelist of the parent.
 void multiqueue_free(MultiQueue *this)
 {
   assert(this);
   while (!QUEUE_EMPTY(&this->headtail)) {
-    QUEUE *q = QUEUE_HEAD(&this->headtail);
-    MultiQueueItem *item = multiqueue_node_data(q);
-    if (this->parent) {
-      QUEUE_REMOVE(&item->data.item.parent_item->node);
-      xfree(item->data.item.parent_item);
+    MultiQueueNode *n = multiqueue_node_data(QUEUE_HEAD(&this->headtail));
+    if (n->link) {
+      // The item belongs to a child queue, only drop the link
+      QUEUE_REMOVE(&n->q);
+      QUEUE_INIT(&n->q);
+      continue;
     }
-    QUEUE_REMOVE(q);
+    MultiQueueItem *item = QUEUE_DATA(n, MultiQueueItem, node);
+    QUEUE_REMOVE(&item->node.q);
+    QUEUE_REMOVE(&item->link.q);
+    xfree(item);
+  }
+
+  while (this->free_items) {
+    MultiQueueItem *item = this->free_items;
+    this->free_items = item->data.next_free;
     xfree(item);
   }
 
@@ -173,75 +202,113 @@ void multiqueue_replace_parent(MultiQueue *this, MultiQueue *new_parent)
   this->parent = new_parent;
 }
 
+/// Moves all events from `src` to the end of `dest`, in order.
+///
+/// Unlike getting and putting each event this reuses the queue items and
+/// calls the put callback of `dest` once.
+void multiqueue_move_events(MultiQueue *dest, MultiQueue *src)
+  FUNC_ATTR_NONNULL_ALL
+{
+  if (multiqueue_empty(src)) {
+    return;
+  }
+  while (!multiqueue_empty(src)) {
+    multiqueue_link(dest, multiqueue_take(src));
+  }
+  if (dest->parent && dest->parent->put_cb) {
+    dest->parent->put_cb(dest->parent, dest->parent->data);
+  }
+}
+
 /// Gets the count of all events currently in the queue.
 size_t multiqueue_size(MultiQueue *this)
 {
   return this->size;
 }
 
-/// Gets an Event from an item.
-///
-/// @param remove   Remove the node from its queue, and free it.
-static Event multiqueueitem_get_event(MultiQueueItem *item, bool remove)
-{
-  assert(item != NULL);
-  Event ev;
-  if (item->link) {
-    // get the next node in the linked queue
-    MultiQueue *linked = item->data.queue;
-    assert(!multiqueue_empty(linked));
-    MultiQueueItem *child =
-      multiqueue_node_data(QUEUE_HEAD(&linked->headtail));
-    ev = child->data.item.event;
-    // remove the child node
-    if (remove) {
-      QUEUE_REMOVE(&child->node);
-      xfree(child);
-    }
+/// Gets the queue that owns the freelist for `this`.
+static MultiQueue *multiqueue_root(MultiQueue *this)
+{
+  return this->parent ? this->parent : this;
+}
+
+static MultiQueueItem *multiqueue_item_alloc(MultiQueue *this)
+{
+  MultiQueue *root = multiqueue_root(this);
+  MultiQueueItem *item = root->free_items;
+  if (item) {
+    root->free_items = item->data.next_free;
+    root->free_count--;
   } else {
-    // remove the corresponding link node in the parent queue
-    if (remove && item->data.item.parent_item) {
-      QUEUE_REMOVE(&item->data.item.parent_item->node);
-      xfree(item->data.item.parent_item);
-      item->data.item.parent_item = NULL;
-    }
-    ev = item->data.item.event;
+    item = xmalloc(sizeof(MultiQueueItem));
+    item->node.link = false;
+    item->link.link = true;
   }
-  return ev;
+  return item;
 }
 
-static Event multiqueue_remove(MultiQueue *this)
+static void multiqueue_item_free(MultiQueue *this, MultiQueueItem *item)
+{
+  MultiQueue *root = multiqueue_root(this);
+  if (root->free_count >= MULTIQUEUE_POOL_MAX) {
+    xfree(item);
+    return;
+  }
+  item->data.next_free = root->free_items;
+  root->free_items = item;
+  root->free_count++;
+}
+
+/// Unlinks the next item from `this` and from the parent or child queue it
+/// is also linked to. The item is not freed.
+static MultiQueueItem *multiqueue_take(MultiQueue *this)
 {
   assert(!multiqueue_empty(this));
-  QUEUE *h = QUEUE_HEAD(&this->headtail);
-  QUEUE_REMOVE(h);
-  MultiQueueItem *item = multiqueue_node_data(h);
-  assert(!item->link || !this->parent);  // Only a parent queue has link-nodes
-  Event ev = multiqueueitem_get_event(item, true);
+  MultiQueueNode *n = multiqueue_node_data(QUEUE_HEAD(&this->headtail));
+  MultiQueueItem *item;
+  if (n->link) {
+    assert(!this->parent);  // Only a parent queue has link-nodes
+    item = QUEUE_DATA(n, MultiQueueItem, link);
+    // the link always belongs to the next node in the linked queue
+    assert(QUEUE_HEAD(&item->data.queue->headtail) == &item->node.q);
+  } else {
+    item = QUEUE_DATA(n, MultiQueueItem, node);
+  }
+  QUEUE_REMOVE(&item->node.q);
+  QUEUE_REMOVE(&item->link.q);
   this->size--;
-  xfree(item);
-  return ev;
+  return item;
 }
 
-static void multiqueue_push(MultiQueue *this, Event event)
+/// Appends `item` to `this`, and a link to it to the parent queue.
+static void multiqueue_link(MultiQueue *this, MultiQueueItem *item)
 {
-  MultiQueueItem *item = xmalloc(sizeof(MultiQueueItem));
-  item->link = false;
-  item->data.item.event = event;
-  item->data.item.parent_item = NULL;
-  QUEUE_INSERT_TAIL(&this->headtail, &item->node);
+  QUEUE_INSERT_TAIL(&this->headtail, &item->node.q);
   if (this->parent) {
-    // push link node to the parent queue
-    item->data.item.parent_item = xmalloc(sizeof(MultiQueueItem));
-    item->data.item.parent_item->link = true;
-    item->data.item.parent_item->data.queue = this;
-    QUEUE_INSERT_TAIL(&this->parent->headtail,
-                      &item->data.item.parent_item->node);
+    item->data.queue = this;
+    QUEUE_INSERT_TAIL(&this->parent->headtail, &item->link.q);
+  } else {
+    QUEUE_INIT(&item->link.q);
   }
   this->size++;
 }
 
-static MultiQueueItem *multiqueue_node_data(QUEUE *q)
+static Event multiqueue_remove(MultiQueue *this)
+{
+  MultiQueueItem *item = multiqueue_take(this);
+  Event ev = item->event;
+  multiqueue_item_free(this, item);
+  return ev;
+}
+
+static void multiqueue_push(MultiQueue *this, Event event)
+{
+  MultiQueueItem *item = multiqueue_item_alloc(this);
+  item->event = event;
+  multiqueue_link(this, item);
+}
+
+static MultiQueueNode *multiqueue_node_data(QUEUE *q)
 {
-  return QUEUE_DATA(q, MultiQueueItem, node);
+  return QUEUE_DATA(q, MultiQueueNode, q);
 }
@@ -25,6 +25,9 @@
 // Time for a process to exit cleanly before we send KILL.
 // For PTY processes SIGTERM is sent first (in case SIGHUP was not enough).
 #define KILL_TIMEOUT_MS 2000
+// Bytes read from a stream of a terminated process when the system buffer
+// size is unknown and the stream has no RBuffer to take the size from
+#define FLUSH_DEFAULT_SIZE 0x10000
 
 static bool process_is_tearing_down = false;
 
@@ -339,7 +342,10 @@ static void flush_stream(Process *proc, Stream *stream)
   int err = uv_recv_buffer_size((uv_handle_t *)&stream->uv.pipe,
                                 &system_buffer_size);
   if (err) {
-    system_buffer_size = (int)rbuffer_capacity(stream->buffer);
+    // RPC streams read into the unpacker and have no RBuffer
+    system_buffer_size = stream->buffer
+                         ? (int)rbuffer_capacity(stream->buffer)
+                         : FLUSH_DEFAULT_SIZE;
   }
 
   size_t max_bytes = stream->num_bytes + (size_t)system_buffer_size;
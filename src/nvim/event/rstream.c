@@ -45,6 +45,22 @@ void rstream_init(Stream *stream, size_t bufsize)
   stream->buffer->nonfull_cb = on_rbuffer_nonfull;
 }
 
+/// Makes the stream read into memory provided by the reader instead of its
+/// RBuffer, e.g. the msgpack unpacker buffer of a RPC channel, saving a copy
+/// of every byte read. The read callback then receives a NULL RBuffer.
+///
+/// Must be called before rstream_start().
+void rstream_set_reserve(Stream *stream, stream_reserve_cb reserve_cb,
+                         stream_commit_cb commit_cb)
+  FUNC_ATTR_NONNULL_ALL
+{
+  if (stream->buffer) {
+    rbuffer_free(stream->buffer);
+    stream->buffer = NULL;
+  }
+  stream->reserve_cb = reserve_cb;
+  stream->commit_cb = commit_cb;
+}
 
 /// Starts watching for events from a `Stream` instance.
 ///
@@ -86,6 +102,23 @@ static void on_rbuffer_nonfull(RBuffer *buf, void *data)
   rstream_start(stream, stream->read_cb, stream->cb_data);
 }
 
+static char *rstream_write_ptr(Stream *stream, size_t *write_count)
+{
+  if (stream->reserve_cb) {
+    return stream->reserve_cb(stream, write_count, stream->cb_data);
+  }
+  return rbuffer_write_ptr(stream->buffer, write_count);
+}
+
+static void rstream_produced(Stream *stream, size_t count)
+{
+  if (stream->commit_cb) {
+    stream->commit_cb(stream, count, stream->cb_data);
+  } else {
+    rbuffer_produced(stream->buffer, count);
+  }
+}
+
 // Callbacks used by libuv
 
 // Called by libuv to allocate memory for reading.
@@ -94,7 +127,7 @@ static void alloc_cb(uv_handle_t *handle, size_t suggested, uv_buf_t *buf)
   Stream *stream = handle->data;
   // `uv_buf_t.len` happens to have different size on Windows.
   size_t write_count;
-  buf->base = rbuffer_write_ptr(stream->buffer, &write_count);
+  buf->base = rstream_write_ptr(stream, &write_count);
   buf->len = UV_BUF_LEN(write_count);
 }
 
@@ -133,7 +166,7 @@ static void read_cb(uv_stream_t *uvstream, ssize_t cnt, const uv_buf_t *buf)
   stream->num_bytes += nread;
   // Data was already written, so all we need is to update 'wpos' to reflect
   // the space actually used in the buffer.
-  rbuffer_produced(stream->buffer, nread);
+  rstream_produced(stream, nread);
   invoke_read_cb(stream, nread, false);
 }
 
@@ -145,7 +178,7 @@ static void fread_idle_cb(uv_idle_t *handle)
 
   // `uv_buf_t.len` happens to have different size on Windows.
   size_t write_count;
-  stream->uvbuf.base = rbuffer_write_ptr(stream->buffer, &write_count);
+  stream->uvbuf.base = rstream_write_ptr(stream, &write_count);
   stream->uvbuf.len = UV_BUF_LEN(write_count);
 
   // the offset argument to uv_fs_read is int64_t, could someone really try
@@ -177,7 +210,7 @@ static void fread_idle_cb(uv_idle_t *handle)
 
   // no errors (req.result (ssize_t) is positive), it's safe to cast.
   size_t nread = (size_t) req.result;
-  rbuffer_produced(stream->buffer, nread);
+  rstream_produced(stream, nread);
   stream->fpos += nread;
   invoke_read_cb(stream, nread, false);
 }
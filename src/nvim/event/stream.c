@@ -69,6 +69,8 @@ void stream_init(Loop *loop, Stream *stream, int fd, uv_stream_t *uvstream)
   stream->maxmem = 0;
   stream->pending_reqs = 0;
   stream->read_cb = NULL;
+  stream->reserve_cb = NULL;
+  stream->commit_cb = NULL;
   stream->write_cb = NULL;
   stream->close_cb = NULL;
   stream->internal_close_cb = NULL;
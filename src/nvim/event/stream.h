@@ -20,6 +20,19 @@ typedef struct stream Stream;
 typedef void (*stream_read_cb)(Stream *stream, RBuffer *buf, size_t count,
     void *data, bool eof);
 
+/// Type of function called to get the memory a Stream reads into, when the
+/// reader owns its buffer (see rstream_set_reserve())
+///
+/// @param stream The Stream instance
+/// @param[out] len Size of the returned memory
+/// @param data User-defined data
+/// @return Memory for the next read
+typedef char *(*stream_reserve_cb)(Stream *stream, size_t *len, void *data);
+
+/// Type of function called after `count` bytes were read into the memory
+/// returned by the stream_reserve_cb, before the stream_read_cb is queued
+typedef void (*stream_commit_cb)(Stream *stream, size_t count, void *data);
+
 /// Type of function called when the Stream has information about a write
 /// request.
 ///
@@ -42,6 +55,8 @@ struct stream {
   RBuffer *buffer;
   uv_file fd;
   stream_read_cb read_cb;
+  stream_reserve_cb reserve_cb;  ///< If set, reads bypass `buffer`
+  stream_commit_cb commit_cb;
   stream_write_cb write_cb;
   void *cb_data;
   stream_close_cb close_cb, internal_close_cb;
@@ -25,6 +25,7 @@ local c_id = (
 local c_void = P('void')
 local c_param_type = (
   ((P('Error') * fill * P('*') * fill) * Cc('error')) +
+  ((P('Arena') * fill * P('*') * fill) * Cc('arena')) +
   (C(c_id) * (ws ^ 1))
   )
 local c_type = (C(c_void) * (ws ^ 1)) + c_param_type
@@ -63,6 +63,12 @@ for i = 6, #arg do
         -- for specifying errors
         fn.parameters[#fn.parameters] = nil
       end
+      if #fn.parameters ~= 0 and fn.parameters[#fn.parameters][1] == 'arena' then
+        -- the return value can be allocated in the arena of the request, it
+        -- is released after the response was serialized
+        fn.receives_arena = true
+        fn.parameters[#fn.parameters] = nil
+      end
     end
   end
   input:close()
@@ -188,7 +194,7 @@ for i = 1, #functions do
   if fn.impl_name == nil then
     local args = {}
 
-    output:write('Object handle_'..fn.name..'(uint64_t channel_id, Array args, Error *error)')
+    output:write('Object handle_'..fn.name..'(uint64_t channel_id, Array args, Arena *arena, Error *error)')
     output:write('\n{')
     output:write('\n#if MIN_LOG_LEVEL <= DEBUG_LOG_LEVEL')
     output:write('\n  logmsg(DEBUG_LOG_LEVEL, "RPC: ", NULL, -1, true, "invoke '..fn.name..'");')
@@ -243,40 +249,30 @@ for i = 1, #functions do
     end
 
     -- function call
-    local call_args = table.concat(args, ', ')
+    if fn.receives_channel_id then
+      -- if the function receives the channel id, pass it as first argument
+      table.insert(args, 1, 'channel_id')
+    end
+    if fn.receives_arena then
+      -- if the function allocates its result in an arena, pass the arena
+      args[#args + 1] = 'arena'
+    end
+    if fn.can_fail then
+      -- if the function can fail, also pass a pointer to the local error object
+      args[#args + 1] = 'error'
+    end
     output:write('\n  ')
     if fn.return_type ~= 'void' then
       -- has a return value, prefix the call with a declaration
       output:write(fn.return_type..' rv = ')
     end
-
-    -- write the function name and the opening parenthesis
-    output:write(fn.name..'(')
-
-    if fn.receives_channel_id then
-      -- if the function receives the channel id, pass it as first argument
-      if #args > 0 or fn.can_fail then
-        output:write('channel_id, '..call_args)
-      else
-        output:write('channel_id')
-      end
-    else
-      output:write(call_args)
-    end
+    output:write(fn.name..'('..table.concat(args, ', ')..');\n')
 
     if fn.can_fail then
-      -- if the function can fail, also pass a pointer to the local error object
-      if #args > 0 then
-        output:write(', error);\n')
-      else
-        output:write('error);\n')
-      end
       -- and check for the error
       output:write('\n  if (ERROR_SET(error)) {')
       output:write('\n    goto cleanup;')
       output:write('\n  }\n')
-    else
-      output:write(');\n')
     end
 
     if fn.return_type ~= 'void' then
@@ -302,7 +298,8 @@ for i = 1, #functions do
                '(String) {.data = "'..fn.name..'", '..
                '.size = sizeof("'..fn.name..'") - 1}, '..
                '(MsgpackRpcRequestHandler) {.fn = handle_'..  (fn.impl_name or fn.name)..
-               ', .async = '..tostring(fn.async)..'});\n')
+               ', .async = '..tostring(fn.async)..
+               ', .arena_return = '..tostring(fn.receives_arena == true)..'});\n')
 
 end
 
@@ -386,6 +383,10 @@ local function process_function(fn)
   if fn.receives_channel_id then
     cparams = 'LUA_INTERNAL_CALL, ' .. cparams
   end
+  if fn.receives_arena then
+    -- results are freed by the lua bindings, allocate them on the heap
+    cparams = cparams .. 'NULL, '
+  end
   if fn.can_fail then
     cparams = cparams .. '&err'
   else
@@ -0,0 +1,441 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check
+// it. PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+// linediff.c: line diff algorithms for the internal diff (see 'diffopt').
+//
+// Lines are compared by integer ids, lines that compare equal (according to
+// "icase" and "iwhite") must have the same id. The algorithms mark changed
+// lines in both sequences, the hunks are then read from the marks.
+//
+// The Myers implementation follows "An O(ND) Difference Algorithm and Its
+// Variations" (Eugene W. Myers), in its linear space variant: the middle of
+// the shortest edit script is found by searching from both ends at once and
+// the two halves are compared recursively. Like GNU diff and xdiff, the
+// search gives up after a number of edits that depends on the input size and
+// splits at the furthest reaching point, so that large and very different
+// inputs do not take quadratic time.
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "nvim/linediff.h"
+#include "nvim/macros.h"
+#include "nvim/memory.h"
+
+/// The Myers search stops looking for a minimal diff after at least this
+/// many edits
+#define MYERS_MIN_COST 256
+
+/// The histogram algorithm does not anchor on lines that occur more often
+#define HISTOGRAM_MAX_CHAIN 64
+
+typedef struct {
+  const int *a, *b;
+  char *chg_a, *chg_b;  ///< Changed lines, indexed like "a" and "b"
+  long *kvdf, *kvdb;    ///< Furthest points of the Myers search, by diagonal
+  long max_cost;        ///< Give up a minimal Myers search after this
+  // Only used by the patience and histogram algorithms, indexed by line id
+  int *cnt_a, *cnt_b;
+  long *pos_a, *pos_b;
+} LineDiffCtx;
+
+/// A line present in both sides of a patience region
+typedef struct {
+  long i1, i2;
+  long prev;  ///< Index of the previous pair in the longest sequence, or -1
+} PatiencePair;
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "linediff.c.generated.h"
+#endif
+
+/// Compares the lines ids "a[0..na)" and "b[0..nb)" and appends the changes
+/// to "hunks", in order.
+void linediff(const int *a, long na, const int *b, long nb,
+              LineDiffAlgorithm algorithm, LineDiffHunks *hunks)
+  FUNC_ATTR_NONNULL_ALL
+{
+  LineDiffCtx ctx = {
+    .a = a,
+    .b = b,
+    .chg_a = xcalloc((size_t)na + 1, 1),
+    .chg_b = xcalloc((size_t)nb + 1, 1),
+  };
+
+  // Diagonals go from -nb to na, the search also reads one past both ends
+  long ndiags = na + nb + 3;
+  long *kv = xmalloc(2 * (size_t)ndiags * sizeof(long));
+  ctx.kvdf = kv + nb + 1;
+  ctx.kvdb = kv + ndiags + nb + 1;
+  ctx.max_cost = MYERS_MIN_COST;
+  while (ctx.max_cost * ctx.max_cost < ndiags) {
+    ctx.max_cost *= 2;
+  }
+
+  if (algorithm == kLineDiffPatience || algorithm == kLineDiffHistogram) {
+    int nids = 0;
+    for (long i = 0; i < na; i++) {
+      nids = MAX(nids, a[i] + 1);
+    }
+    for (long i = 0; i < nb; i++) {
+      nids = MAX(nids, b[i] + 1);
+    }
+    ctx.cnt_a = xcalloc((size_t)nids + 1, sizeof(int));
+    ctx.cnt_b = xcalloc((size_t)nids + 1, sizeof(int));
+    ctx.pos_a = xmalloc(((size_t)nids + 1) * sizeof(long));
+    ctx.pos_b = xmalloc(((size_t)nids + 1) * sizeof(long));
+    anchor_compare(&ctx, 0, na, 0, nb, algorithm == kLineDiffHistogram);
+  } else {
+    myers_compare(&ctx, 0, na, 0, nb, algorithm == kLineDiffMinimal);
+  }
+
+  // Unchanged lines pair up in order, everything between them is a hunk
+  long i = 0;
+  long j = 0;
+  while (i < na || j < nb) {
+    if (i < na && j < nb && !ctx.chg_a[i] && !ctx.chg_b[j]) {
+      i++;
+      j++;
+      continue;
+    }
+    long si = i;
+    long sj = j;
+    while (i < na && (ctx.chg_a[i] || j >= nb)) {
+      i++;
+    }
+    while (j < nb && (ctx.chg_b[j] || i >= na)) {
+      j++;
+    }
+    kv_push(*hunks, ((LineDiffHunk) {
+      .start_a = si, .count_a = i - si,
+      .start_b = sj, .count_b = j - sj,
+    }));
+  }
+
+  xfree(ctx.chg_a);
+  xfree(ctx.chg_b);
+  xfree(kv);
+  xfree(ctx.cnt_a);
+  xfree(ctx.cnt_b);
+  xfree(ctx.pos_a);
+  xfree(ctx.pos_b);
+}
+
+/// Skips the lines at the start and end of a region that are equal.
+///
+/// @return false if one of the sides is empty after trimming, its lines (if
+///         any) are then marked changed.
+static bool trim_region(LineDiffCtx *ctx, long *off1, long *lim1,
+                        long *off2, long *lim2)
+{
+  const int *a = ctx->a;
+  const int *b = ctx->b;
+  while (*off1 < *lim1 && *off2 < *lim2 && a[*off1] == b[*off2]) {
+    (*off1)++;
+    (*off2)++;
+  }
+  while (*off1 < *lim1 && *off2 < *lim2 && a[*lim1 - 1] == b[*lim2 - 1]) {
+    (*lim1)--;
+    (*lim2)--;
+  }
+  if (*off1 == *lim1 || *off2 == *lim2) {
+    memset(ctx->chg_a + *off1, 1, (size_t)(*lim1 - *off1));
+    memset(ctx->chg_b + *off2, 1, (size_t)(*lim2 - *off2));
+    return false;
+  }
+  return true;
+}
+
+/// Marks the changes between "a[off1..lim1)" and "b[off2..lim2)".
+///
+/// @param need_min  Do not stop searching for a minimal diff after
+///                  "max_cost" edits.
+static void myers_compare(LineDiffCtx *ctx, long off1, long lim1,
+                          long off2, long lim2, bool need_min)
+{
+  if (!trim_region(ctx, &off1, &lim1, &off2, &lim2)) {
+    return;
+  }
+  long spl1, spl2;
+  bool min_lo, min_hi;
+  myers_split(ctx, off1, lim1, off2, lim2, need_min,
+              &spl1, &spl2, &min_lo, &min_hi);
+  myers_compare(ctx, off1, spl1, off2, spl2, min_lo);
+  myers_compare(ctx, spl1, lim1, spl2, lim2, min_hi);
+}
+
+/// Finds a point on (or, after "max_cost" edits, near) a shortest edit path
+/// between "a[off1..lim1)" and "b[off2..lim2)".
+///
+/// The first lines and the last lines of the regions must differ.
+///
+/// @param[out] spl1,spl2  The split point
+/// @param[out] min_lo,min_hi  True if the part before (after) the split point
+///                            is known to be within "max_cost" edits
+static void myers_split(LineDiffCtx *ctx, long off1, long lim1, long off2,
+                        long lim2, bool need_min, long *spl1, long *spl2,
+                        bool *min_lo, bool *min_hi)
+{
+  const int *a = ctx->a;
+  const int *b = ctx->b;
+  long *kvdf = ctx->kvdf;
+  long *kvdb = ctx->kvdb;
+  // Diagonal "d" holds the points where i1 - i2 == d
+  long dmin = off1 - lim2;
+  long dmax = lim1 - off2;
+  long fmid = off1 - off2;
+  long bmid = lim1 - lim2;
+  bool odd = (fmid - bmid) & 1;
+  long fmin = fmid;
+  long fmax = fmid;
+  long bmin = bmid;
+  long bmax = bmid;
+
+  kvdf[fmid] = off1;
+  kvdb[bmid] = lim1;
+
+  for (long ec = 1;; ec++) {
+    // Extend the forward paths by one edit.
+    if (fmin > dmin) {
+      kvdf[--fmin - 1] = -1;
+    } else {
+      fmin++;
+    }
+    if (fmax < dmax) {
+      kvdf[++fmax + 1] = -1;
+    } else {
+      fmax--;
+    }
+    for (long d = fmax; d >= fmin; d -= 2) {
+      long i1 = kvdf[d - 1] >= kvdf[d + 1] ? kvdf[d - 1] + 1 : kvdf[d + 1];
+      long i2 = i1 - d;
+      while (i1 < lim1 && i2 < lim2 && a[i1] == b[i2]) {
+        i1++;
+        i2++;
+      }
+      kvdf[d] = i1;
+      if (odd && bmin <= d && d <= bmax && kvdb[d] <= i1) {
+        *spl1 = i1;
+        *spl2 = i2;
+        *min_lo = *min_hi = true;
+        return;
+      }
+    }
+
+    // Extend the backward paths by one edit.
+    if (bmin > dmin) {
+      kvdb[--bmin - 1] = LONG_MAX;
+    } else {
+      bmin++;
+    }
+    if (bmax < dmax) {
+      kvdb[++bmax + 1] = LONG_MAX;
+    } else {
+      bmax--;
+    }
+    for (long d = bmax; d >= bmin; d -= 2) {
+      long i1 = kvdb[d - 1] < kvdb[d + 1] ? kvdb[d - 1] : kvdb[d + 1] - 1;
+      long i2 = i1 - d;
+      while (i1 > off1 && i2 > off2 && a[i1 - 1] == b[i2 - 1]) {
+        i1--;
+        i2--;
+      }
+      kvdb[d] = i1;
+      if (!odd && fmin <= d && d <= fmax && i1 <= kvdf[d]) {
+        *spl1 = i1;
+        *spl2 = i2;
+        *min_lo = *min_hi = true;
+        return;
+      }
+    }
+
+    if (need_min || ec < ctx->max_cost) {
+      continue;
+    }
+
+    // Too expensive: split at the point that got furthest, from either end.
+    long fbest = -1;
+    long fbest1 = -1;
+    for (long d = fmax; d >= fmin; d -= 2) {
+      long i1 = MIN(kvdf[d], lim1);
+      long i2 = i1 - d;
+      if (lim2 < i2) {
+        i1 = lim2 + d;
+        i2 = lim2;
+      }
+      if (fbest < i1 + i2) {
+        fbest = i1 + i2;
+        fbest1 = i1;
+      }
+    }
+    long bbest = LONG_MAX;
+    long bbest1 = LONG_MAX;
+    for (long d = bmax; d >= bmin; d -= 2) {
+      long i1 = MAX(off1, kvdb[d]);
+      long i2 = i1 - d;
+      if (i2 < off2) {
+        i1 = off2 + d;
+        i2 = off2;
+      }
+      if (i1 + i2 < bbest) {
+        bbest = i1 + i2;
+        bbest1 = i1;
+      }
+    }
+    if ((lim1 + lim2) - bbest < fbest - (off1 + off2)) {
+      *spl1 = fbest1;
+      *spl2 = fbest - fbest1;
+      *min_lo = true;
+      *min_hi = false;
+    } else {
+      *spl1 = bbest1;
+      *spl2 = bbest - bbest1;
+      *min_lo = false;
+      *min_hi = true;
+    }
+    return;
+  }
+}
+
+/// Marks the changes between "a[off1..lim1)" and "b[off2..lim2)" with the
+/// patience algorithm: the longest sequence of lines that occur once in both
+/// regions is kept, and the regions between those lines are compared in the
+/// same way. Falls back to Myers for regions without unique lines.
+///
+/// @param histogram  Instead of using Myers, anchor regions without unique
+///                   lines on one of the lines that occur least often.
+static void anchor_compare(LineDiffCtx *ctx, long off1, long lim1,
+                           long off2, long lim2, bool histogram)
+{
+  const int *a = ctx->a;
+  const int *b = ctx->b;
+
+  // Loops instead of recursing on the larger part of a histogram split, to
+  // keep the recursion shallow.
+  for (;;) {
+    if (!trim_region(ctx, &off1, &lim1, &off2, &lim2)) {
+      return;
+    }
+
+    for (long i = off1; i < lim1; i++) {
+      ctx->cnt_a[a[i]]++;
+      ctx->pos_a[a[i]] = i;
+    }
+    for (long i = off2; i < lim2; i++) {
+      ctx->cnt_b[b[i]]++;
+      ctx->pos_b[b[i]] = i;
+    }
+
+    // Unique lines in the order of "b", the longest sequence that is also
+    // in the order of "a" is found with patience sorting: "tails[k]" is the
+    // pair that ends the best sequence of length k + 1.
+    kvec_t(PatiencePair) pairs = KV_INITIAL_VALUE;
+    kvec_t(long) tails = KV_INITIAL_VALUE;
+    int best_cnt = INT_MAX;
+    long best2 = -1;
+    for (long i2 = off2; i2 < lim2; i2++) {
+      int id = b[i2];
+      int cnt_a = ctx->cnt_a[id];
+      if (!cnt_a) {
+        continue;
+      }
+      int cnt = MAX(cnt_a, ctx->cnt_b[id]);
+      if (cnt < best_cnt) {
+        best_cnt = cnt;
+        best2 = i2;
+      }
+      if (cnt != 1) {
+        continue;
+      }
+      long i1 = ctx->pos_a[id];
+      size_t lo = 0;
+      size_t hi = kv_size(tails);
+      while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (kv_A(pairs, kv_A(tails, mid)).i1 < i1) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      long prev = lo ? kv_A(tails, lo - 1) : -1;
+      kv_push(pairs, ((PatiencePair) { .i1 = i1, .i2 = i2, .prev = prev }));
+      if (lo == kv_size(tails)) {
+        kv_push(tails, (long)kv_size(pairs) - 1);
+      } else {
+        kv_A(tails, lo) = (long)kv_size(pairs) - 1;
+      }
+    }
+
+    for (long i = off1; i < lim1; i++) {
+      ctx->cnt_a[a[i]] = 0;
+    }
+    for (long i = off2; i < lim2; i++) {
+      ctx->cnt_b[b[i]] = 0;
+    }
+
+    if (kv_size(tails)) {
+      // Link the sequence forward, then compare the regions between its
+      // lines.  The region after the last line is compared by the next
+      // iteration.
+      long next = -1;
+      for (long k = kv_last(tails); k >= 0;) {
+        long prev = kv_A(pairs, k).prev;
+        kv_A(pairs, k).prev = next;
+        next = k;
+        k = prev;
+      }
+      for (long k = next; k >= 0; k = kv_A(pairs, k).prev) {
+        PatiencePair p = kv_A(pairs, k);
+        anchor_compare(ctx, off1, p.i1, off2, p.i2, histogram);
+        off1 = p.i1 + 1;
+        off2 = p.i2 + 1;
+      }
+      kv_destroy(pairs);
+      kv_destroy(tails);
+      continue;
+    }
+    kv_destroy(pairs);
+    kv_destroy(tails);
+
+    if (best2 < 0) {
+      // Nothing in common
+      memset(ctx->chg_a + off1, 1, (size_t)(lim1 - off1));
+      memset(ctx->chg_b + off2, 1, (size_t)(lim2 - off2));
+      return;
+    }
+    if (!histogram || best_cnt > HISTOGRAM_MAX_CHAIN) {
+      myers_compare(ctx, off1, lim1, off2, lim2, false);
+      return;
+    }
+
+    // Keep the first occurrence of the rarest line, and the equal lines
+    // around it.
+    long s1 = off1;
+    while (a[s1] != b[best2]) {
+      s1++;
+    }
+    long s2 = best2;
+    while (s1 > off1 && s2 > off2 && a[s1 - 1] == b[s2 - 1]) {
+      s1--;
+      s2--;
+    }
+    long e1 = s1;
+    long e2 = s2;
+    while (e1 < lim1 && e2 < lim2 && a[e1] == b[e2]) {
+      e1++;
+      e2++;
+    }
+    if ((s1 - off1) + (s2 - off2) < (lim1 - e1) + (lim2 - e2)) {
+      anchor_compare(ctx, off1, s1, off2, s2, histogram);
+      off1 = e1;
+      off2 = e2;
+    } else {
+      anchor_compare(ctx, e1, lim1, e2, lim2, histogram);
+      lim1 = s1;
+      lim2 = s2;
+    }
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef NVIM_LINEDIFF_H
+#define NVIM_LINEDIFF_H
+
+#include "nvim/lib/kvec.h"
+
+/// Algorithm used by linediff(), see "algorithm:" in 'diffopt'.
+typedef enum {
+  kLineDiffMyers,      ///< Myers with a cost limit, fast but may not be minimal
+  kLineDiffMinimal,    ///< Myers without cost limit, always minimal
+  kLineDiffPatience,   ///< Anchored on lines that are unique in both sides
+  kLineDiffHistogram,  ///< Patience, also anchored on rare lines
+} LineDiffAlgorithm;
+
+/// A change between two sequences of lines, indexes are 0-based.
+///
+/// A count of zero means lines were only added to (or deleted from) the
+/// other side, before index "start_a" (or "start_b").
+typedef struct {
+  long start_a, count_a;
+  long start_b, count_b;
+} LineDiffHunk;
+
+typedef kvec_t(LineDiffHunk) LineDiffHunks;
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "linediff.h.generated.h"
+#endif
+#endif  // NVIM_LINEDIFF_H
@@ -534,6 +534,88 @@ void time_to_bytes(time_t time_, uint8_t buf[8])
   }
 }
 
+/// Header of every Arena block, links it to the previous block.
+typedef struct {
+  char *prev;
+} ArenaBlock;
+
+#define ARENA_ALIGN MAX(sizeof(void *), sizeof(double))
+#define ARENA_HEADER_SIZE \
+  ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/// A released ARENA_BLOCK_SIZE block, reused by the next arena
+static char *arena_reuse_blk = NULL;
+
+static char *arena_new_blk(char *prev, size_t size)
+{
+  char *blk;
+  if (size == ARENA_BLOCK_SIZE && arena_reuse_blk) {
+    blk = arena_reuse_blk;
+    arena_reuse_blk = NULL;
+  } else {
+    blk = xmalloc(size);
+  }
+  ((ArenaBlock *)blk)->prev = prev;
+  return blk;
+}
+
+/// Allocates `size` bytes, aligned for any API object, from `arena`.
+///
+/// @return pointer to allocated space. Never NULL
+void *arena_alloc(Arena *arena, size_t size)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_NONNULL_RET
+{
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (size > ARENA_BLOCK_SIZE / 4) {
+    // Large allocation, give it its own block behind the current one
+    char *blk = arena_new_blk(NULL, ARENA_HEADER_SIZE + size);
+    if (arena->cur_blk) {
+      ((ArenaBlock *)blk)->prev = ((ArenaBlock *)arena->cur_blk)->prev;
+      ((ArenaBlock *)arena->cur_blk)->prev = blk;
+    } else {
+      arena->cur_blk = blk;
+      arena->pos = arena->size = ARENA_HEADER_SIZE + size;
+    }
+    return blk + ARENA_HEADER_SIZE;
+  }
+  if (!arena->cur_blk || arena->pos + size > arena->size) {
+    arena->cur_blk = arena_new_blk(arena->cur_blk, ARENA_BLOCK_SIZE);
+    arena->pos = ARENA_HEADER_SIZE;
+    arena->size = ARENA_BLOCK_SIZE;
+  }
+  char *mem = arena->cur_blk + arena->pos;
+  arena->pos += size;
+  return mem;
+}
+
+/// Like xmemdupz(), allocating from `arena`.
+char *arena_memdupz(Arena *arena, const char *data, size_t len)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_NONNULL_RET
+{
+  char *mem = arena_alloc(arena, len + 1);
+  memcpy(mem, data, len);
+  mem[len] = NUL;
+  return mem;
+}
+
+/// Releases all memory allocated from `arena`, which can be reused.
+void arena_mem_free(Arena *arena)
+  FUNC_ATTR_NONNULL_ALL
+{
+  char *blk = arena->cur_blk;
+  while (blk) {
+    char *prev = ((ArenaBlock *)blk)->prev;
+    if (!arena_reuse_blk && blk == arena->cur_blk
+        && arena->size == ARENA_BLOCK_SIZE) {
+      arena_reuse_blk = blk;
+    } else {
+      xfree(blk);
+    }
+    blk = prev;
+  }
+  *arena = (Arena)ARENA_EMPTY;
+}
+
 #if defined(EXITFREE)
 
 #include "nvim/file_search.h"
@@ -701,6 +783,9 @@ void free_all_mem(void)
 
   clear_hl_tables(false);
   list_free_log();
+
+  xfree(arena_reuse_blk);
+  arena_reuse_blk = NULL;
 }
 
 #endif
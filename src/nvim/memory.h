@@ -18,6 +18,18 @@ typedef void *(*MemCalloc)(size_t, size_t);
 /// `realloc()` function signature
 typedef void *(*MemRealloc)(void *, size_t);
 
+/// Bump allocator, for many small allocations released all at once.
+///
+/// Memory is carved out of ARENA_BLOCK_SIZE blocks (or a dedicated block for
+/// large allocations) and only released by arena_mem_free().
+typedef struct {
+  char *cur_blk;  ///< Current block, starts with a pointer to the previous one
+  size_t pos, size;  ///< Used and total size of `cur_blk`
+} Arena;
+
+#define ARENA_EMPTY { .cur_blk = NULL, .pos = 0, .size = 0 }
+#define ARENA_BLOCK_SIZE 4096
+
 #ifdef UNIT_TESTING
 /// When unit testing: pointer to the `malloc()` function, may be altered
 extern MemMalloc mem_malloc;
@@ -2008,6 +2008,9 @@ static void changed_common(linenr_T lnum, colnr_T col, linenr_T lnume, long xtra
   /* mark the buffer as modified */
   changed();
 
+  // The internal diff is updated before the next redraw.
+  diff_internal_changed(curbuf);
+
   /* set the '. mark */
   if (!cmdmod.keepjumps) {
     RESET_FMARK(&curbuf->b_last_change, ((pos_T) {lnum, col, 0}), 0);
@@ -19,6 +19,7 @@
 #include "nvim/event/wstream.h"
 #include "nvim/event/socket.h"
 #include "nvim/msgpack_rpc/helpers.h"
+#include "nvim/msgpack_rpc/frame.h"
 #include "nvim/vim.h"
 #include "nvim/main.h"
 #include "nvim/ascii.h"
@@ -32,11 +33,28 @@
 #include "nvim/lib/kvec.h"
 #include "nvim/os/input.h"
 
+// RPC streams read directly into the unpacker buffer. The size reserved for
+// a read starts at RPC_READ_SIZE_MIN and doubles (up to RPC_READ_SIZE_MAX)
+// every time a read fills it, so large payloads arrive in few reads. Reading
+// stops while RPC_READ_PENDING_MAX bytes wait to be parsed.
+#define RPC_READ_SIZE_MIN 0x10000
+#define RPC_READ_SIZE_MAX 0x100000
+#define RPC_READ_PENDING_MAX (4 * RPC_READ_SIZE_MAX)
+
 #if MIN_LOG_LEVEL > DEBUG_LOG_LEVEL
 #define log_client_msg(...)
 #define log_server_msg(...)
 #endif
 
+/// An interned event name and the channels subscribed to it
+typedef struct {
+  char *name;
+  kvec_t(Channel *) subscribers;
+} EventSubscribers;
+
+/// Maps event names to their EventSubscribers. An entry exists while at
+/// least one channel is subscribed, so broadcasting is a single lookup
+/// instead of a scan of every channel.
 static PMap(cstr_t) *event_strings = NULL;
 static msgpack_sbuffer out_buffer;
 
@@ -62,6 +80,10 @@ void rpc_start(Channel *channel)
   rpc->subscribed_events = pmap_new(cstr_t)();
   rpc->next_request_id = 1;
   rpc->info = (Dictionary)ARRAY_DICT_INIT;
+  rpc->compression = kRpcCompressionOff;
+  rpc->read_size = RPC_READ_SIZE_MIN;
+  rpc->read_pending = 0;
+  rpc->read_stopped = false;
   kv_init(rpc->call_stack);
 
   if (channel->streamtype != kChannelStreamInternal) {
@@ -71,6 +93,7 @@ void rpc_start(Channel *channel)
     DLOG("rpc ch %" PRIu64 " in-stream=%p out-stream=%p", channel->id, in, out);
 #endif
 
+    rstream_set_reserve(out, reserve_msgpack, commit_msgpack);
     rstream_start(out, receive_msgpack, channel);
   }
 }
@@ -109,6 +132,28 @@ bool rpc_send_event(uint64_t id, const char *name, Array args)
   return true;
 }
 
+/// Sends a message that is already serialized to a channel, e.g. redraw
+/// events packed by the UI as they are emitted.
+///
+/// @param id Channel id
+/// @param buffer Serialized message, released if it cannot be sent
+/// @return True if the message was sent successfully, false otherwise.
+bool rpc_write_raw(uint64_t id, WBuffer *buffer)
+{
+  Channel *channel = find_rpc_channel(id);
+  if (!channel) {
+    wstream_release_wbuffer(buffer);
+    return false;
+  }
+#if MIN_LOG_LEVEL <= DEBUG_LOG_LEVEL
+  msgpack_sbuffer packed = {
+    .size = buffer->size, .data = buffer->data, .alloc = buffer->size
+  };
+  log_server_msg(id, &packed);
+#endif
+  return channel_write(channel, buffer);
+}
+
 /// Sends a method call to a channel
 ///
 /// @param id The channel id
@@ -181,14 +226,21 @@ void rpc_subscribe(uint64_t id, char *event)
     abort();
   }
 
-  char *event_string = pmap_get(cstr_t)(event_strings, event);
+  EventSubscribers *ev = pmap_get(cstr_t)(event_strings, event);
+
+  if (!ev) {
+    ev = xmalloc(sizeof(*ev));
+    ev->name = xstrdup(event);
+    kv_init(ev->subscribers);
+    pmap_put(cstr_t)(event_strings, ev->name, ev);
+  }
 
-  if (!event_string) {
-    event_string = xstrdup(event);
-    pmap_put(cstr_t)(event_strings, event_string, event_string);
+  if (pmap_has(cstr_t)(channel->rpc.subscribed_events, ev->name)) {
+    return;
   }
 
-  pmap_put(cstr_t)(channel->rpc.subscribed_events, event_string, event_string);
+  pmap_put(cstr_t)(channel->rpc.subscribed_events, ev->name, ev);
+  kv_push(ev->subscribers, channel);
 }
 
 /// Unsubscribes to event broadcasts
@@ -206,6 +258,41 @@ void rpc_unsubscribe(uint64_t id, char *event)
   unsubscribe(channel, event);
 }
 
+static char *reserve_msgpack(Stream *stream, size_t *len, void *data)
+{
+  Channel *channel = data;
+  msgpack_unpacker *unpacker = channel->rpc.unpacker;
+
+  if (!msgpack_unpacker_reserve_buffer(unpacker, channel->rpc.read_size)) {
+    mch_errmsg(e_outofmem);
+    mch_errmsg("\n");
+    preserve_exit();
+  }
+  *len = msgpack_unpacker_buffer_capacity(unpacker);
+  return msgpack_unpacker_buffer(unpacker);
+}
+
+static void commit_msgpack(Stream *stream, size_t count, void *data)
+{
+  Channel *channel = data;
+  RpcState *rpc = &channel->rpc;
+  msgpack_unpacker_buffer_consumed(rpc->unpacker, count);
+
+  // Adapt the next read to the size of the bursts sent by the client
+  if (count >= rpc->read_size) {
+    rpc->read_size = MIN(rpc->read_size * 2, RPC_READ_SIZE_MAX);
+  } else if (count < rpc->read_size / 4) {
+    rpc->read_size = MAX(rpc->read_size / 2, RPC_READ_SIZE_MIN);
+  }
+
+  // Stop reading until the queued read events are processed
+  rpc->read_pending += count;
+  if (rpc->read_pending >= RPC_READ_PENDING_MAX && !rpc->read_stopped) {
+    rpc->read_stopped = true;
+    rstream_stop(stream);
+  }
+}
+
 static void receive_msgpack(Stream *stream, RBuffer *rbuf, size_t c,
                             void *data, bool eof)
 {
@@ -221,14 +308,14 @@ static void receive_msgpack(Stream *stream, RBuffer *rbuf, size_t c,
     goto end;
   }
 
-  size_t count = rbuffer_size(rbuf);
+  // The data was already read into the unpacker by commit_msgpack()
   DLOG("ch %" PRIu64 ": parsing %zu bytes from msgpack Stream: %p",
-       channel->id, count, stream);
-
-  // Feed the unpacker with data
-  msgpack_unpacker_reserve_buffer(channel->rpc.unpacker, count);
-  rbuffer_read(rbuf, msgpack_unpacker_buffer(channel->rpc.unpacker), count);
-  msgpack_unpacker_buffer_consumed(channel->rpc.unpacker, count);
+       channel->id, channel->rpc.read_pending, stream);
+  channel->rpc.read_pending = 0;
+  if (channel->rpc.read_stopped) {
+    channel->rpc.read_stopped = false;
+    rstream_start(stream, receive_msgpack, channel);
+  }
 
   parse_msgpack(channel);
 
@@ -318,17 +405,19 @@ static void handle_request(Channel *channel, msgpack_object *request)
                                         method->via.bin.size,
                                         &error);
 
-  // check method arguments
+  // check method arguments, they are all allocated from one arena that is
+  // released after the request was handled
+  Arena arena = ARENA_EMPTY;
   Array args = ARRAY_DICT_INIT;
   if (!ERROR_SET(&error)
-      && !msgpack_rpc_to_array(msgpack_rpc_args(request), &args)) {
+      && !msgpack_rpc_to_array(msgpack_rpc_args(request), &args, &arena)) {
     api_set_error(&error, kErrorTypeException, "Invalid method arguments");
   }
 
   if (ERROR_SET(&error)) {
     send_error(channel, request_id, error.msg);
     api_clear_error(&error);
-    api_free_array(args);
+    arena_mem_free(&arena);
     return;
   }
 
@@ -336,6 +425,7 @@ static void handle_request(Channel *channel, msgpack_object *request)
   evdata->channel = channel;
   evdata->handler = handler;
   evdata->args = args;
+  evdata->arena = arena;
   evdata->request_id = request_id;
   channel_incref(channel);
   if (handler.async) {
@@ -362,7 +452,9 @@ static void on_request_event(void **argv)
   Array args = e->args;
   uint64_t request_id = e->request_id;
   Error error = ERROR_INIT;
-  Object result = handler.fn(channel->id, args, &error);
+  // The result can be allocated in the arena of the request, it is only
+  // released after the response was serialized
+  Object result = handler.fn(channel->id, args, &e->arena, &error);
   if (request_id != NO_RESPONSE) {
     // send the response
     msgpack_packer response;
@@ -372,10 +464,11 @@ static void on_request_event(void **argv)
                                               &error,
                                               result,
                                               &out_buffer));
-  } else {
+  }
+  if (!handler.arena_return) {
     api_free_object(result);
   }
-  api_free_array(args);
+  arena_mem_free(&e->arena);
   channel_decref(channel);
   xfree(e);
   api_clear_error(&error);
@@ -395,6 +488,13 @@ static bool channel_write(Channel *channel, WBuffer *buffer)
     CREATE_EVENT(channel->events, internal_read_event, 2, channel, buffer);
     success = true;
   } else {
+    if (channel->rpc.compression == kRpcCompressionOn) {
+      buffer = rpc_frame_buffer(buffer);
+    } else if (channel->rpc.compression == kRpcCompressionPending) {
+      // This is the response to nvim_set_compression(), later messages
+      // are compressed
+      channel->rpc.compression = kRpcCompressionOn;
+    }
     Stream *in = channel_instream(channel);
     success = wstream_write(in, buffer);
   }
@@ -471,58 +571,57 @@ static void send_event(Channel *channel,
 
 static void broadcast_event(const char *name, Array args)
 {
-  kvec_t(Channel *) subscribed = KV_INITIAL_VALUE;
-  Channel *channel;
+  EventSubscribers *ev = pmap_get(cstr_t)(event_strings, name);
 
-  map_foreach_value(channels, channel, {
-    if (channel->is_rpc
-        && pmap_has(cstr_t)(channel->rpc.subscribed_events, name)) {
-      kv_push(subscribed, channel);
-    }
-  });
-
-  if (!kv_size(subscribed)) {
+  if (!ev || !kv_size(ev->subscribers)) {
     api_free_array(args);
-    goto end;
+    return;
   }
 
-  const String method = cstr_as_string((char *)name);
+  // Serialize once, every subscriber holds a reference to the same buffer
+  const String method = cstr_as_string(ev->name);
   WBuffer *buffer = serialize_request(0,
                                       0,
                                       method,
                                       args,
                                       &out_buffer,
-                                      kv_size(subscribed));
+                                      kv_size(ev->subscribers));
 
-  for (size_t i = 0; i < kv_size(subscribed); i++) {
-    Channel *channel = kv_A(subscribed, i);
-    channel_write(channel, buffer);
+  for (size_t i = 0; i < kv_size(ev->subscribers); i++) {
+    channel_write(kv_A(ev->subscribers, i), buffer);
   }
-
-end:
-  kv_destroy(subscribed);
 }
 
 static void unsubscribe(Channel *channel, char *event)
 {
-  char *event_string = pmap_get(cstr_t)(event_strings, event);
-  if (!event_string) {
+  EventSubscribers *ev = pmap_get(cstr_t)(channel->rpc.subscribed_events,
+                                          event);
+  if (!ev) {
       WLOG("RPC: ch %" PRIu64 ": tried to unsubscribe unknown event '%s'",
            channel->id, event);
       return;
   }
-  pmap_del(cstr_t)(channel->rpc.subscribed_events, event_string);
+  pmap_del(cstr_t)(channel->rpc.subscribed_events, ev->name);
 
-  map_foreach_value(channels, channel, {
-    if (channel->is_rpc
-        && pmap_has(cstr_t)(channel->rpc.subscribed_events, event_string)) {
-      return;
+  size_t n = kv_size(ev->subscribers);
+  for (size_t i = 0; i < n; i++) {
+    if (kv_A(ev->subscribers, i) == channel) {
+      // Order is irrelevant, move the last subscriber into the hole
+      kv_A(ev->subscribers, i) = kv_A(ev->subscribers, n - 1);
+      kv_size(ev->subscribers)--;
+      break;
     }
-  });
+  }
 
-  // Since the string is no longer used by other channels, release it's memory
-  pmap_del(cstr_t)(event_strings, event_string);
-  xfree(event_string);
+  if (kv_size(ev->subscribers)) {
+    return;
+  }
+
+  // Since the event is no longer used by other channels, release its memory
+  pmap_del(cstr_t)(event_strings, ev->name);
+  kv_destroy(ev->subscribers);
+  xfree(ev->name);
+  xfree(ev);
 }
 
 
@@ -555,9 +654,9 @@ void rpc_free(Channel *channel)
   msgpack_unpacker_free(channel->rpc.unpacker);
 
   // Unsubscribe from all events
-  char *event_string;
-  map_foreach_value(channel->rpc.subscribed_events, event_string, {
-    unsubscribe(channel, event_string);
+  EventSubscribers *ev;
+  map_foreach_value(channel->rpc.subscribed_events, ev, {
+    unsubscribe(channel, ev->name);
   });
 
   pmap_free(cstr_t)(channel->rpc.subscribed_events);
@@ -648,10 +747,25 @@ static WBuffer *serialize_response(uint64_t channel_id,
                                    1,  // responses only go though 1 channel
                                    xfree);
   msgpack_sbuffer_clear(sbuffer);
-  api_free_object(arg);
   return rv;
 }
 
+/// Compresses the messages sent to a channel, starting after the next
+/// message (the response to nvim_set_compression())
+///
+/// @return false if the channel does not support compression
+bool rpc_set_compression(uint64_t id)
+{
+  Channel *chan = find_rpc_channel(id);
+  if (!chan || chan->streamtype == kChannelStreamInternal) {
+    return false;
+  }
+  if (chan->rpc.compression == kRpcCompressionOff) {
+    chan->rpc.compression = kRpcCompressionPending;
+  }
+  return true;
+}
+
 void rpc_set_client_info(uint64_t id, Dictionary info)
 {
   Channel *chan = find_rpc_channel(id);
@@ -7,6 +7,7 @@
 #include "nvim/api/private/defs.h"
 #include "nvim/event/socket.h"
 #include "nvim/event/process.h"
+#include "nvim/event/wstream.h"
 #include "nvim/vim.h"
 #include "nvim/channel.h"
 
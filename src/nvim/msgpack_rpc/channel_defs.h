@@ -9,6 +9,7 @@
 #include "nvim/event/socket.h"
 #include "nvim/event/process.h"
 #include "nvim/vim.h"
+#include "nvim/memory.h"
 
 typedef struct Channel Channel;
 
@@ -21,17 +22,29 @@ typedef struct {
 typedef struct {
   Channel *channel;
   MsgpackRpcRequestHandler handler;
-  Array args;
+  Array args;  ///< Allocated from `arena`, handlers copy what they keep
+  Arena arena;
   uint64_t request_id;
 } RequestEvent;
 
+typedef enum {
+  kRpcCompressionOff,
+  kRpcCompressionPending,  ///< Enabled after the next message is sent
+  kRpcCompressionOn,
+} RpcCompression;
+
 typedef struct {
+  /// Subscribed event names, mapped to their interned subscriber lists
   PMap(cstr_t) *subscribed_events;
   bool closed;
   msgpack_unpacker *unpacker;
   uint64_t next_request_id;
   kvec_t(ChannelCallFrame *) call_stack;
   Dictionary info;
+  RpcCompression compression;  ///< See nvim_set_compression()
+  size_t read_size;  ///< Bytes reserved in the unpacker for the next read
+  size_t read_pending;  ///< Bytes read but not yet parsed
+  bool read_stopped;  ///< Reading paused until read_pending is parsed
 } RpcState;
 
 #endif  // NVIM_MSGPACK_RPC_CHANNEL_DEFS_H
@@ -0,0 +1,152 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check
+// it. PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+// Compressed frames for RPC channels, see nvim_set_compression().
+//
+// A frame holds a single message:
+//
+//   marker (0xc1) | message size | payload size | payload
+//
+// Sizes are big endian uint32. The payload is the message compressed with
+// the LZ4 block format, or the message itself when the payload size equals
+// the message size. Every frame is compressed on its own, the decoder does
+// not need earlier frames.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "nvim/vim.h"
+#include "nvim/memory.h"
+#include "nvim/msgpack_rpc/frame.h"
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "msgpack_rpc/frame.c.generated.h"
+#endif
+
+#define LZ4_HASH_LOG 12
+#define LZ4_MIN_MATCH 4
+// The last match must start this many bytes before the end of the input,
+// and the last bytes are always literals
+#define LZ4_MF_LIMIT 12
+#define LZ4_LAST_LITERALS 5
+// Messages smaller than this are not worth compressing
+#define FRAME_MIN_COMPRESS 64
+
+static uint32_t read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static void write_be32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static uint32_t lz4_hash(uint32_t seq)
+{
+  return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/// Writes a length that does not fit in a token nibble
+static uint8_t *lz4_write_length(uint8_t *op, size_t len)
+{
+  for (; len >= 255; len -= 255) {
+    *op++ = 255;
+  }
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+/// Upper bound for the compressed size of len bytes
+size_t lz4_compress_bound(size_t len)
+{
+  return len + len / 255 + 16;
+}
+
+/// Compresses src with the LZ4 block format
+///
+/// @param dst At least lz4_compress_bound(len) bytes
+/// @return The compressed size
+size_t lz4_compress(const uint8_t *src, size_t len, uint8_t *dst)
+{
+  uint32_t table[1 << LZ4_HASH_LOG];
+  memset(table, 0, sizeof(table));
+  uint8_t *op = dst;
+  size_t anchor = 0;
+  size_t ip = 1;
+
+  while (len > LZ4_MF_LIMIT && ip < len - LZ4_MF_LIMIT) {
+    uint32_t seq = read32(src + ip);
+    uint32_t h = lz4_hash(seq);
+    size_t ref = table[h];
+    table[h] = (uint32_t)ip;
+    if (ip - ref > UINT16_MAX || read32(src + ref) != seq) {
+      ip++;
+      continue;
+    }
+
+    size_t mlen = LZ4_MIN_MATCH;
+    while (ip + mlen < len - LZ4_LAST_LITERALS
+           && src[ref + mlen] == src[ip + mlen]) {
+      mlen++;
+    }
+
+    size_t lits = ip - anchor;
+    uint8_t *token = op++;
+    *token = (uint8_t)((lits >= 15 ? 15 : lits) << 4);
+    if (lits >= 15) {
+      op = lz4_write_length(op, lits - 15);
+    }
+    memcpy(op, src + anchor, lits);
+    op += lits;
+    size_t offset = ip - ref;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    size_t mcode = mlen - LZ4_MIN_MATCH;
+    *token |= (uint8_t)(mcode >= 15 ? 15 : mcode);
+    if (mcode >= 15) {
+      op = lz4_write_length(op, mcode - 15);
+    }
+
+    ip += mlen;
+    anchor = ip;
+  }
+
+  size_t lits = len - anchor;
+  *op++ = (uint8_t)((lits >= 15 ? 15 : lits) << 4);
+  if (lits >= 15) {
+    op = lz4_write_length(op, lits - 15);
+  }
+  memcpy(op, src + anchor, lits);
+  op += lits;
+  return (size_t)(op - dst);
+}
+
+/// Wraps a message in a frame, the message buffer is released
+///
+/// @return A new buffer with a refcount of 1
+WBuffer *rpc_frame_buffer(WBuffer *buffer)
+{
+  size_t len = buffer->size;
+  uint8_t *frame = xmalloc(RPC_FRAME_HEADER_SIZE + lz4_compress_bound(len));
+  size_t payload = len;
+  if (len >= FRAME_MIN_COMPRESS) {
+    payload = lz4_compress((const uint8_t *)buffer->data, len,
+                           frame + RPC_FRAME_HEADER_SIZE);
+  }
+  if (payload >= len) {
+    payload = len;
+    memcpy(frame + RPC_FRAME_HEADER_SIZE, buffer->data, len);
+  }
+  frame[0] = RPC_FRAME_MARKER;
+  write_be32(frame + 1, (uint32_t)len);
+  write_be32(frame + 5, (uint32_t)payload);
+  wstream_release_wbuffer(buffer);
+  return wstream_new_buffer((char *)frame, RPC_FRAME_HEADER_SIZE + payload, 1,
+                            xfree);
+}
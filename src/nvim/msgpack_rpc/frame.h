@@ -0,0 +1,17 @@
+#ifndef NVIM_MSGPACK_RPC_FRAME_H
+#define NVIM_MSGPACK_RPC_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nvim/event/wstream.h"
+
+/// First byte of a frame, 0xc1 is never used by msgpack
+#define RPC_FRAME_MARKER 0xc1
+/// Marker, message size and payload size (big endian uint32)
+#define RPC_FRAME_HEADER_SIZE 9
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "msgpack_rpc/frame.h.generated.h"
+#endif
+#endif  // NVIM_MSGPACK_RPC_FRAME_H
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include <msgpack.h>
 
@@ -85,6 +86,32 @@ typedef struct {
 /// @return true in case of success, false otherwise.
 bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
   FUNC_ATTR_NONNULL_ALL
+{
+  return msgpack_rpc_to_object_arena(obj, arg, NULL);
+}
+
+static void *rpc_calloc(Arena *arena, size_t count, size_t size)
+{
+  if (!arena) {
+    return xcalloc(count, size);
+  }
+  void *mem = arena_alloc(arena, count * size);
+  memset(mem, 0, count * size);
+  return mem;
+}
+
+static char *rpc_memdupz(Arena *arena, const char *data, size_t len)
+{
+  return arena ? arena_memdupz(arena, data, len) : xmemdupz(data, len);
+}
+
+/// Like msgpack_rpc_to_object(), allocating from `arena`.
+///
+/// @param  arena  Arena for the converted value, NULL to use the heap. Values
+///                in an arena must not be freed with api_free_object().
+static bool msgpack_rpc_to_object_arena(const msgpack_object *const obj,
+                                        Object *const arg, Arena *arena)
+  FUNC_ATTR_NONNULL_ARG(1, 2)
 {
   bool ret = true;
   kvec_t(MPToAPIObjectStackItem) stack = KV_INITIAL_VALUE;
@@ -140,8 +167,9 @@ bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
         dest = conv(((String) { \
           .size = obj->via.attr.size, \
           .data = (obj->via.attr.ptr == NULL || obj->via.attr.size == 0 \
-                   ? xmemdupz("", 0) \
-                   : xmemdupz(obj->via.attr.ptr, obj->via.attr.size)), \
+                   ? rpc_memdupz(arena, "", 0) \
+                   : rpc_memdupz(arena, obj->via.attr.ptr, \
+                                 obj->via.attr.size)), \
         })); \
         break; \
       }
@@ -167,7 +195,8 @@ bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
             .size = size,
             .capacity = size,
             .items = (size > 0
-                      ? xcalloc(size, sizeof(*cur.aobj->data.array.items))
+                      ? rpc_calloc(arena, size,
+                                   sizeof(*cur.aobj->data.array.items))
                       : NULL),
           }));
           cur.container = true;
@@ -222,7 +251,8 @@ bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
             .size = size,
             .capacity = size,
             .items = (size > 0
-                      ? xcalloc(size, sizeof(*cur.aobj->data.dictionary.items))
+                      ? rpc_calloc(arena, size,
+                                   sizeof(*cur.aobj->data.dictionary.items))
                       : NULL),
           }));
           cur.container = true;
@@ -283,18 +313,25 @@ static bool msgpack_rpc_to_string(const msgpack_object *const obj,
   return false;
 }
 
-bool msgpack_rpc_to_array(const msgpack_object *const obj, Array *const arg)
-  FUNC_ATTR_NONNULL_ALL
+/// Convert a msgpack array to an Array.
+///
+/// @param  arena  Arena for the converted items, NULL to use the heap. Used
+///                for request arguments, which are all released at once
+///                after the request was handled.
+bool msgpack_rpc_to_array(const msgpack_object *const obj, Array *const arg,
+                          Arena *arena)
+  FUNC_ATTR_NONNULL_ARG(1, 2)
 {
   if (obj->type != MSGPACK_OBJECT_ARRAY) {
     return false;
   }
 
   arg->size = obj->via.array.size;
-  arg->items = xcalloc(obj->via.array.size, sizeof(Object));
+  arg->items = rpc_calloc(arena, obj->via.array.size, sizeof(Object));
 
   for (uint32_t i = 0; i < obj->via.array.size; i++) {
-    if (!msgpack_rpc_to_object(obj->via.array.ptr + i, &arg->items[i])) {
+    if (!msgpack_rpc_to_object_arena(obj->via.array.ptr + i, &arg->items[i],
+                                     arena)) {
       return false;
     }
   }
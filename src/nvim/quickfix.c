@@ -44,6 +44,8 @@
 #include "nvim/window.h"
 #include "nvim/os/os.h"
 #include "nvim/os/input.h"
+#include "nvim/event/loop.h"
+#include "nvim/main.h"
 
 
 struct dir_stack_T {
@@ -186,6 +188,30 @@ typedef struct {
   bool   valid;
 } qffields_T;
 
+/// Number of files ":vimgrep" reads ahead of the file it is searching
+#define VGR_READ_AHEAD 64
+
+/// Larger files are searched in a buffer, like files that are not plain text
+#define VGR_PLAIN_MAX_SIZE (8 * 1024 * 1024)
+
+/// A file read by a ":vimgrep" worker thread.
+typedef struct {
+  uv_work_t req;
+  char *fname;        ///< full path of the file, NULL when not read
+  char *text;         ///< lines of the file, each ends in a NUL
+  linenr_T lcount;    ///< number of lines in "text"
+  bool plain;         ///< "text" can be searched without loading a buffer
+  bool done;          ///< the worker is finished with this file
+} vgrfile_T;
+
+/// Files of a ":vimgrep" command that are read by the libuv threadpool.
+typedef struct {
+  vgrfile_T *files;
+  int fcount;
+  int submitted;      ///< files before this one were queued (or skipped)
+  int pending;        ///< number of queued files that are not done
+} vgrpool_T;
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "quickfix.c.generated.h"
 #endif
@@ -3551,6 +3577,214 @@ void ex_cfile(exarg_T *eap)
   }
 }
 
+/// Return true if ":vimgrep" can search files without loading them into a
+/// buffer: no autocommands are triggered when loading or unloading a file,
+/// text in 'encoding' is used as-is and the pattern only matches within a
+/// line.
+static bool vgr_plain_ok(regprog_T *prog, const char_u *pat)
+{
+  if (re_multiline(prog)
+      || has_event(EVENT_BUFREADPRE) || has_event(EVENT_BUFREADPOST)
+      || has_event(EVENT_BUFREADCMD) || has_event(EVENT_FILEREADCMD)
+      || has_event(EVENT_BUFNEW) || has_event(EVENT_BUFADD)
+      || has_event(EVENT_SWAPEXISTS) || has_event(EVENT_BUFUNLOAD)
+      || has_event(EVENT_BUFDELETE) || has_event(EVENT_BUFWIPEOUT)) {
+    return false;
+  }
+  if (STRNCMP(p_fencs, "utf-8", 5) != 0
+      && STRNCMP(p_fencs, "ucs-bom,utf-8", 13) != 0) {
+    return false;
+  }
+  // Items that match a line number, mark, cursor or Visual area need the
+  // buffer.
+  for (const char_u *p = pat; *p != NUL; p++) {
+    if (*p == '%') {
+      const char_u *q = p + 1;
+      if (*q == '<' || *q == '>') {
+        q++;
+      }
+      if (ascii_isdigit(*q) || *q == '\'' || *q == '#' || *q == 'V') {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Read a file for ":vimgrep", runs in a thread of the libuv threadpool.
+/// Only files that are valid UTF-8 without NUL bytes, carriage returns or
+/// a byte order mark are "plain", others are loaded into a buffer.
+static void vgr_read_work(uv_work_t *req)
+{
+  vgrfile_T *file = (vgrfile_T *)req;
+  uv_fs_t fs;
+
+  int fd = uv_fs_open(NULL, &fs, file->fname, O_RDONLY, 0, NULL);
+  uv_fs_req_cleanup(&fs);
+  if (fd < 0) {
+    return;
+  }
+  int r = uv_fs_fstat(NULL, &fs, fd, NULL);
+  uint64_t size = fs.statbuf.st_size;
+  bool regular = S_ISREG(fs.statbuf.st_mode);
+  uv_fs_req_cleanup(&fs);
+  if (r < 0 || !regular || size > VGR_PLAIN_MAX_SIZE) {
+    goto theend;
+  }
+
+  char *text = xmalloc((size_t)size + 1);
+  size_t len = 0;
+  while (len < size) {
+    uv_buf_t buf = uv_buf_init(text + len, (unsigned int)(size - len));
+    r = uv_fs_read(NULL, &fs, fd, &buf, 1, -1, NULL);
+    uv_fs_req_cleanup(&fs);
+    if (r <= 0) {
+      break;
+    }
+    len += (size_t)r;
+  }
+  text[len] = NUL;
+  if (r < 0 || (len >= 3 && memcmp(text, "\xef\xbb\xbf", 3) == 0)) {
+    xfree(text);
+    goto theend;
+  }
+
+  linenr_T lcount = 0;
+  for (size_t i = 0; i < len; i++) {
+    const char_u c = (char_u)text[i];
+    if (c == NUL || c == CAR) {
+      xfree(text);
+      goto theend;
+    } else if (c == NL) {
+      text[i] = NUL;
+      lcount++;
+    } else if (c >= 0x80) {
+      const int l = utf_ptr2len_len((char_u *)text + i, (int)(len - i));
+      // An illegal byte, or a sequence cut off at the end of the file.
+      if (l == 1 || (size_t)l > len - i) {
+        xfree(text);
+        goto theend;
+      }
+      i += (size_t)l - 1;
+    }
+  }
+  // A missing end-of-line still counts as a line, an empty file has one
+  // empty line.
+  if (len == 0 || text[len - 1] != NUL) {
+    lcount++;
+  }
+  file->text = text;
+  file->lcount = lcount;
+  file->plain = true;
+
+theend:
+  uv_fs_close(NULL, &fs, fd, NULL);
+  uv_fs_req_cleanup(&fs);
+}
+
+static void vgr_read_done(uv_work_t *req, int status)
+{
+  vgrfile_T *file = (vgrfile_T *)req;
+  vgrpool_T *pool = req->data;
+  if (status == UV_ECANCELED) {
+    file->plain = false;
+  }
+  file->done = true;
+  pool->pending--;
+}
+
+/// Queue the files from "fi" up to VGR_READ_AHEAD files ahead to be read by
+/// the threadpool.  Files that are loaded in a buffer are searched there.
+static void vgr_read_ahead(vgrpool_T *pool, char_u **fnames, int fi)
+{
+  for (; pool->submitted < pool->fcount
+       && pool->submitted < fi + VGR_READ_AHEAD; pool->submitted++) {
+    vgrfile_T *file = &pool->files[pool->submitted];
+    buf_T *buf = buflist_findname_exp(fnames[pool->submitted]);
+    file->done = true;
+    if (buf != NULL && buf->b_ml.ml_mfp != NULL) {
+      continue;
+    }
+    // Full path: autocommands of files that are not plain may change the
+    // directory while this file is read.
+    file->fname = FullName_save((char *)fnames[pool->submitted], false);
+    file->req.data = pool;
+
+    if (uv_queue_work(&main_loop.uv, &file->req, vgr_read_work,
+                      vgr_read_done) == 0) {
+      file->done = false;
+      pool->pending++;
+    }
+  }
+}
+
+/// Cancel reading the remaining files of "pool" and free it.
+static void vgr_pool_free(vgrpool_T *pool)
+{
+  for (int fi = 0; fi < pool->submitted; fi++) {
+    if (!pool->files[fi].done) {
+      uv_cancel((uv_req_t *)&pool->files[fi].req);
+    }
+  }
+  // Workers that already started are not cancelled, wait for them.
+  LOOP_PROCESS_EVENTS_UNTIL(&main_loop, NULL, -1, pool->pending == 0);
+  for (int fi = 0; fi < pool->fcount; fi++) {
+    xfree(pool->files[fi].fname);
+    xfree(pool->files[fi].text);
+  }
+  xfree(pool->files);
+}
+
+/// Search the lines of plain file "file" for ":vimgrep".
+///
+/// @return FAIL when adding an entry to the list failed.
+static int vgr_match_plain(qf_info_T *qi, char_u *fname, vgrfile_T *file,
+                           regmmatch_T *regmatch, int flags, long *tomatch)
+{
+  regmatch_T rm = { .regprog = regmatch->regprog, .rm_ic = regmatch->rmm_ic };
+  char_u *line = (char_u *)file->text;
+  int retval = OK;
+
+  for (linenr_T lnum = 1; lnum <= file->lcount && *tomatch > 0; lnum++) {
+    const size_t len = STRLEN(line);
+    colnr_T col = 0;
+    while (vim_regexec(&rm, line, col)) {
+      if (qf_add_entry(qi,
+                       qi->qf_curlist,
+                       NULL,            // dir
+                       fname,
+                       0,               // bufnum
+                       line,
+                       lnum,
+                       (int)(rm.startp[0] - line) + 1,
+                       false,           // vis_col
+                       NULL,            // search pattern
+                       0,               // nr
+                       0,               // type
+                       true)            // valid
+          == FAIL) {
+        retval = FAIL;
+        break;
+      }
+      if (--*tomatch == 0 || (flags & VGR_GLOBAL) == 0) {
+        break;
+      }
+      const colnr_T endcol = (colnr_T)(rm.endp[0] - line);
+      col = endcol + (col == endcol);
+      if (col > (colnr_T)len) {
+        break;
+      }
+    }
+    line += len + 1;
+    line_breakcheck();
+    if (got_int || retval == FAIL) {
+      break;
+    }
+  }
+  regmatch->regprog = rm.regprog;
+  return retval;
+}
+
 /*
  * ":vimgrep {pattern} file(s)"
  * ":vimgrepadd {pattern} file(s)"
@@ -3586,6 +3820,8 @@ void ex_vimgrep(exarg_T *eap)
   char_u      *dirname_now = NULL;
   char_u      *target_dir = NULL;
   char_u      *au_name =  NULL;
+  char_u      *pat;
+  vgrpool_T pool = { .files = NULL };
 
   switch (eap->cmdidx) {
   case CMD_vimgrep:     au_name = (char_u *)"vimgrep"; break;
@@ -3632,10 +3868,11 @@ void ex_vimgrep(exarg_T *eap)
       EMSG(_(e_noprevre));
       goto theend;
     }
-    regmatch.regprog = vim_regcomp(last_search_pat(), RE_MAGIC);
+    pat = last_search_pat();
   } else {
-    regmatch.regprog = vim_regcomp(s, RE_MAGIC);
+    pat = s;
   }
+  regmatch.regprog = vim_regcomp(pat, RE_MAGIC);
 
   if (regmatch.regprog == NULL)
     goto theend;
@@ -3674,6 +3911,13 @@ void ex_vimgrep(exarg_T *eap)
    * changing the current quickfix list. */
   cur_qf_start = qi->qf_lists[qi->qf_curlist].qf_start;
 
+  // Without autocommands for reading files, files that are not loaded are
+  // read by the libuv threadpool and searched without loading a buffer.
+  if (vgr_plain_ok(regmatch.regprog, pat)) {
+    pool.files = xcalloc((size_t)fcount, sizeof(vgrfile_T));
+    pool.fcount = fcount;
+  }
+
   seconds = (time_t)0;
   for (fi = 0; fi < fcount && !got_int && tomatch > 0; fi++) {
     fname = path_try_shorten_fname(fnames[fi]);
@@ -3696,6 +3940,30 @@ void ex_vimgrep(exarg_T *eap)
       ui_flush();
     }
 
+    if (pool.files != NULL) {
+      vgrfile_T *file = &pool.files[fi];
+      vgr_read_ahead(&pool, fnames, fi);
+      while (!file->done && !got_int) {
+        LOOP_PROCESS_EVENTS_UNTIL(&main_loop, NULL, 10, file->done);
+        os_breakcheck();
+      }
+      if (got_int) {
+        break;
+      }
+      buf = buflist_findname_exp(fnames[fi]);
+      if (file->plain && (buf == NULL || buf->b_ml.ml_mfp == NULL)) {
+        if (vgr_match_plain(qi, fname, file, &regmatch, flags, &tomatch)
+            == FAIL) {
+          got_int = true;
+        }
+        xfree(file->text);
+        file->text = NULL;
+        continue;
+      }
+      xfree(file->text);
+      file->text = NULL;
+    }
+
     buf = buflist_findname_exp(fnames[fi]);
     if (buf == NULL || buf->b_ml.ml_mfp == NULL) {
       /* Remember that a buffer with this name already exists. */
@@ -3842,6 +4110,9 @@ void ex_vimgrep(exarg_T *eap)
     }
   }
 
+  if (pool.files != NULL) {
+    vgr_pool_free(&pool);
+  }
   FreeWild(fcount, fnames);
 
   qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
@@ -92,13 +92,33 @@ typedef struct terminal_state {
 // Delay for refreshing the terminal buffer after receiving updates from
 // libvterm. Improves performance when receiving large bursts of data.
 #define REFRESH_DELAY 10
+// Scrollback rows popped by libvterm that are kept for reuse
+#define SB_SPARE_MAX 64
 
 static TimeWatcher refresh_timer;
 static bool refresh_pending = false;
 
+// Scrollback rows are stored packed: the text of the cells followed by
+// runs of cells with the same attributes. Text is one byte for ASCII
+// cells, else UTF-8 or one of the SB_* markers below. The width of a cell
+// is not stored, like libvterm it is 2 if the next cell is SB_CONT.
+#define SB_EMPTY 0x00  // empty cell
+#define SB_MULTI 0xFE  // followed by the number of chars, then the chars
+#define SB_CONT 0xFF  // second half of a double width char
+// Bytes of text used by one cell, at most
+#define SB_CELL_MAX (2 + VTERM_MAX_CHARS_PER_CELL * 6)
+
+typedef struct {
+  size_t count;
+  VTermScreenCellAttrs attrs;
+  VTermColor fg, bg;
+} ScrollbackRun;
+
 typedef struct {
   size_t cols;
-  VTermScreenCell cells[];
+  size_t alloc;  // bytes allocated for this row
+  size_t nruns;
+  ScrollbackRun runs[];  // followed by the text
 } ScrollbackLine;
 
 struct terminal {
@@ -110,9 +130,25 @@ struct terminal {
   //  - receive data from libvterm as a result of key presses.
   char textbuf[0x1fff];
 
-  ScrollbackLine **sb_buffer;       // Scrollback buffer storage for libvterm
+  // Scrollback buffer storage for libvterm, a circular buffer. Row i (0 is
+  // the most recent row) is stored at sb_buffer[(sb_start + i) % sb_size],
+  // see sb_row().
+  ScrollbackLine **sb_buffer;
+  size_t sb_start;                  // index of row 0 in sb_buffer
   size_t sb_current;                // number of rows pushed to sb_buffer
   size_t sb_size;                   // sb_buffer size
+  // Rows that were popped, reused by term_sb_push()
+  ScrollbackLine *sb_spare[SB_SPARE_MAX];
+  size_t sb_nspare;
+  size_t sb_bytes;                  // bytes allocated for rows
+  // Scratch space to pack rows, for sb_scratch_cols cells
+  ScrollbackRun *sb_runs;
+  uint8_t *sb_text;
+  size_t sb_scratch_cols;
+  // Cells of the scrollback row sb_cells_row, unpacked by fetch_cell()
+  VTermScreenCell *sb_cells;
+  size_t sb_cells_size;
+  const ScrollbackLine *sb_cells_row;
   // "virtual index" that points to the first sb_buffer row that we need to
   // push to the terminal buffer when refreshing the scrollback. When negative,
   // it actually points to entries that are no longer in sb_buffer (because the
@@ -513,9 +549,15 @@ void terminal_destroy(Terminal *term)
       pmap_del(ptr_t)(invalidated_terminals, term);
     }
     for (size_t i = 0; i < term->sb_current; i++) {
-      xfree(term->sb_buffer[i]);
+      xfree(*sb_row(term, i));
+    }
+    for (size_t i = 0; i < term->sb_nspare; i++) {
+      xfree(term->sb_spare[i]);
     }
     xfree(term->sb_buffer);
+    xfree(term->sb_runs);
+    xfree(term->sb_text);
+    xfree(term->sb_cells);
     vterm_free(term->vt);
     xfree(term);
   }
@@ -706,6 +748,143 @@ static int term_bell(void *data)
   return 1;
 }
 
+/// Slot of scrollback row i, 0 is the most recent row
+static inline ScrollbackLine **sb_row(Terminal *term, size_t i)
+{
+  assert(i < term->sb_size);
+  return &term->sb_buffer[(term->sb_start + i) % term->sb_size];
+}
+
+static bool sb_same_attrs(const ScrollbackRun *run,
+                          const VTermScreenCell *cell)
+{
+  return !memcmp(&run->attrs, &cell->attrs, sizeof(run->attrs))
+         && !memcmp(&run->fg, &cell->fg, sizeof(run->fg))
+         && !memcmp(&run->bg, &cell->bg, sizeof(run->bg));
+}
+
+/// Packs cells into a scrollback row, reusing the memory of sbrow (may be
+/// NULL) if it has the right size
+static ScrollbackLine *sb_pack(Terminal *term, ScrollbackLine *sbrow,
+                               size_t cols, const VTermScreenCell *cells)
+{
+  if (term->sb_scratch_cols < cols) {
+    term->sb_scratch_cols = cols;
+    term->sb_runs = xrealloc(term->sb_runs, cols * sizeof(ScrollbackRun));
+    term->sb_text = xrealloc(term->sb_text, cols * SB_CELL_MAX);
+  }
+
+  size_t nruns = 0;
+  size_t len = 0;
+  for (size_t i = 0; i < cols; i++) {
+    const VTermScreenCell *cell = &cells[i];
+    uint8_t *p = term->sb_text + len;
+    size_t nchars = 0;
+    while (nchars < VTERM_MAX_CHARS_PER_CELL && cell->chars[nchars]) {
+      nchars++;
+    }
+    if (!nchars) {
+      p[0] = SB_EMPTY;
+      len++;
+    } else if (cell->chars[0] == (uint32_t)-1) {
+      p[0] = SB_CONT;
+      len++;
+    } else if (nchars == 1 && cell->chars[0] < 0x80) {
+      p[0] = (uint8_t)cell->chars[0];
+      len++;
+    } else {
+      if (nchars > 1) {
+        p[0] = SB_MULTI;
+        p[1] = (uint8_t)nchars;
+        len += 2;
+      }
+      for (size_t j = 0; j < nchars; j++) {
+        len += (size_t)utf_char2bytes((int)cell->chars[j],
+                                      term->sb_text + len);
+      }
+    }
+
+    if (nruns && sb_same_attrs(&term->sb_runs[nruns - 1], cell)) {
+      term->sb_runs[nruns - 1].count++;
+    } else {
+      term->sb_runs[nruns++] = (ScrollbackRun) {
+        .count = 1, .attrs = cell->attrs, .fg = cell->fg, .bg = cell->bg
+      };
+    }
+  }
+
+  size_t size = sizeof(ScrollbackLine) + nruns * sizeof(ScrollbackRun) + len;
+  if (!sbrow || sbrow->alloc < size || sbrow->alloc / 2 > size) {
+    term->sb_bytes -= sbrow ? sbrow->alloc : 0;
+    sbrow = xrealloc(sbrow, size);
+    sbrow->alloc = size;
+    term->sb_bytes += size;
+  }
+  sbrow->cols = cols;
+  sbrow->nruns = nruns;
+  memcpy(sbrow->runs, term->sb_runs, nruns * sizeof(ScrollbackRun));
+  memcpy(&sbrow->runs[nruns], term->sb_text, len);
+  return sbrow;
+}
+
+/// Unpacks a scrollback row into term->sb_cells
+static void sb_unpack(Terminal *term, const ScrollbackLine *sbrow)
+{
+  if (term->sb_cells_row == sbrow) {
+    return;
+  }
+  if (term->sb_cells_size < sbrow->cols) {
+    term->sb_cells_size = sbrow->cols;
+    term->sb_cells = xrealloc(term->sb_cells,
+                              sbrow->cols * sizeof(VTermScreenCell));
+  }
+
+  const uint8_t *p = (const uint8_t *)&sbrow->runs[sbrow->nruns];
+  const ScrollbackRun *run = sbrow->runs;
+  size_t left = sbrow->nruns ? run->count : 0;
+  for (size_t i = 0; i < sbrow->cols; i++) {
+    VTermScreenCell *cell = &term->sb_cells[i];
+    memset(cell->chars, 0, sizeof(cell->chars));
+    if (*p == SB_EMPTY) {
+      p++;
+    } else if (*p == SB_CONT) {
+      cell->chars[0] = (uint32_t)-1;
+      p++;
+    } else if (*p < 0x80) {
+      cell->chars[0] = *p++;
+    } else {
+      size_t nchars = 1;
+      if (*p == SB_MULTI) {
+        nchars = p[1];
+        p += 2;
+      }
+      for (size_t j = 0; j < nchars; j++) {
+        cell->chars[j] = (uint32_t)utf_ptr2char(p);
+        p += utf_ptr2len(p);
+      }
+    }
+    cell->width = 1;
+    if (i && cell->chars[0] == (uint32_t)-1) {
+      term->sb_cells[i - 1].width = 2;
+    }
+
+    cell->attrs = run->attrs;
+    cell->fg = run->fg;
+    cell->bg = run->bg;
+    if (--left == 0 && run + 1 < sbrow->runs + sbrow->nruns) {
+      run++;
+      left = run->count;
+    }
+  }
+  term->sb_cells_row = sbrow;
+}
+
+/// Bytes used by the scrollback of a terminal
+size_t terminal_scrollback_bytes(const Terminal *term)
+{
+  return term->sb_bytes + term->sb_size * sizeof(ScrollbackLine *);
+}
+
 // Scrollback push handler (from pangoterm).
 static int term_sb_push(int cols, const VTermScreenCell *cells, void *data)
 {
@@ -715,34 +894,20 @@ static int term_sb_push(int cols, const VTermScreenCell *cells, void *data)
     return 0;
   }
 
-  // copy vterm cells into sb_buffer
-  size_t c = (size_t)cols;
+  // pack vterm cells into sb_buffer, recycling the oldest row or a spare
   ScrollbackLine *sbrow = NULL;
   if (term->sb_current == term->sb_size) {
-    if (term->sb_buffer[term->sb_current - 1]->cols == c) {
-      // Recycle old row if it's the right size
-      sbrow = term->sb_buffer[term->sb_current - 1];
-    } else {
-      xfree(term->sb_buffer[term->sb_current - 1]);
-    }
-
-    // Make room at the start by shifting to the right.
-    memmove(term->sb_buffer + 1, term->sb_buffer,
-        sizeof(term->sb_buffer[0]) * (term->sb_current - 1));
-
-  } else if (term->sb_current > 0) {
-    // Make room at the start by shifting to the right.
-    memmove(term->sb_buffer + 1, term->sb_buffer,
-        sizeof(term->sb_buffer[0]) * term->sb_current);
+    sbrow = *sb_row(term, term->sb_current - 1);
+  } else if (term->sb_nspare) {
+    sbrow = term->sb_spare[--term->sb_nspare];
   }
+  sbrow = sb_pack(term, sbrow, (size_t)cols, cells);
+  term->sb_cells_row = NULL;
 
-  if (!sbrow) {
-    sbrow = xmalloc(sizeof(ScrollbackLine) + c * sizeof(sbrow->cells[0]));
-    sbrow->cols = c;
-  }
-
-  // New row is added at the start of the storage buffer.
-  term->sb_buffer[0] = sbrow;
+  // New row is added at the start, if the buffer is full this is the slot
+  // of the oldest row.
+  term->sb_start = (term->sb_start + term->sb_size - 1) % term->sb_size;
+  *sb_row(term, 0) = sbrow;
   if (term->sb_current < term->sb_size) {
     term->sb_current++;
   }
@@ -751,7 +916,6 @@ static int term_sb_push(int cols, const VTermScreenCell *cells, void *data)
     term->sb_pending++;
   }
 
-  memcpy(sbrow->cells, cells, sizeof(cells[0]) * c);
   pmap_put(ptr_t)(invalidated_terminals, term, NULL);
 
   return 1;
@@ -774,11 +938,9 @@ static int term_sb_pop(int cols, VTermScreenCell *cells, void *data)
     term->sb_pending--;
   }
 
-  ScrollbackLine *sbrow = term->sb_buffer[0];
+  ScrollbackLine *sbrow = *sb_row(term, 0);
+  term->sb_start = (term->sb_start + 1) % term->sb_size;
   term->sb_current--;
-  // Forget the "popped" row by shifting the rest onto it.
-  memmove(term->sb_buffer, term->sb_buffer + 1,
-      sizeof(term->sb_buffer[0]) * (term->sb_current));
 
   size_t cols_to_copy = (size_t)cols;
   if (cols_to_copy > sbrow->cols) {
@@ -786,13 +948,20 @@ static int term_sb_pop(int cols, VTermScreenCell *cells, void *data)
   }
 
   // copy to vterm state
-  memcpy(cells, sbrow->cells, sizeof(cells[0]) * cols_to_copy);
+  sb_unpack(term, sbrow);
+  memcpy(cells, term->sb_cells, sizeof(cells[0]) * cols_to_copy);
   for (size_t col = cols_to_copy; col < (size_t)cols; col++) {
     cells[col].chars[0] = 0;
     cells[col].width = 1;
   }
 
-  xfree(sbrow);
+  term->sb_cells_row = NULL;
+  if (term->sb_nspare < SB_SPARE_MAX) {
+    term->sb_spare[term->sb_nspare++] = sbrow;
+  } else {
+    term->sb_bytes -= sbrow->alloc;
+    xfree(sbrow);
+  }
   pmap_put(ptr_t)(invalidated_terminals, term, NULL);
 
   return 1;
@@ -1058,9 +1227,10 @@ static void fetch_cell(Terminal *term, int row, int col,
     VTermScreenCell *cell)
 {
   if (row < 0) {
-    ScrollbackLine *sbrow = term->sb_buffer[-row - 1];
+    ScrollbackLine *sbrow = *sb_row(term, (size_t)(-row - 1));
     if ((size_t)col < sbrow->cols) {
-      *cell = sbrow->cells[col];
+      sb_unpack(term, sbrow);
+      *cell = term->sb_cells[col];
     } else {
       // fill the pointer with an empty cell
       *cell = (VTermScreenCell) {
@@ -1166,15 +1336,23 @@ static void on_scrollback_option_changed(Terminal *term, buf_T *buf)
     for (size_t i = 0; i < diff; i++) {
       ml_delete(1, false);
       term->sb_current--;
-      xfree(term->sb_buffer[term->sb_current]);
+      ScrollbackLine *sbrow = *sb_row(term, term->sb_current);
+      term->sb_bytes -= sbrow->alloc;
+      xfree(sbrow);
     }
+    term->sb_cells_row = NULL;
     deleted_lines(1, (long)diff);
   }
 
-  // Resize the scrollback storage.
-  size_t sb_region = sizeof(ScrollbackLine *) * scbk;
+  // Resize the scrollback storage, rows are moved to the start.
   if (scbk != term->sb_size) {
-    term->sb_buffer = xrealloc(term->sb_buffer, sb_region);
+    ScrollbackLine **sb_buffer = xmalloc(sizeof(ScrollbackLine *) * scbk);
+    for (size_t i = 0; i < term->sb_current; i++) {
+      sb_buffer[i] = *sb_row(term, i);
+    }
+    xfree(term->sb_buffer);
+    term->sb_buffer = sb_buffer;
+    term->sb_start = 0;
   }
 
   term->sb_size = scbk;
@@ -329,6 +329,143 @@ func Test_diffopt_iwhite()
   set diffopt&
 endfunc
 
+func Test_diffopt_internal()
+  for algo in ['myers', 'minimal', 'patience', 'histogram']
+    exe 'set diffopt=filler,internal,algorithm:' . algo
+
+    e one
+    call setline(1, ['one', 'two', 'three', 'four', 'five'])
+    diffthis
+    botright vert new two
+    call setline(1, ['one', 'TWO', 'three', 'five', 'six'])
+    diffthis
+
+    call assert_equal(0, diff_hlID(1, 1), algo)
+    call assert_notequal(0, diff_hlID(2, 1), algo)
+    call assert_equal(1, diff_filler(4), algo)
+    call assert_equal(hlID('DiffAdd'), diff_hlID(5, 1), algo)
+
+    " The diff is updated while editing, without :diffupdate.
+    call setline(2, 'two')
+    call assert_equal(0, diff_hlID(2, 1), algo)
+    call append(0, 'zero')
+    call assert_equal(hlID('DiffAdd'), diff_hlID(1, 1), algo)
+    call assert_equal(0, diff_hlID(3, 1), algo)
+    call assert_equal(1, diff_filler(5), algo)
+    5d
+    call assert_equal(hlID('DiffAdd'), diff_hlID(1, 1), algo)
+    call assert_equal(0, diff_filler(5), algo)
+    call assert_notequal(0, diff_hlID(5, 1), algo)
+
+    diffoff!
+    %bwipe!
+  endfor
+
+  set diffopt=internal,icase,iwhite
+  e one
+  call setline(1, ['One  two', 'three '])
+  diffthis
+  botright vert new two
+  call setline(1, ['one two', ' three'])
+  diffthis
+  call assert_equal(0, diff_hlID(1, 1))
+  call assert_notequal(0, diff_hlID(2, 1))
+
+  diffoff!
+  %bwipe!
+  set diffopt&
+endfunc
+
+" Pseudo random number in [0, n), the same on every run.
+func s:Rand(n)
+  let s:seed = (s:seed * 1103515245 + 12345) % 2147483648
+  return s:seed / 65536 % a:n
+endfunc
+
+" Highlighting and filler lines of every line in windows "one" and "two".
+func s:DiffState(one, two)
+  let state = []
+  for winid in [a:one, a:two]
+    call win_gotoid(winid)
+    let lines = map(range(1, line('$')),
+          \ '[diff_hlID(v:val, 1), diff_filler(v:val)]')
+    call add(state, add(lines, diff_filler(line('$') + 1)))
+  endfor
+  return state
+endfunc
+
+" Highlighting and filler lines of a full diff of the buffers in windows
+" "one" and "two", done in another tab page.
+func s:FullDiffState(one, two)
+  let lines = [getbufline(winbufnr(a:one), 1, '$'),
+        \ getbufline(winbufnr(a:two), 1, '$')]
+  tabnew
+  call setline(1, lines[0])
+  diffthis
+  let full_one = win_getid()
+  botright vert new
+  call setline(1, lines[1])
+  diffthis
+  let full_two = win_getid()
+  let state = s:DiffState(full_one, full_two)
+  exe 'bwipe!' winbufnr(full_one) winbufnr(full_two)
+  return state
+endfunc
+
+" Add, delete or change a few lines of the buffer in window "winid".  Added
+" lines are never equal to other lines, so that there is only one smallest
+" diff.
+func s:RandomEdit(winid)
+  call win_gotoid(a:winid)
+  let lnum = s:Rand(line('$')) + 1
+  let op = s:Rand(3)
+  if op == 0
+    let s:added += 1
+    let n = s:added
+    call append(lnum - s:Rand(2), map(range(s:Rand(3) + 1),
+          \ '"added " . n . "." . v:val'))
+  elseif op == 1 && line('$') > 3
+    exe lnum . ',' . min([lnum + s:Rand(3), line('$')]) . 'd _'
+  else
+    let s:added += 1
+    call setline(lnum, 'changed ' . s:added)
+  endif
+endfunc
+
+func Test_diffopt_internal_incremental()
+  for algo in ['myers', 'minimal', 'patience', 'histogram']
+    exe 'set diffopt=filler,internal,algorithm:' . algo
+    let s:seed = 42
+    let s:added = 0
+
+    e one
+    call setline(1, map(range(1, 100), '"line " . v:val'))
+    diffthis
+    let one = win_getid()
+    botright vert new two
+    call setline(1, map(range(1, 100), '"line " . v:val'))
+    diffthis
+    let two = win_getid()
+
+    " Edit one or both buffers, the diff is updated from the previous one.
+    for step in range(40)
+      let which = s:Rand(3)
+      if which != 1
+        call s:RandomEdit(one)
+      endif
+      if which != 0
+        call s:RandomEdit(two)
+      endif
+      call assert_equal(s:FullDiffState(one, two), s:DiffState(one, two),
+            \ algo . ' step ' . step)
+    endfor
+
+    diffoff!
+    %bwipe!
+  endfor
+  set diffopt&
+endfunc
+
 func Test_diffopt_context()
   enew!
   call setline(1, ['1', '2', '3', '4', '5', '6', '7'])
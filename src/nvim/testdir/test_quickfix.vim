@@ -2100,6 +2100,50 @@ func Test_vimgrep()
   call XvimgrepTests('l')
 endfunc
 
+func s:VimgrepItems(cmd)
+  exe a:cmd
+  return map(getqflist(), {_, e -> [bufname(e.bufnr), e.lnum, e.col, e.text]})
+endfunc
+
+" Files that are not loaded are searched without loading them into a buffer,
+" unless reading them triggers autocommands.  Check that the results are the
+" same.
+func Test_vimgrep_plain_files()
+  call writefile(['one two', 'two', '', 'three two two'], 'Xvgrplain1')
+  call writefile(["dos\r", "two\r"], 'Xvgrplain2')
+  call writefile([], 'Xvgrplain3')
+  call writefile(["caf\xe9 two"], 'Xvgrplain4')
+  " A UTF-8 sequence cut off at the end of the file
+  call writefile(["two caf\xc3"], 'Xvgrplain5', 'b')
+
+  for cmd in ['vimgrep /two/gj Xvgrplain*',
+	      \ 'vimgrep /^$/j Xvgrplain*',
+	      \ '2vimgrep /two/j Xvgrplain*',
+	      \ 'vimgrep /two\n/j Xvgrplain*',
+	      \ 'vimgrep /\%2ltwo/j Xvgrplain*']
+    let plain = s:VimgrepItems(cmd)
+    for event in ['BufReadPre', 'BufNew', 'BufUnload', 'BufWipeout']
+      augroup VimgrepPlain
+        exe 'au' event '* let g:vimgrep_event = 1'
+      augroup END
+      call assert_equal(plain, s:VimgrepItems(cmd), cmd . ' ' . event)
+      au! VimgrepPlain
+    endfor
+  endfor
+  augroup! VimgrepPlain
+
+  call assert_equal(['Xvgrplain1', 1, 5, 'one two'],
+	      \ s:VimgrepItems('vimgrep /two/j Xvgrplain1')[0])
+  call assert_equal(4, len(s:VimgrepItems('vimgrep /two/gj Xvgrplain1')))
+
+  call delete('Xvgrplain1')
+  call delete('Xvgrplain2')
+  call delete('Xvgrplain3')
+  call delete('Xvgrplain4')
+  call delete('Xvgrplain5')
+  %bwipe!
+endfunc
+
 func XfreeTests(cchar)
   call s:setup_commands(a:cchar)
 
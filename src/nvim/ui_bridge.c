@@ -8,6 +8,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <limits.h>
+#include <inttypes.h>
+#include <string.h>
 
 #include "nvim/log.h"
 #include "nvim/main.h"
@@ -16,6 +18,7 @@
 #include "nvim/memory.h"
 #include "nvim/ui_bridge.h"
 #include "nvim/ugrid.h"
+#include "nvim/os/time.h"
 #include "nvim/api/private/helpers.h"
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
@@ -26,8 +29,8 @@
 
 // Schedule a function call on the UI bridge thread.
 #define UI_BRIDGE_CALL(ui, name, argc, ...) \
-  ((UIBridgeData *)ui)->scheduler( \
-      event_create(ui_bridge_##name##_event, argc, __VA_ARGS__), UI(ui))
+  ui_bridge_push((UIBridgeData *)ui, \
+                 event_create(ui_bridge_##name##_event, argc, __VA_ARGS__))
 
 #define INT2PTR(i) ((void *)(intptr_t)i)
 #define PTR2INT(p) ((Integer)(intptr_t)p)
@@ -72,6 +75,8 @@ UI *ui_bridge_attach(UI *ui, ui_main_fn ui_main, event_scheduler scheduler)
   rv->ui_main = ui_main;
   uv_mutex_init(&rv->mutex);
   uv_cond_init(&rv->cond);
+  uv_cond_init(&rv->ring_cond);
+  rv->ring = xcalloc(UI_BRIDGE_RING_SIZE, sizeof(UIBridgeCall));
   uv_mutex_lock(&rv->mutex);
   rv->ready = false;
 
@@ -120,11 +125,82 @@ static void ui_bridge_stop(UI *b)
     loop_poll_events(&main_loop, 10);  // Process one event.
   }
   uv_thread_join(&bridge->ui_thread);
+  if (bridge->stalls) {
+    ILOG("UI thread was full %zu times, waited %" PRIu64 " ms",
+         bridge->stalls, bridge->stall_time / 1000000);
+  }
+  for (size_t i = 0; i < UI_BRIDGE_RING_SIZE; i++) {
+    xfree(bridge->ring[i].chunk);
+    xfree(bridge->ring[i].attrs);
+  }
+  xfree(bridge->ring);
   uv_mutex_destroy(&bridge->mutex);
   uv_cond_destroy(&bridge->cond);
+  uv_cond_destroy(&bridge->ring_cond);
   xfree(bridge->ui);  // Threads joined, now safe to free UI container. #7922
   xfree(b);
 }
+
+/// Returns the next free slot of the ring, waits for the UI thread if the
+/// ring is full. Not visible to the UI thread until ui_bridge_publish().
+static UIBridgeCall *ui_bridge_reserve(UIBridgeData *bridge)
+{
+  size_t tail = bridge->ring_tail;
+  if (tail - __atomic_load_n(&bridge->ring_head, __ATOMIC_ACQUIRE)
+      == UI_BRIDGE_RING_SIZE) {
+    uint64_t start = os_hrtime();
+    uv_mutex_lock(&bridge->mutex);
+    while (tail - __atomic_load_n(&bridge->ring_head, __ATOMIC_ACQUIRE)
+           == UI_BRIDGE_RING_SIZE) {
+      uv_cond_wait(&bridge->ring_cond, &bridge->mutex);
+    }
+    uv_mutex_unlock(&bridge->mutex);
+    bridge->stalls++;
+    bridge->stall_time += os_hrtime() - start;
+  }
+  return &bridge->ring[tail % UI_BRIDGE_RING_SIZE];
+}
+
+/// Makes the reserved slot visible to the UI thread, and wakes it up if
+/// it is not already going to drain the ring
+static void ui_bridge_publish(UIBridgeData *bridge)
+{
+  __atomic_store_n(&bridge->ring_tail, bridge->ring_tail + 1,
+                   __ATOMIC_SEQ_CST);
+  if (!__atomic_exchange_n(&bridge->ring_scheduled, true, __ATOMIC_SEQ_CST)) {
+    bridge->scheduler(event_create(ui_bridge_drain_event, 1, bridge),
+                      bridge->ui);
+  }
+}
+
+static void ui_bridge_push(UIBridgeData *bridge, Event event)
+{
+  ui_bridge_reserve(bridge)->event = event;
+  ui_bridge_publish(bridge);
+}
+
+/// Runs the pending UI calls in the UI thread
+static void ui_bridge_drain_event(void **argv)
+{
+  UIBridgeData *bridge = argv[0];
+  // Calls published after this schedule another drain event, so other
+  // events in the UI thread get a chance to run in between.
+  __atomic_store_n(&bridge->ring_scheduled, false, __ATOMIC_SEQ_CST);
+  size_t head = bridge->ring_head;
+  size_t tail = __atomic_load_n(&bridge->ring_tail, __ATOMIC_SEQ_CST);
+  if (head == tail) {
+    return;
+  }
+  while (head != tail) {
+    Event *event = &bridge->ring[head % UI_BRIDGE_RING_SIZE].event;
+    event->handler(event->argv);
+    __atomic_store_n(&bridge->ring_head, ++head, __ATOMIC_RELEASE);
+  }
+  uv_mutex_lock(&bridge->mutex);
+  uv_cond_signal(&bridge->ring_cond);
+  uv_mutex_unlock(&bridge->mutex);
+}
+
 static void ui_bridge_stop_event(void **argv)
 {
   UI *ui = UI(argv[0]);
@@ -153,8 +229,6 @@ static void ui_bridge_raw_line_event(void **argv)
   ui->raw_line(ui, PTR2INT(argv[1]), PTR2INT(argv[2]), PTR2INT(argv[3]),
                PTR2INT(argv[4]), PTR2INT(argv[5]), PTR2INT(argv[6]),
                PTR2INT(argv[7]), argv[8], argv[9]);
-  xfree(argv[8]);
-  xfree(argv[9]);
 }
 static void ui_bridge_raw_line(UI *ui, Integer grid, Integer row,
                                Integer startcol, Integer endcol,
@@ -162,20 +236,35 @@ static void ui_bridge_raw_line(UI *ui, Integer grid, Integer row,
                                Boolean wrap, const schar_T *chunk,
                                const sattr_T *attrs)
 {
+  // The cells are copied to buffers owned by the ring slot
+  UIBridgeData *bridge = (UIBridgeData *)ui;
+  UIBridgeCall *call = ui_bridge_reserve(bridge);
   size_t ncol = (size_t)(endcol-startcol);
-  schar_T *c = xmemdup(chunk, ncol * sizeof(schar_T));
-  sattr_T *hl = xmemdup(attrs, ncol * sizeof(sattr_T));
-  UI_BRIDGE_CALL(ui, raw_line, 10, ui, INT2PTR(grid), INT2PTR(row),
-                 INT2PTR(startcol), INT2PTR(endcol), INT2PTR(clearcol),
-                 INT2PTR(clearattr), INT2PTR(wrap), c, hl);
+  if (call->size < ncol) {
+    call->size = ncol;
+    call->chunk = xrealloc(call->chunk, call->size * sizeof(schar_T));
+    call->attrs = xrealloc(call->attrs, call->size * sizeof(sattr_T));
+  }
+  if (ncol) {
+    memcpy(call->chunk, chunk, ncol * sizeof(schar_T));
+    memcpy(call->attrs, attrs, ncol * sizeof(sattr_T));
+  }
+  call->event = event_create(ui_bridge_raw_line_event, 10, ui, INT2PTR(grid),
+                             INT2PTR(row), INT2PTR(startcol), INT2PTR(endcol),
+                             INT2PTR(clearcol), INT2PTR(clearattr),
+                             INT2PTR(wrap), call->chunk, call->attrs);
+  ui_bridge_publish(bridge);
 }
 
 static void ui_bridge_suspend(UI *b)
 {
   UIBridgeData *data = (UIBridgeData *)b;
   uv_mutex_lock(&data->mutex);
-  UI_BRIDGE_CALL(b, suspend, 1, b);
   data->ready = false;
+  uv_mutex_unlock(&data->mutex);
+  // May wait for the ring, which also needs the mutex
+  UI_BRIDGE_CALL(b, suspend, 1, b);
+  uv_mutex_lock(&data->mutex);
   // Suspend the main thread until CONTINUE is called by the UI thread.
   while (!data->ready) {
     uv_cond_wait(&data->cond, &data->mutex);
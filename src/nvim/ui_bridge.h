@@ -8,6 +8,20 @@
 #include "nvim/ui.h"
 #include "nvim/event/defs.h"
 
+/// Number of UI calls that can be pending between the main thread and the
+/// UI thread, the main thread waits when the ring is full.
+#define UI_BRIDGE_RING_SIZE 1024
+
+/// A pending UI call, slots of the ring are reused. The cells of raw_line
+/// are copied to chunk/attrs, which grow but are never freed until the
+/// bridge is stopped.
+typedef struct {
+  Event event;
+  schar_T *chunk;
+  sattr_T *attrs;
+  size_t size;  // Capacity of chunk/attrs
+} UIBridgeCall;
+
 typedef struct ui_bridge_data UIBridgeData;
 typedef void(*ui_main_fn)(UIBridgeData *bridge, UI *ui);
 struct ui_bridge_data {
@@ -27,6 +41,20 @@ struct ui_bridge_data {
   // thread finishes handling all events. This flag is set by the UI thread as a
   // signal that it will no longer send messages to the main thread.
   bool stopped;
+
+  // Single producer (main thread), single consumer (UI thread) ring of UI
+  // calls. head and tail only grow, each is written by one thread.
+  UIBridgeCall *ring;
+  size_t ring_head;  // Next call to run, written by the UI thread
+  size_t ring_tail;  // Next free slot, written by the main thread
+  // True while a ui_bridge_drain_event() is scheduled and has not started
+  bool ring_scheduled;
+  // Signaled by the UI thread when it frees slots in the ring
+  uv_cond_t ring_cond;
+  // Number of times the main thread waited for a full ring, and the time
+  // spent waiting (ns)
+  size_t stalls;
+  uint64_t stall_time;
 };
 
 #define CONTINUE(b) \
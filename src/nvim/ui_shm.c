@@ -0,0 +1,224 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check
+// it. PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+// Shared memory grid for UIs running on the same machine (the shm_path
+// option of nvim_ui_attach).
+//
+// The UI creates a file holding a ring of grid snapshots:
+//
+//   UIShmHeader (padded to UI_SHM_HEADER_SIZE)
+//   slots * (UIShmSlotHeader (padded to UI_SHM_SLOT_HEADER_SIZE)
+//            + rows * cols * UIShmCell)
+//
+// Grid lines are written to a private grid instead of being sent as
+// grid_line events. On flush the grid is copied to the next slot, and a
+// small grid_shm event tells the UI which rows changed. Other events
+// (grid_scroll, grid_clear, grid_resize, ...) are still sent as usual, the
+// UI applies them before reading the changed rows.
+//
+// Snapshots are seqlocks: gen_begin is set before the copy and gen_end
+// after it. A reader that sees different values read a snapshot that was
+// overwritten, it must then read the whole grid from a later snapshot.
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#ifndef WIN32
+# include <sys/mman.h>
+#endif
+
+#include "nvim/vim.h"
+#include "nvim/assert.h"
+#include "nvim/ui_shm.h"
+#include "nvim/memory.h"
+#include "nvim/strings.h"
+#include "nvim/api/private/helpers.h"
+#include "nvim/os/os.h"
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "ui_shm.c.generated.h"
+#endif
+
+STATIC_ASSERT(sizeof(schar_T) < UI_SHM_TEXT_BYTES,
+              "shared grid cells must hold a screen cell");
+STATIC_ASSERT(sizeof(UIShmHeader) <= UI_SHM_HEADER_SIZE,
+              "shared grid header too large");
+STATIC_ASSERT(sizeof(UIShmSlotHeader) <= UI_SHM_SLOT_HEADER_SIZE,
+              "shared grid slot header too large");
+
+static size_t slot_size(uint32_t rows, uint32_t cols)
+{
+  return UI_SHM_SLOT_HEADER_SIZE + (size_t)rows * cols * sizeof(UIShmCell);
+}
+
+/// Map the shared grid created by the UI at path
+///
+/// @return NULL on error
+UIShm *ui_shm_open(const char *path, Error *err)
+{
+#ifdef WIN32
+  api_set_error(err, kErrorTypeValidation,
+                "shm_path is not supported on this platform");
+  return NULL;
+#else
+  int fd = os_open(path, O_RDWR, 0);
+  if (fd < 0) {
+    api_set_error(err, kErrorTypeException, "Unable to open %s: %s",
+                  path, os_strerror(fd));
+    return NULL;
+  }
+
+  FileInfo info;
+  char *map = MAP_FAILED;
+  size_t size = 0;
+  if (os_fileinfo_fd(fd, &info) && info.stat.st_size >= UI_SHM_HEADER_SIZE) {
+    size = (size_t)info.stat.st_size;
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  os_close(fd);
+  if (map == MAP_FAILED) {
+    api_set_error(err, kErrorTypeException, "Unable to map %s", path);
+    return NULL;
+  }
+
+  UIShmHeader *header = (UIShmHeader *)map;
+  if (memcmp(header->magic, UI_SHM_MAGIC, sizeof(header->magic)) != 0
+      || header->text_bytes != UI_SHM_TEXT_BYTES
+      || header->rows == 0 || header->cols == 0 || header->slots == 0
+      || header->rows > INT_MAX || header->cols > INT_MAX
+      || (size - UI_SHM_HEADER_SIZE) / header->slots
+         < slot_size(header->rows, header->cols)) {
+    munmap(map, size);
+    api_set_error(err, kErrorTypeValidation, "Invalid shared grid: %s", path);
+    return NULL;
+  }
+
+  UIShm *shm = xcalloc(1, sizeof(UIShm));
+  shm->map = map;
+  shm->size = size;
+  shm->rows = header->rows;
+  shm->cols = header->cols;
+  shm->slots = header->slots;
+  shm->cells = xcalloc((size_t)shm->rows * shm->cols, sizeof(UIShmCell));
+  shm->dirty = xcalloc(shm->rows, sizeof(bool));
+  return shm;
+#endif
+}
+
+void ui_shm_close(UIShm *shm)
+{
+  if (!shm) {
+    return;
+  }
+#ifndef WIN32
+  munmap(shm->map, shm->size);
+#endif
+  xfree(shm->cells);
+  xfree(shm->dirty);
+  xfree(shm);
+}
+
+static UIShmCell *cell_at(UIShm *shm, int row, int col)
+{
+  return shm->cells + (size_t)row * shm->cols + (size_t)col;
+}
+
+/// The grid was resized. While it is larger than the shared grid,
+/// grid lines are sent as grid_line events.
+void ui_shm_resize(UIShm *shm, int width, int height)
+{
+  shm->active = width <= (int)shm->cols && height <= (int)shm->rows;
+  shm->width = width;
+  shm->height = height;
+  if (shm->active) {
+    ui_shm_clear(shm);
+    memset(shm->dirty, true, (size_t)height * sizeof(bool));
+  }
+}
+
+/// The grid was cleared, the UI does the same with grid_clear
+void ui_shm_clear(UIShm *shm)
+{
+  for (int row = 0; row < shm->height && shm->active; row++) {
+    for (int col = 0; col < shm->width; col++) {
+      UIShmCell *cell = cell_at(shm, row, col);
+      memcpy(cell->text, " ", 2);
+      cell->attr = 0;
+    }
+  }
+}
+
+/// Scroll the region [top, bot) x [left, right) by rows, as in grid_scroll.
+/// The UI scrolls its own copy, rows that were waiting to be sent move
+/// along.
+void ui_shm_scroll(UIShm *shm, int top, int bot, int left, int right,
+                   int rows)
+{
+  if (!shm->active) {
+    return;
+  }
+  size_t len = (size_t)(right - left) * sizeof(UIShmCell);
+  if (rows > 0) {
+    for (int row = top; row < bot - rows; row++) {
+      memcpy(cell_at(shm, row, left), cell_at(shm, row + rows, left), len);
+      shm->dirty[row] = shm->dirty[row] || shm->dirty[row + rows];
+    }
+  } else if (rows < 0) {
+    for (int row = bot - 1; row >= top - rows; row--) {
+      memcpy(cell_at(shm, row, left), cell_at(shm, row + rows, left), len);
+      shm->dirty[row] = shm->dirty[row] || shm->dirty[row + rows];
+    }
+  }
+}
+
+/// Write a grid line, with the same arguments as UI.raw_line
+///
+/// @return false if the line must be sent as a grid_line event instead
+bool ui_shm_raw_line(UIShm *shm, Integer row, Integer startcol,
+                     Integer endcol, Integer clearcol, Integer clearattr,
+                     const schar_T *chunk, const sattr_T *attrs)
+{
+  if (!shm->active || row < 0 || row >= shm->height || startcol < 0
+      || startcol > endcol || endcol > clearcol || clearcol > shm->width) {
+    return false;
+  }
+  for (Integer col = startcol; col < endcol; col++) {
+    UIShmCell *cell = cell_at(shm, (int)row, (int)col);
+    xstrlcpy(cell->text, (const char *)chunk[col - startcol],
+             UI_SHM_TEXT_BYTES);
+    cell->attr = attrs[col - startcol];
+  }
+  for (Integer col = endcol; col < clearcol; col++) {
+    UIShmCell *cell = cell_at(shm, (int)row, (int)col);
+    memcpy(cell->text, " ", 2);
+    cell->attr = (int32_t)clearattr;
+  }
+  shm->dirty[row] = true;
+  return true;
+}
+
+/// Copy the grid to the next snapshot
+///
+/// @param[out] slot The snapshot that was written
+/// @return The generation of the snapshot
+uint64_t ui_shm_publish(UIShm *shm, uint32_t *slot)
+{
+  uint64_t generation = ++shm->generation;
+  *slot = (uint32_t)(generation % shm->slots);
+#ifndef WIN32
+  char *base = shm->map + UI_SHM_HEADER_SIZE
+               + (size_t)*slot * slot_size(shm->rows, shm->cols);
+  UIShmSlotHeader *header = (UIShmSlotHeader *)base;
+  __atomic_store_n(&header->gen_begin, generation, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  header->rows = (uint32_t)shm->height;
+  header->cols = (uint32_t)shm->width;
+  memcpy(base + UI_SHM_SLOT_HEADER_SIZE, shm->cells,
+         (size_t)shm->height * shm->cols * sizeof(UIShmCell));
+  __atomic_store_n(&header->gen_end, generation, __ATOMIC_RELEASE);
+#endif
+  return generation;
+}
@@ -0,0 +1,53 @@
+#ifndef NVIM_UI_SHM_H
+#define NVIM_UI_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nvim/api/private/defs.h"
+#include "nvim/globals.h"
+#include "nvim/highlight_defs.h"
+
+#define UI_SHM_MAGIC "NVQTSHM1"
+#define UI_SHM_TEXT_BYTES 32
+#define UI_SHM_HEADER_SIZE 64
+#define UI_SHM_SLOT_HEADER_SIZE 32
+
+/// A grid cell in shared memory, text is NUL terminated UTF-8. The cell
+/// after a double width character has empty text.
+typedef struct {
+  char text[UI_SHM_TEXT_BYTES];
+  int32_t attr;
+} UIShmCell;
+
+/// Start of the shared memory file, written by the UI
+typedef struct {
+  char magic[8];
+  uint32_t rows, cols;  ///< Capacity of each snapshot
+  uint32_t slots;       ///< Number of snapshots in the ring
+  uint32_t text_bytes;  ///< UI_SHM_TEXT_BYTES
+} UIShmHeader;
+
+/// Start of each snapshot, written by nvim. A snapshot is complete when
+/// gen_begin == gen_end.
+typedef struct {
+  uint64_t gen_begin, gen_end;
+  uint32_t rows, cols;  ///< Grid size when the snapshot was taken
+} UIShmSlotHeader;
+
+typedef struct {
+  char *map;
+  size_t size;
+  uint32_t rows, cols, slots;
+  int width, height;  ///< Current grid size
+  bool active;        ///< False when the grid does not fit the capacity
+  uint64_t generation;
+  UIShmCell *cells;   ///< Current grid, rows*cols cells
+  bool *dirty;        ///< Rows changed since the last snapshot
+} UIShm;
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "ui_shm.h.generated.h"
+#endif
+#endif  // NVIM_UI_SHM_H
@@ -3044,6 +3044,7 @@ void free_tabpage(tabpage_T *tp)
 
   handle_unregister_tabpage(tp);
   diff_clear(tp);
+  diff_cache_free(tp);
   for (idx = 0; idx < SNAP_COUNT; ++idx)
     clear_snapshot(tp, idx);
   vars_clear(&tp->tp_vars->dv_hashtab);         /* free all t: variables */
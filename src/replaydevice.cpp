@@ -0,0 +1,145 @@
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <cstring>
+#include "replaydevice.h"
+
+namespace NeovimQt {
+
+/**
+ * \class NeovimQt::ReplayDevice
+ *
+ * \brief A QIODevice that replays a capture of Neovim output
+ *
+ * Captures are recorded with MsgpackIODevice::startCapture, use a
+ * ReplayDevice with a MsgpackIODevice to feed the recorded data to a
+ * NeovimConnector. Data written to the device is discarded.
+ *
+ * Replies are only matched to requests if the GUI sends the same
+ * requests in the same order as when the capture was recorded.
+ */
+
+ReplayDevice::ReplayDevice(const QString& path, Speed speed, QObject *parent)
+:QIODevice(parent), m_speed(speed), m_size(0), m_next(0)
+{
+	m_timer.setSingleShot(true);
+	m_timer.setTimerType(Qt::PreciseTimer);
+	connect(&m_timer, &QTimer::timeout,
+			this, &ReplayDevice::feed);
+	if (load(path)) {
+		open(QIODevice::ReadWrite);
+	}
+}
+
+/**
+ * Load a capture file, returns false if the file cannot be read or
+ * is not a capture
+ */
+bool ReplayDevice::load(const QString& path)
+{
+	QFile f(path);
+	if (!f.open(QIODevice::ReadOnly)) {
+		setErrorString(f.errorString());
+		return false;
+	}
+	if (f.read(8) != "NVQTCAP1") {
+		setErrorString(tr("Invalid capture file %1").arg(path));
+		return false;
+	}
+
+	m_chunks.clear();
+	m_size = 0;
+	QDataStream in(&f);
+	while (!in.atEnd()) {
+		quint64 time;
+		quint32 len;
+		in >> time >> len;
+		QByteArray data(len, Qt::Uninitialized);
+		if (in.readRawData(data.data(), len) != (int)len) {
+			setErrorString(tr("Truncated capture file %1").arg(path));
+			return false;
+		}
+		m_chunks.append(qMakePair(time, data));
+		m_size += len;
+	}
+	return true;
+}
+
+bool ReplayDevice::isSequential() const
+{
+	return true;
+}
+
+qint64 ReplayDevice::bytesAvailable() const
+{
+	return m_buffer.size() + QIODevice::bytesAvailable();
+}
+
+/// Total number of bytes in the capture
+qint64 ReplayDevice::size() const
+{
+	return m_size;
+}
+
+int ReplayDevice::chunkCount() const
+{
+	return m_chunks.size();
+}
+
+/// True if all recorded data was fed and read
+bool ReplayDevice::isFinished() const
+{
+	return m_next >= m_chunks.size() && m_buffer.isEmpty();
+}
+
+/// Start feeding the recorded data
+void ReplayDevice::start()
+{
+	m_next = 0;
+	m_buffer.clear();
+	m_clock.start();
+	scheduleNext();
+}
+
+void ReplayDevice::scheduleNext()
+{
+	if (m_next >= m_chunks.size()) {
+		return;
+	}
+
+	int delay = 0;
+	if (m_speed == RecordedSpeed) {
+		qint64 elapsed = m_clock.nsecsElapsed() / 1000;
+		qint64 due = m_chunks.at(m_next).first;
+		delay = qMax(qint64(0), (due - elapsed) / 1000);
+	}
+	m_timer.start(delay);
+}
+
+void ReplayDevice::feed()
+{
+	m_buffer.append(m_chunks.at(m_next).second);
+	m_next++;
+	emit readyRead();
+	if (isFinished()) {
+		emit finished();
+	} else {
+		scheduleNext();
+	}
+}
+
+qint64 ReplayDevice::readData(char *data, qint64 maxlen)
+{
+	qint64 len = qMin(maxlen, (qint64)m_buffer.size());
+	memcpy(data, m_buffer.constData(), len);
+	m_buffer.remove(0, len);
+	return len;
+}
+
+qint64 ReplayDevice::writeData(const char *data, qint64 len)
+{
+	Q_UNUSED(data);
+	return len;
+}
+
+} // Namespace NeovimQt
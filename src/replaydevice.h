@@ -0,0 +1,60 @@
+#ifndef NEOVIM_QT_REPLAYDEVICE
+#define NEOVIM_QT_REPLAYDEVICE
+
+#include <QIODevice>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPair>
+#include <QTimer>
+
+namespace NeovimQt {
+
+class ReplayDevice: public QIODevice
+{
+	Q_OBJECT
+public:
+	enum Speed {
+		/// Feed data with the recorded timing
+		RecordedSpeed,
+		/// Feed one recorded read per event loop iteration
+		MaximumSpeed,
+	};
+
+	ReplayDevice(const QString& path, Speed speed=MaximumSpeed, QObject *parent=0);
+	bool load(const QString& path);
+
+	virtual bool isSequential() const Q_DECL_OVERRIDE;
+	virtual qint64 bytesAvailable() const Q_DECL_OVERRIDE;
+	bool isFinished() const;
+	int chunkCount() const;
+	qint64 size() const Q_DECL_OVERRIDE;
+
+public slots:
+	void start();
+
+signals:
+	/// All recorded data was read
+	void finished();
+
+protected:
+	virtual qint64 readData(char *data, qint64 maxlen) Q_DECL_OVERRIDE;
+	virtual qint64 writeData(const char *data, qint64 len) Q_DECL_OVERRIDE;
+
+protected slots:
+	void feed();
+
+private:
+	void scheduleNext();
+
+	Speed m_speed;
+	/// Recorded reads, time in microseconds and data
+	QList<QPair<quint64, QByteArray> > m_chunks;
+	qint64 m_size;
+	int m_next;
+	QByteArray m_buffer;
+	QTimer m_timer;
+	QElapsedTimer m_clock;
+};
+
+} // Namespace NeovimQt
+#endif
@@ -0,0 +1,110 @@
+#include <QStringList>
+#include <algorithm>
+#include "rpcstats.h"
+
+namespace NeovimQt {
+
+/**
+ * \class NeovimQt::RpcStats
+ *
+ * \brief Per method counters for a msgpack-rpc channel
+ *
+ * Methods are notification or request names. Redraw notifications are
+ * also counted per update (e.g. "redraw:put"), responses are counted
+ * as "response". With compression, received frames are counted as "frame"
+ * (compressed size) and "frame:decoded" (message size).
+ */
+
+/// Count incoming messages for method, count can be larger than 1 for
+/// batched redraw updates
+void RpcStats::addIncoming(const QByteArray& method, quint64 count,
+		quint64 bytes, quint64 decodeTime)
+{
+	RpcMethodStats& s = m_methods[method];
+	s.countIn += count;
+	s.bytesIn += bytes;
+	s.decodeTime += decodeTime;
+}
+
+void RpcStats::addOutgoing(const QByteArray& method, quint64 count,
+		quint64 bytes)
+{
+	RpcMethodStats& s = m_methods[method];
+	s.countOut += count;
+	s.bytesOut += bytes;
+}
+
+/// Add time spent by the handler of a method
+void RpcStats::addHandlerTime(const QByteArray& method, quint64 time)
+{
+	m_methods[method].handlerTime += time;
+}
+
+void RpcStats::clear()
+{
+	m_methods.clear();
+}
+
+const QHash<QByteArray, RpcMethodStats>& RpcStats::methods() const
+{
+	return m_methods;
+}
+
+/// The counters as a map of method names to counter maps, times are
+/// converted to microseconds
+QVariantMap RpcStats::toVariant() const
+{
+	QVariantMap res;
+	QHashIterator<QByteArray, RpcMethodStats> it(m_methods);
+	while (it.hasNext()) {
+		it.next();
+		const RpcMethodStats& s = it.value();
+		QVariantMap m;
+		m.insert("count_in", s.countIn);
+		m.insert("count_out", s.countOut);
+		m.insert("bytes_in", s.bytesIn);
+		m.insert("bytes_out", s.bytesOut);
+		m.insert("decode_us", s.decodeTime/1000);
+		m.insert("handler_us", s.handlerTime/1000);
+		res.insert(QString::fromUtf8(it.key()), m);
+	}
+	return res;
+}
+
+static bool busiestFirst(const QPair<QByteArray, RpcMethodStats>& a,
+		const QPair<QByteArray, RpcMethodStats>& b)
+{
+	return a.second.bytesIn + a.second.bytesOut >
+		b.second.bytesIn + b.second.bytesOut;
+}
+
+/// A table of all counters, sorted by total bytes
+QString RpcStats::report() const
+{
+	QList<QPair<QByteArray, RpcMethodStats> > sorted;
+	QHashIterator<QByteArray, RpcMethodStats> it(m_methods);
+	while (it.hasNext()) {
+		it.next();
+		sorted.append(qMakePair(it.key(), it.value()));
+	}
+	std::sort(sorted.begin(), sorted.end(), busiestFirst);
+
+	QStringList lines;
+	lines.append(QString("%1 %2 %3 %4 %5 %6 %7")
+			.arg("method", -32)
+			.arg("in", 10).arg("out", 10)
+			.arg("bytes in", 12).arg("bytes out", 12)
+			.arg("decode ms", 10).arg("handler ms", 10));
+	for (int i=0; i<sorted.size(); i++) {
+		const RpcMethodStats& s = sorted.at(i).second;
+		lines.append(QString("%1 %2 %3 %4 %5 %6 %7")
+			.arg(QString::fromUtf8(sorted.at(i).first), -32)
+			.arg(s.countIn, 10).arg(s.countOut, 10)
+			.arg(s.bytesIn, 12).arg(s.bytesOut, 12)
+			.arg(s.decodeTime/1000000.0, 10, 'f', 2)
+			.arg(s.handlerTime/1000000.0, 10, 'f', 2));
+	}
+	return lines.join("\n");
+}
+
+} // Namespace NeovimQt
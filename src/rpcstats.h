@@ -0,0 +1,40 @@
+#ifndef NEOVIM_QT_RPCSTATS
+#define NEOVIM_QT_RPCSTATS
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVariantMap>
+
+namespace NeovimQt {
+
+/// Traffic counters for a single RPC method, times are in nanoseconds
+class RpcMethodStats {
+public:
+	RpcMethodStats()
+	:countIn(0), countOut(0), bytesIn(0), bytesOut(0),
+	decodeTime(0), handlerTime(0) {}
+	quint64 countIn, countOut;
+	quint64 bytesIn, bytesOut;
+	quint64 decodeTime, handlerTime;
+};
+
+class RpcStats
+{
+public:
+	void addIncoming(const QByteArray& method, quint64 count,
+			quint64 bytes, quint64 decodeTime);
+	void addOutgoing(const QByteArray& method, quint64 count, quint64 bytes);
+	void addHandlerTime(const QByteArray& method, quint64 time);
+	void clear();
+
+	const QHash<QByteArray, RpcMethodStats>& methods() const;
+	QVariantMap toVariant() const;
+	QString report() const;
+
+private:
+	QHash<QByteArray, RpcMethodStats> m_methods;
+};
+
+} // Namespace NeovimQt
+#endif
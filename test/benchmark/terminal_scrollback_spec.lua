@@ -0,0 +1,40 @@
+-- Test for benchmarking the terminal scrollback.
+
+local helpers = require('test.functional.helpers')(after_each)
+local clear, source, eval = helpers.clear, helpers.source, helpers.eval
+local eq, retry, iswin = helpers.eq, helpers.retry, helpers.iswin
+
+-- Streams a:lines lines through a terminal buffer, the time is stored in
+-- g:elapsed when the job exits.
+local measure_script = [[
+    func! Measure(lines)
+      let g:start = reltime()
+      enew
+      call termopen(['seq', a:lines], {'on_exit': function('Done')})
+    endfunc
+    func! Done(...)
+      let g:elapsed = reltimestr(reltime(g:start))
+    endfunc]]
+
+describe('terminal scrollback', function()
+  before_each(function()
+    clear()
+    source(measure_script)
+  end)
+
+  it('streams 1M lines with scrollback=100000', function()
+    if iswin() then
+      pending('seq is not available')
+      return
+    end
+    source([[
+      set scrollback=100000
+      call Measure(1000000)
+    ]])
+    retry(nil, 600000, function()
+      eq(1, eval('exists("g:elapsed")'))
+    end)
+    print('')
+    print('lines: 1000000, time: '..eval('g:elapsed'))
+  end)
+end)
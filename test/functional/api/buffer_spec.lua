@@ -159,6 +159,34 @@ describe('api/buf', function()
       eq(': ' .. exp_emsg, emsg:sub(-#exp_emsg - 2))
     end)
 
+    it('can set lines larger than a single read', function()
+      -- ~8MB request, received in many reads of growing size
+      local line = string.rep('x', 79)
+      local lines = {}
+      for i = 1, 100000 do
+        lines[i] = line .. i
+      end
+      set_lines(0, -1, true, lines)
+      eq(100000, line_count())
+      eq({line .. '1'}, get_lines(0, 1, true))
+      eq({line .. '100000'}, get_lines(-2, -1, true))
+    end)
+
+    it('can get lines larger than a single response block', function()
+      -- Short lines share blocks of the response, long ones get their own
+      local lines = {}
+      for i = 1, 10000 do
+        lines[i] = string.rep('x', i % 100 * 50) .. i
+      end
+      set_lines(0, -1, true, lines)
+      eq(lines, get_lines(0, -1, true))
+      eq(lines, funcs.nvim_buf_get_lines(0, 0, -1, true))
+      eq({{lines, lines}, NIL}, nvim('call_atomic', {
+        {'nvim_buf_get_lines', {0, 0, -1, true}},
+        {'nvim_buf_get_lines', {0, 0, -1, true}},
+      }))
+    end)
+
     it('has correct line_count when inserting and deleting', function()
       eq(1, line_count())
       set_lines(-1, -1, true, {'line'})
@@ -1,6 +1,9 @@
 local helpers = require('test.functional.helpers')(after_each)
 local Screen = require('test.functional.ui.screen')
 local global_helpers = require('test.helpers')
+local luv = require('luv')
+local mpack = require('mpack')
+local SocketStream = require('nvim.socket_stream')
 
 local NIL = helpers.NIL
 local clear, nvim, eq, neq = helpers.clear, helpers.nvim, helpers.eq, helpers.neq
@@ -898,6 +901,120 @@ describe('API', function()
     end)
   end)
 
+  describe('nvim_set_compression', function()
+    it('validates the codec', function()
+      expect_err('Unsupported codec: zip$', request,
+                 'nvim_set_compression', 'zip')
+      -- The channel is still usable
+      eq(2, eval('1+1'))
+    end)
+
+    -- Reference LZ4 block decoder
+    local function lz4_decompress(src)
+      local out = {}
+      local i = 1
+      local function length(len)
+        if len == 15 then
+          repeat
+            local b = src:byte(i)
+            i = i + 1
+            len = len + b
+          until b ~= 255
+        end
+        return len
+      end
+      while i <= #src do
+        local token = src:byte(i)
+        i = i + 1
+        local lits = length(math.floor(token / 16))
+        for k = 0, lits - 1 do
+          table.insert(out, src:sub(i + k, i + k))
+        end
+        i = i + lits
+        if i > #src then
+          break
+        end
+        local offset = src:byte(i) + src:byte(i + 1) * 256
+        i = i + 2
+        local mlen = length(token % 16) + 4
+        local start = #out - offset + 1
+        ok(offset > 0 and start >= 1)
+        for k = 0, mlen - 1 do
+          table.insert(out, out[start + k])
+        end
+      end
+      return table.concat(out)
+    end
+
+    local function be32(s, i)
+      local a, b, c, d = s:byte(i, i + 3)
+      return ((a * 256 + b) * 256 + c) * 256 + d
+    end
+
+    it('compresses messages after the response', function()
+      local lines = {}
+      for i = 1, 2000 do
+        table.insert(lines, ('line %d of a buffer that compresses well'):format(i))
+      end
+      meths.buf_set_lines(0, 0, -1, true, lines)
+      local pipe = helpers.new_pipename()
+      funcs.serverstart(pipe)
+
+      local data = ''
+      local stream = SocketStream.open(pipe)
+      stream:read_start(function(chunk)
+        data = data .. (chunk or '')
+      end)
+      -- Runs the loop until n bytes were received, returns them
+      local function read(n)
+        local timer = luv.new_timer()
+        timer:start(10000, 0, function() end)
+        local deadline = luv.now() + 10000
+        while #data < n and luv.now() < deadline do
+          luv.run('once')
+        end
+        timer:close()
+        ok(#data >= n)
+        local res = data:sub(1, n)
+        data = data:sub(n + 1)
+        return res
+      end
+      -- Returns the message in the next frame, and the payload size
+      local function read_frame()
+        local header = read(9)
+        eq(0xc1, header:byte(1))
+        local size, payload_size = be32(header, 2), be32(header, 6)
+        local payload = read(payload_size)
+        if payload_size == size then
+          return payload, payload_size
+        end
+        local msg = lz4_decompress(payload)
+        eq(size, #msg)
+        return msg, payload_size
+      end
+
+      stream:write(mpack.pack({0, 1, 'nvim_set_compression', {'lz4'}}))
+      -- [1, 1, nil, nil], not compressed
+      eq('\148\1\1\192\192', read(5))
+
+      stream:write(mpack.pack({0, 2, 'nvim_eval', {'1+1'}}))
+      stream:write(mpack.pack({0, 3, 'nvim_buf_get_lines', {0, 0, -1, true}}))
+
+      -- Small messages are stored as-is
+      local msg, payload_size = read_frame()
+      eq(#msg, payload_size)
+      local res = mpack.unpack(msg)
+      eq({1, 2, 2}, {res[1], res[2], res[4]})
+
+      msg, payload_size = read_frame()
+      ok(payload_size * 2 < #msg)
+      res = mpack.unpack(msg)
+      eq({1, 3}, {res[1], res[2]})
+      eq(lines, res[4])
+      stream:close()
+    end)
+  end)
+
   describe('nvim_call_atomic', function()
     it('works', function()
       meths.buf_set_lines(0, 0, -1, true, {'first'})
@@ -191,6 +191,28 @@ describe('channels', function()
     eq({"notification", "exit", {3, 0}}, next_msg())
   end)
 
+  it('reads the output of a rpc job until it exits', function()
+    source([[
+      let g:job_opts = {
+      \ 'on_exit': function('OnEvent'),
+      \ 'rpc': v:true,
+      \ }
+    ]])
+    meths.set_var("nvim_prog", nvim_prog)
+    -- The rpc stream reads into the msgpack unpacker, it has no RBuffer that
+    -- could tell how much to read when the job is torn down
+    meths.set_var("code", [[
+      let id = stdioopen({'rpc':v:true})
+      call rpcnotify(id,"nvim_call_function", "rpcnotify", [1, "message", "bye"])
+      call rpcrequest(id, "nvim_eval", "0")
+      quit
+    ]])
+    command("let id = jobstart([ g:nvim_prog, '-u', 'NONE', '-i', 'NONE', '--cmd', 'set noswapfile', '--headless', '--cmd', g:code], g:job_opts)")
+    eq({"notification", "message", {"bye"}}, next_msg())
+    eq({"notification", "exit", {3, 0}}, next_msg())
+    eq(2, eval('1+1'))
+  end)
+
   it('can use buffered output mode', function()
     if helpers.pending_win32(pending) then return end
     source([[
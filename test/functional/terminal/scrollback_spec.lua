@@ -43,6 +43,15 @@ describe('terminal scrollback', function()
       ]])
     end)
 
+    it('reports the memory used by the scrollback', function()
+      local info = nvim('get_chan_info', eval('b:terminal_job_id'))
+      -- Rows are packed, ~25 short rows take a few KB besides the array of
+      -- 'scrollback' row pointers
+      local bytes = info.scrollback_bytes
+      eq(true, bytes > 10000 * 4)
+      eq(true, bytes < 10000 * 8 + 8192)
+    end)
+
     it('will delete extra lines at the top', function()
       feed('<c-\\><c-n>gg')
       screen:expect([[
@@ -238,6 +247,107 @@ describe('terminal scrollback', function()
     end)
   end)
 
+  describe('with attributes, wide and combining characters', function()
+    if helpers.pending_win32(pending) then return end
+    before_each(function()
+      screen:set_default_attr_ids({
+        [1] = {reverse = true},   -- focused cursor
+        [2] = {background = 11},  -- unfocused cursor
+        [3] = {bold = true},
+        [11] = {foreground = 45},
+        [12] = {bold = true, background = 46},
+      })
+      thelpers.set_fg(45)
+      feed_data('colored')
+      thelpers.clear_attrs()
+      feed_data(' 日本語 ')
+      thelpers.set_bold()
+      thelpers.set_bg(46)
+      feed_data('bold')
+      thelpers.clear_attrs()
+      feed_data({' e\204\129x', 'line1', 'line2', 'line3', ''})
+      screen:expect([[
+        tty ready                     |
+        {11:colored} 日本語 {12:bold} éx        |
+        line1                         |
+        line2                         |
+        line3                         |
+        {1: }                             |
+        {3:-- TERMINAL --}                |
+      ]])
+    end)
+
+    it('keeps them when rows go to the scrollback and back', function()
+      screen:try_resize(screen._width, screen._height - 3)
+      screen:expect([[
+        line3                         |
+        rows: 3, cols: 30             |
+        {1: }                             |
+        {3:-- TERMINAL --}                |
+      ]])
+
+      -- The rows are popped from the scrollback, "tty ready" is pushed back
+      screen:try_resize(screen._width, screen._height + 4)
+      screen:expect([[
+        {11:colored} 日本語 {12:bold} éx        |
+        line1                         |
+        line2                         |
+        line3                         |
+        rows: 3, cols: 30             |
+        rows: 7, cols: 30             |
+        {1: }                             |
+        {3:-- TERMINAL --}                |
+      ]])
+
+      feed('<c-\\><c-n>gg')
+      screen:expect([[
+        ^tty ready                     |
+        {11:colored} 日本語 {12:bold} éx        |
+        line1                         |
+        line2                         |
+        line3                         |
+        rows: 3, cols: 30             |
+        rows: 7, cols: 30             |
+                                      |
+      ]])
+      feed('G')
+      screen:expect([[
+        {11:colored} 日本語 {12:bold} éx        |
+        line1                         |
+        line2                         |
+        line3                         |
+        rows: 3, cols: 30             |
+        rows: 7, cols: 30             |
+        ^{2: }                             |
+                                      |
+      ]])
+
+      -- Push the row to the scrollback again and refresh from there
+      feed('i')
+      screen:try_resize(screen._width, screen._height - 4)
+      screen:expect([[
+        rows: 7, cols: 30             |
+        rows: 3, cols: 30             |
+        {1: }                             |
+        {3:-- TERMINAL --}                |
+      ]])
+      feed('<c-\\><c-n>gg')
+      screen:expect([[
+        ^tty ready                     |
+        {11:colored} 日本語 {12:bold} éx        |
+        line1                         |
+                                      |
+      ]])
+      feed('G')
+      screen:expect([[
+        rows: 7, cols: 30             |
+        rows: 3, cols: 30             |
+        ^{2: }                             |
+                                      |
+      ]])
+    end)
+  end)
+
   describe('with 4 lines hidden in the scrollback', function()
     before_each(function()
       feed_data({'line1', 'line2', 'line3', 'line4', ''})
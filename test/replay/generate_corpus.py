@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Generate the replay corpus used by tst_replay.
+
+Each capture holds the data a Neovim instance sends to the GUI, in the
+format written by MsgpackIODevice::startCapture (NVIM_QT_CAPTURE). The
+streams are synthetic but follow the same sequence as a real session:
+
+  1. the vim_get_api_info response (msgid 0)
+  2. the ui_attach response (msgid 1) and vim_subscribe response (msgid 2)
+  3. redraw notifications, one per recorded read
+
+Real captures can be added next to these, as long as they were recorded
+with a GUI that sends the same requests in the same order.
+"""
+
+import os
+import struct
+
+MAGIC = b'NVQTCAP1'
+ROWS, COLS = 40, 100
+
+
+def pack(obj):
+    """Minimal msgpack encoder for the types used in redraw updates"""
+    if obj is None:
+        return b'\xc0'
+    if obj is True:
+        return b'\xc3'
+    if obj is False:
+        return b'\xc2'
+    if isinstance(obj, int):
+        if 0 <= obj < 128:
+            return struct.pack('B', obj)
+        if -32 <= obj < 0:
+            return struct.pack('b', obj)
+        if 0 <= obj <= 0xff:
+            return b'\xcc' + struct.pack('>B', obj)
+        if 0 <= obj <= 0xffff:
+            return b'\xcd' + struct.pack('>H', obj)
+        if 0 <= obj <= 0xffffffff:
+            return b'\xce' + struct.pack('>I', obj)
+        return b'\xd3' + struct.pack('>q', obj)
+    if isinstance(obj, str):
+        data = obj.encode('utf-8')
+        n = len(data)
+        if n < 32:
+            return struct.pack('B', 0xa0 | n) + data
+        if n < 256:
+            return b'\xd9' + struct.pack('>B', n) + data
+        return b'\xda' + struct.pack('>H', n) + data
+    if isinstance(obj, (list, tuple)):
+        n = len(obj)
+        head = struct.pack('B', 0x90 | n) if n < 16 else b'\xdc' + struct.pack('>H', n)
+        return head + b''.join(pack(o) for o in obj)
+    if isinstance(obj, dict):
+        n = len(obj)
+        head = struct.pack('B', 0x80 | n) if n < 16 else b'\xde' + struct.pack('>H', n)
+        return head + b''.join(pack(k) + pack(v) for k, v in obj.items())
+    raise TypeError(obj)
+
+
+def response(msgid, result):
+    return pack([1, msgid, None, result])
+
+
+def redraw(*updates):
+    return pack([2, 'redraw', list(updates)])
+
+
+class Capture:
+    def __init__(self):
+        self.time = 0
+        self.chunks = []
+
+    def add(self, data, delay_us):
+        self.time += delay_us
+        self.chunks.append((self.time, data))
+
+    def write(self, path):
+        with open(path, 'wb') as f:
+            f.write(MAGIC)
+            for time, data in self.chunks:
+                f.write(struct.pack('>QI', time, len(data)))
+                f.write(data)
+
+
+def start(cap):
+    metadata = {'version': {'api_compatible': 0, 'api_level': 1}}
+    cap.add(response(0, [1, metadata]), 5000)
+    cap.add(response(1, None) + response(2, None), 5000)
+    cap.add(redraw(['resize', [COLS, ROWS]],
+                   ['update_fg', [0xd0d0d0]], ['update_bg', [0x1c1c1c]],
+                   ['clear', []]), 5000)
+
+
+def put_line(row, text, hl):
+    """cursor_goto + highlight_set + put, the way the legacy protocol sends
+    a line: one put argument per cell"""
+    return [['cursor_goto', [row, 0]],
+            ['highlight_set', [hl]],
+            ['put'] + [[c] for c in text.ljust(COLS)[:COLS]]]
+
+
+C_LINES = [
+    '#include <stdio.h>',
+    '',
+    '/// Compute the sum of the first n elements of values',
+    'static long sum(const int *values, size_t n)',
+    '{',
+    '  long total = 0;',
+    '  for (size_t i = 0; i < n; i++) {',
+    '    total += values[i];',
+    '  }',
+    '  return total;',
+    '}',
+    '',
+]
+HL_NORMAL = {'foreground': 0xd0d0d0}
+HL_COMMENT = {'foreground': 0x808080, 'italic': True}
+HL_KEYWORD = {'foreground': 0x5f87d7, 'bold': True}
+
+
+def c_line(n):
+    text = C_LINES[n % len(C_LINES)]
+    hl = HL_COMMENT if text.startswith('///') else \
+        HL_KEYWORD if text.startswith(('#', 'static')) else HL_NORMAL
+    return '%5d %s' % (n + 1, text), hl
+
+
+def scroll_c_file(path):
+    """Scrolling through a large C file with <C-e>"""
+    cap = Capture()
+    start(cap)
+    updates = []
+    for row in range(ROWS - 1):
+        text, hl = c_line(row)
+        updates += put_line(row, text, hl)
+    cap.add(redraw(*updates), 16000)
+
+    for n in range(ROWS - 1, ROWS - 1 + 400):
+        text, hl = c_line(n)
+        updates = [['set_scroll_region', [0, ROWS - 2, 0, COLS - 1]],
+                   ['scroll', [1]],
+                   ['set_scroll_region', [0, ROWS - 1, 0, COLS - 1]]]
+        updates += put_line(ROWS - 2, text, hl)
+        updates += [['highlight_set', [{}]],
+                    ['cursor_goto', [ROWS - 1, 0]],
+                    ['put'] + [[c] for c in ('%d,1' % (n + 1)).ljust(20)],
+                    ['cursor_goto', [0, 6]]]
+        cap.add(redraw(*updates), 8000)
+    cap.write(path)
+
+
+def terminal_spew(path):
+    """:terminal running a command that prints many lines quickly"""
+    cap = Capture()
+    start(cap)
+    for n in range(600):
+        text = '[%06d] building object file src/nvim/module_%d.c.o' % (n, n % 97)
+        updates = [['set_scroll_region', [0, ROWS - 2, 0, COLS - 1]],
+                   ['scroll', [1]],
+                   ['set_scroll_region', [0, ROWS - 1, 0, COLS - 1]]]
+        updates += put_line(ROWS - 2, text, HL_NORMAL)
+        updates += [['cursor_goto', [ROWS - 2, len(text)]]]
+        cap.add(redraw(*updates), 500)
+    cap.write(path)
+
+
+def completion_popup(path):
+    """Insert mode completion, typing narrows the popup menu"""
+    cap = Capture()
+    start(cap)
+    updates = []
+    for row in range(ROWS - 1):
+        text, hl = c_line(row)
+        updates += put_line(row, text, hl)
+    cap.add(redraw(['mode_change', ['insert', 1]], *updates), 16000)
+
+    words = ['values_%d' % i for i in range(200)]
+    for n in range(150):
+        prefix = 'values_%d' % (n % 20)
+        items = [[w, 'v', 'int', ''] for w in words if w.startswith(prefix)]
+        row = 10 + n % 20
+        cap.add(redraw(['cursor_goto', [row, 10]],
+                       ['put'] + [[c] for c in prefix],
+                       ['popupmenu_show', [items, -1, row, 10]]), 20000)
+        for sel in range(min(len(items), 5)):
+            cap.add(redraw(['popupmenu_select', [sel]]), 5000)
+        cap.add(redraw(['popupmenu_hide', []]), 5000)
+    cap.write(path)
+
+
+if __name__ == '__main__':
+    here = os.path.dirname(os.path.abspath(__file__))
+    scroll_c_file(os.path.join(here, 'scroll_c_file.capture'))
+    terminal_spew(os.path.join(here, 'terminal_spew.capture'))
+    completion_popup(os.path.join(here, 'completion_popup.capture'))
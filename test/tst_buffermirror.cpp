@@ -0,0 +1,189 @@
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <gui/buffermirror.h>
+
+namespace NeovimQt {
+
+class TestBufferMirror: public QObject
+{
+	Q_OBJECT
+private slots:
+	void ropeReplace();
+	void ropeLargeBuffer();
+	void ropeCopy();
+	void linesEvent();
+	void linesEventAttached();
+private:
+	static QVariantList event(qint64 buffer, const QVariant& tick,
+			int first, int last, const QList<QByteArray>& lines) {
+		QVariantList l;
+		foreach(const QByteArray& line, lines) {
+			l.append(line);
+		}
+		return QVariantList() << buffer << tick << first << last
+			<< QVariant(l) << false;
+	}
+	static QList<QByteArray> lines(int first, int count) {
+		QList<QByteArray> l;
+		for (int i=first; i<first+count; i++) {
+			l.append(QByteArray::number(i));
+		}
+		return l;
+	}
+	static QList<QByteArray> contents(const LineRope& rope) {
+		QList<QByteArray> l;
+		for (int i=0; i<rope.size(); i++) {
+			l.append(rope.line(i));
+		}
+		return l;
+	}
+};
+
+void TestBufferMirror::ropeReplace()
+{
+	LineRope rope;
+	rope.replace(0, 0, lines(0, 5));
+	QCOMPARE(contents(rope), lines(0, 5));
+
+	// Change line 2
+	rope.replace(2, 3, QList<QByteArray>() << "x");
+	QCOMPARE(rope.line(2), QByteArray("x"));
+	QCOMPARE(rope.size(), 5);
+
+	// Delete lines 1-2
+	rope.replace(1, 3, QList<QByteArray>());
+	QCOMPARE(contents(rope), QList<QByteArray>() << "0" << "3" << "4");
+
+	// Insert at the end
+	rope.replace(3, 3, QList<QByteArray>() << "5");
+	QCOMPARE(contents(rope), QList<QByteArray>() << "0" << "3" << "4" << "5");
+	QCOMPARE(rope.line(10), QByteArray());
+}
+
+void TestBufferMirror::ropeLargeBuffer()
+{
+	LineRope rope;
+	rope.replace(0, 0, lines(0, 200000));
+	QCOMPARE(rope.size(), 200000);
+	QCOMPARE(rope.line(123456), QByteArray("123456"));
+
+	// Edits across chunk boundaries
+	rope.replace(1000, 5000, lines(0, 10));
+	QCOMPARE(rope.size(), 196010);
+	QCOMPARE(rope.line(999), QByteArray("999"));
+	QCOMPARE(rope.line(1000), QByteArray("0"));
+	QCOMPARE(rope.line(1010), QByteArray("5000"));
+	rope.replace(500, 500, lines(0, 5000));
+	QCOMPARE(rope.size(), 201010);
+	QCOMPARE(rope.line(5500), QByteArray("500"));
+}
+
+void TestBufferMirror::ropeCopy()
+{
+	LineRope rope;
+	rope.replace(0, 0, lines(0, 3000));
+	LineRope copy = rope;
+	rope.replace(0, 3000, QList<QByteArray>());
+	QCOMPARE(rope.size(), 0);
+	QCOMPARE(contents(copy), lines(0, 3000));
+}
+
+void TestBufferMirror::linesEvent()
+{
+	BufferMirror mirror(NULL);
+	// Without a connection nothing is attached, events are ignored
+	QVariantList args;
+	args << 1 << 2 << 0 << -1 << QVariant(QVariantList() << "a") << false;
+	mirror.handleNeovimNotification("nvim_buf_lines_event", args);
+	QCOMPARE(mirror.lines(1).size(), 0);
+	QVERIFY(!mirror.isAttached(1));
+	QCOMPARE(mirror.changedtick(1), qint64(-1));
+}
+
+void TestBufferMirror::linesEventAttached()
+{
+	// Requests are written to the buffer, Neovim never answers them
+	QBuffer *io = new QBuffer();
+	io->open(QIODevice::ReadWrite);
+	NeovimConnector c(io);
+	BufferMirror mirror(&c);
+	QSignalSpy changed(&mirror, SIGNAL(linesChanged(qint64, int, int, int)));
+	QVERIFY(changed.isValid());
+
+	mirror.attach(1);
+	QVERIFY(mirror.isAttached(1));
+	QCOMPARE(mirror.changedtick(1), qint64(-1));
+
+	// Initial contents, lastline is -1
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, 2, 0, -1, lines(0, 5)));
+	QCOMPARE(contents(mirror.lines(1)), lines(0, 5));
+	QCOMPARE(mirror.changedtick(1), qint64(2));
+
+	// Insert before line 2
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, 3, 2, 2, QList<QByteArray>() << "x"));
+	QCOMPARE(contents(mirror.lines(1)), QList<QByteArray>()
+			<< "0" << "1" << "x" << "2" << "3" << "4");
+	QCOMPARE(mirror.changedtick(1), qint64(3));
+	QCOMPARE(changed.last(), QVariantList() << qint64(1) << 2 << 2 << 1);
+
+	// Replace lines 1-2
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, 4, 1, 3, QList<QByteArray>() << "y"));
+	QCOMPARE(contents(mirror.lines(1)), QList<QByteArray>()
+			<< "0" << "y" << "2" << "3" << "4");
+	QCOMPARE(mirror.changedtick(1), qint64(4));
+
+	// Delete lines 0-1
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, 5, 0, 2, QList<QByteArray>()));
+	QCOMPARE(contents(mirror.lines(1)), lines(2, 3));
+	QCOMPARE(mirror.changedtick(1), qint64(5));
+	QCOMPARE(changed.last(), QVariantList() << qint64(1) << 0 << 2 << 0);
+
+	// A nil changedtick keeps the previous one
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, QVariant(), 3, 3, QList<QByteArray>() << "5"));
+	QCOMPARE(contents(mirror.lines(1)), lines(2, 4));
+	QCOMPARE(mirror.changedtick(1), qint64(5));
+
+	// lastline -1 replaces up to the end of the buffer
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, 6, 2, -1, QList<QByteArray>() << "z"));
+	QCOMPARE(contents(mirror.lines(1)), QList<QByteArray>()
+			<< "2" << "3" << "z");
+	QCOMPARE(mirror.changedtick(1), qint64(6));
+
+	// Out of range lines are clamped to the end of the buffer
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(1, 7, 10, 20, QList<QByteArray>() << "w"));
+	QCOMPARE(contents(mirror.lines(1)), QList<QByteArray>()
+			<< "2" << "3" << "z" << "w");
+	QCOMPARE(mirror.changedtick(1), qint64(7));
+
+	mirror.handleNeovimNotification("nvim_buf_changedtick_event",
+			QVariantList() << 1 << 8);
+	QCOMPARE(mirror.changedtick(1), qint64(8));
+
+	// Events for other buffers are ignored
+	int count = changed.count();
+	mirror.handleNeovimNotification("nvim_buf_lines_event",
+			event(2, 9, 0, -1, lines(0, 2)));
+	QCOMPARE(changed.count(), count);
+	QVERIFY(!mirror.isAttached(2));
+	QCOMPARE(mirror.lines(1).size(), 4);
+
+	QSignalSpy detached(&mirror, SIGNAL(detached(qint64)));
+	QVERIFY(detached.isValid());
+	mirror.handleNeovimNotification("nvim_buf_detach_event",
+			QVariantList() << 1);
+	QCOMPARE(detached.count(), 1);
+	QVERIFY(!mirror.isAttached(1));
+	QCOMPARE(mirror.changedtick(1), qint64(-1));
+}
+
+} // Namespace NeovimQt
+
+QTEST_GUILESS_MAIN(NeovimQt::TestBufferMirror)
+#include "tst_buffermirror.moc"
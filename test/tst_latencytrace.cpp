@@ -0,0 +1,92 @@
+#include <QtTest/QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <latencytrace.h>
+
+using NeovimQt::LatencyTrace;
+
+class TestLatencyTrace: public QObject
+{
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+	void disabled();
+	void correlate();
+	void sharedRedraw();
+	void chromeTrace();
+private:
+	void markAll(qint64 start);
+};
+
+void TestLatencyTrace::init()
+{
+	LatencyTrace::clear();
+	LatencyTrace::setEnabled(true);
+}
+
+void TestLatencyTrace::cleanup()
+{
+	LatencyTrace::setEnabled(false);
+	LatencyTrace::clear();
+}
+
+void TestLatencyTrace::markAll(qint64 start)
+{
+	LatencyTrace::mark(LatencyTrace::RpcWrite, start+1000);
+	LatencyTrace::mark(LatencyTrace::RedrawRead, start+2000);
+	LatencyTrace::mark(LatencyTrace::FlushApplied, start+3000);
+	LatencyTrace::mark(LatencyTrace::PaintEnd, start+4000);
+}
+
+void TestLatencyTrace::disabled()
+{
+	LatencyTrace::setEnabled(false);
+	LatencyTrace::input("a");
+	markAll(LatencyTrace::now());
+	QVERIFY(LatencyTrace::report().startsWith("0 inputs"));
+}
+
+/// Tracepoints out of order are not assigned to the input
+void TestLatencyTrace::correlate()
+{
+	LatencyTrace::input("a");
+	qint64 start = LatencyTrace::now();
+	LatencyTrace::mark(LatencyTrace::PaintEnd, start+100);
+	LatencyTrace::mark(LatencyTrace::FlushApplied, start+100);
+	QVERIFY(LatencyTrace::report().startsWith("0 inputs"));
+
+	markAll(start);
+	QVERIFY(LatencyTrace::report().startsWith("1 inputs"));
+}
+
+/// Two inputs handled by a single redraw
+void TestLatencyTrace::sharedRedraw()
+{
+	LatencyTrace::input("a");
+	LatencyTrace::mark(LatencyTrace::RpcWrite);
+	LatencyTrace::input("b");
+	markAll(LatencyTrace::now());
+	QVERIFY(LatencyTrace::report().startsWith("2 inputs"));
+}
+
+void TestLatencyTrace::chromeTrace()
+{
+	LatencyTrace::input("a");
+	markAll(LatencyTrace::now());
+
+	QJsonDocument doc = QJsonDocument::fromJson(LatencyTrace::chromeTrace());
+	QVERIFY(doc.isObject());
+	QJsonArray events = doc.object().value("traceEvents").toArray();
+	// One event for the input plus one per stage
+	QCOMPARE(events.size(), 1 + LatencyTrace::PaintEnd);
+	QCOMPARE(events.at(0).toObject().value("name").toString(), QString("a"));
+	foreach(const QJsonValue& ev, events) {
+		QCOMPARE(ev.toObject().value("ph").toString(), QString("X"));
+		QVERIFY(ev.toObject().value("dur").toDouble() >= 0);
+	}
+}
+
+QTEST_MAIN(TestLatencyTrace)
+#include "tst_latencytrace.moc"
@@ -4,9 +4,11 @@
 #include <QTcpSocket>
 #include <QRegularExpression>
 #include <QBuffer>
+#include <QDataStream>
 
 #include <msgpackiodevice.h>
 #include <msgpackrequest.h>
+#include <framedecoder.h>
 #include "common.h"
 
 namespace NeovimQt {
@@ -35,6 +37,44 @@ class Test: public QObject
 	Q_OBJECT
 private:
 	MsgpackIODevice *one, *two;
+	QTcpSocket *oneSocket;
+
+	/// A frame with msg as an uncompressed LZ4 block, i.e. literals only
+	static QByteArray lz4Frame(const QByteArray& msg) {
+		QByteArray block;
+		int len = msg.size();
+		block.append(char((len >= 15 ? 15 : len) << 4));
+		if (len >= 15) {
+			for (len -= 15; len >= 255; len -= 255) {
+				block.append(char(255));
+			}
+			block.append(char(len));
+		}
+		block.append(msg);
+		return frame(msg.size(), block);
+	}
+	static QByteArray frame(quint32 size, const QByteArray& payload) {
+		QByteArray f;
+		QDataStream out(&f, QIODevice::WriteOnly);
+		out << (quint8)0xc1 << size << (quint32)payload.size();
+		return f + payload;
+	}
+	static QByteArray notification(const QByteArray& method, int arg) {
+		msgpack_sbuffer sbuf;
+		msgpack_sbuffer_init(&sbuf);
+		msgpack_packer pk;
+		msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+		msgpack_pack_array(&pk, 3);
+		msgpack_pack_int(&pk, 2);
+		msgpack_pack_bin(&pk, method.size());
+		msgpack_pack_bin_body(&pk, method.constData(), method.size());
+		msgpack_pack_array(&pk, 1);
+		msgpack_pack_int(&pk, arg);
+		QByteArray res(sbuf.data, sbuf.size);
+		msgpack_sbuffer_destroy(&sbuf);
+		return res;
+	}
+
 	void resetLoop() {
 		QTcpServer *server = new QTcpServer();
 		QVERIFY(server->listen(QHostAddress::LocalHost));
@@ -53,6 +93,7 @@ private:
 
 		QTcpSocket *other = server->nextPendingConnection();
 
+		oneSocket = client;
 		one = new MsgpackIODevice(client);
 		two = new MsgpackIODevice(other);
 		QVERIFY(one->isOpen());
@@ -173,6 +214,84 @@ private slots:
 		QVERIFY2(SPYWAIT(gotResp2), "RequestHandler sends back a response");
 	}
 
+	void stats() {
+		QVariantList put;
+		put << QByteArray("put") << QVariant(QVariantList() << QByteArray("a"))
+			<< QVariant(QVariantList() << QByteArray("b"));
+		QVariantList cursor;
+		cursor << QByteArray("cursor_goto") << QVariant(QVariantList() << 1 << 2);
+		QVariantList params;
+		params << QVariant(put) << QVariant(cursor);
+
+		QSignalSpy onNotification(two, SIGNAL(notification(QByteArray, QVariantList)));
+		QVERIFY(onNotification.isValid());
+		one->sendNotification("redraw", params);
+		QVERIFY(SPYWAIT(onNotification));
+		QCOMPARE(onNotification.at(0).at(1).toList(), params);
+
+		const RpcMethodStats& out = one->stats().methods().value("redraw");
+		QCOMPARE(out.countOut, (quint64)1);
+
+		const QHash<QByteArray, RpcMethodStats>& in = two->stats().methods();
+		QCOMPARE(in.value("redraw").countIn, (quint64)1);
+		QCOMPARE(in.value("redraw").bytesIn, out.bytesOut);
+		// Updates are counted per call
+		QCOMPARE(in.value("redraw:put").countIn, (quint64)2);
+		QCOMPARE(in.value("redraw:cursor_goto").countIn, (quint64)1);
+		QVERIFY(in.value("redraw:put").bytesIn > 0);
+		QVERIFY(in.value("redraw:put").bytesIn < out.bytesOut);
+	}
+
+	void lz4Decompress() {
+		// "abc", then a 9 byte match at offset 3, then "xyz"
+		const char block[] = "\x35" "abc" "\x03\x00" "\x30" "xyz";
+		char out[15];
+		QVERIFY(FrameDecoder::lz4Decompress(block, sizeof(block)-1, out, sizeof(out)));
+		QCOMPARE(QByteArray(out, sizeof(out)), QByteArray("abcabcabcabcxyz"));
+
+		// Wrong size
+		QVERIFY(!FrameDecoder::lz4Decompress(block, sizeof(block)-1, out, 14));
+		// Match before the start of the output
+		const char invalid[] = "\x15" "a" "\x04\x00";
+		QVERIFY(!FrameDecoder::lz4Decompress(invalid, sizeof(invalid)-1, out, 10));
+	}
+
+	void compressedFrames() {
+		RequestHandler *handler = new RequestHandler(one);
+		one->setRequestHandler(handler);
+		QSignalSpy gotReq(handler, SIGNAL(receivedRequest(quint32, QByteArray, QVariantList)));
+		QVERIFY(gotReq.isValid());
+		QSignalSpy onNotification(two, SIGNAL(notification(QByteArray, QVariantList)));
+		QVERIFY(onNotification.isValid());
+
+		two->requestCompression();
+		QVERIFY(SPYWAIT(gotReq));
+		QCOMPARE(gotReq.at(0).at(1).toByteArray(), QByteArray("nvim_set_compression"));
+
+		// The response was sent uncompressed, everything after it is framed
+		QByteArray stored = notification("stored", 1);
+		QByteArray compressed = notification(QByteArray(40, 'x'), 2);
+		QByteArray data = frame(stored.size(), stored) + lz4Frame(compressed);
+		// Split a frame across reads
+		oneSocket->write(data.left(data.size() - 5));
+		oneSocket->flush();
+		QVERIFY(SPYWAIT(onNotification));
+		oneSocket->write(data.right(5));
+		while (onNotification.count() < 2) {
+			QVERIFY(SPYWAIT(onNotification));
+		}
+		QVERIFY(two->isCompressed());
+		QCOMPARE(onNotification.at(0).at(0).toByteArray(), QByteArray("stored"));
+		QCOMPARE(onNotification.at(1).at(0).toByteArray(), QByteArray(40, 'x'));
+		QCOMPARE(onNotification.at(1).at(1).toList().at(0).toInt(), 2);
+
+		const QHash<QByteArray, RpcMethodStats>& in = two->stats().methods();
+		QCOMPARE(in.value("frame").countIn, (quint64)2);
+		QCOMPARE(in.value("frame").bytesIn, (quint64)data.size());
+		QCOMPARE(in.value("frame:decoded").bytesIn,
+				(quint64)(stored.size() + compressed.size()));
+	}
+
 	void checkVariant()
 	{
 		// Some Unsupported types
@@ -0,0 +1,68 @@
+#include <QtTest/QtTest>
+#include <QFontDatabase>
+#include <gui/shell.h>
+#include <replaydevice.h>
+#include "common.h"
+
+#if defined(Q_OS_WIN) && defined(USE_STATIC_QT)
+#include <QtPlugin>
+Q_IMPORT_PLUGIN (QWindowsIntegrationPlugin);
+#endif
+
+namespace NeovimQt {
+
+/// Replays the captures in test/replay into a Shell, without a running
+/// Neovim. The benchmark covers decoding, applying redraw updates and
+/// painting, use QT_QPA_PLATFORM=offscreen for stable results.
+class Test: public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase() {
+		QStringList fonts;
+		fonts << "third-party/DejaVuSansMono.ttf"
+			<< "third-party/DejaVuSansMono-Bold.ttf"
+			<< "third-party/DejaVuSansMono-BoldOblique.ttf";
+		foreach(QString path, fonts) {
+			QFontDatabase::addApplicationFont(path);
+		}
+	}
+
+	void benchReplay_data() {
+		QTest::addColumn<QString>("capture");
+		QDir dir("test/replay");
+		QVERIFY2(dir.exists(), "Unable to find the replay corpus");
+		foreach(const QString& name, dir.entryList(QStringList() << "*.capture")) {
+			QTest::newRow(name.toUtf8().constData()) << dir.filePath(name);
+		}
+	}
+
+	void benchReplay() {
+		QFETCH(QString, capture);
+		qint64 bytes = 0;
+		QBENCHMARK {
+			ReplayDevice *dev = new ReplayDevice(capture, ReplayDevice::MaximumSpeed);
+			QVERIFY2(dev->isOpen(), qPrintable(dev->errorString()));
+			bytes = dev->size();
+
+			NeovimConnector *c = new NeovimConnector(dev);
+			Shell *s = new Shell(c, ShellOptions());
+			s->show();
+			QSignalSpy onFinished(dev, SIGNAL(finished()));
+			QVERIFY(onFinished.isValid());
+			dev->start();
+			QVERIFY(SPYWAIT2(onFinished, 60000));
+			QVERIFY(s->neovimAttached());
+			// Paint the last frame
+			s->repaint();
+
+			delete s;
+			c->deleteLater();
+		}
+		qDebug() << capture << bytes << "bytes";
+	}
+};
+
+} // Namespace NeovimQt
+QTEST_MAIN(NeovimQt::Test)
+#include "tst_replay.moc"
@@ -146,7 +146,7 @@ protected:
 			});
 
 		QStringList vars = {"GuiWindowId", "GuiWindowMaximized",
-			"GuiWindowFullScreen", "GuiFont"};
+			"GuiWindowFullScreen", "GuiFont", "GuiChannel"};
 		foreach(const QString& var, vars) {
 			qDebug() << "Checking Neovim for Gui var" << var;
 			QSignalSpy onVar(nvim, SIGNAL(on_vim_get_var(QVariant)));
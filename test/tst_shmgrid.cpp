@@ -0,0 +1,161 @@
+#include <QtTest/QtTest>
+#include <QFile>
+#include <gui/shmgrid.h>
+
+namespace NeovimQt {
+
+/// Writes snapshots the way Neovim does (src/nvim/ui_shm.c), the layout
+/// must be kept in sync with it
+class TestShmGrid: public QObject
+{
+	Q_OBJECT
+private slots:
+	void create();
+	void readRow();
+	void resync();
+private:
+	static const int TEXT_BYTES = 32;
+	static const int HEADER_SIZE = 64;
+	static const int SLOT_HEADER_SIZE = 32;
+	static const int CELL_SIZE = TEXT_BYTES + 4;
+
+	static uchar *slotAt(uchar *map, const ShmGrid& g, int slot) {
+		return map + HEADER_SIZE
+			+ slot * (SLOT_HEADER_SIZE + g.rows() * g.cols() * CELL_SIZE);
+	}
+
+	/// Set the generation markers of a slot and its grid size
+	static void setHeader(uchar *slot, quint64 begin, quint64 end,
+			quint32 rows, quint32 cols) {
+		memcpy(slot, &begin, 8);
+		memcpy(slot + 8, &end, 8);
+		memcpy(slot + 16, &rows, 4);
+		memcpy(slot + 20, &cols, 4);
+	}
+
+	static void setCell(uchar *slot, const ShmGrid& g, int row, int col,
+			const QByteArray& text, qint32 attr) {
+		uchar *cell = slot + SLOT_HEADER_SIZE + (row * g.cols() + col) * CELL_SIZE;
+		memset(cell, 0, TEXT_BYTES);
+		memcpy(cell, text.constData(), text.size());
+		memcpy(cell + TEXT_BYTES, &attr, 4);
+	}
+
+	/// The text of a row, as read by ShmGrid
+	static QString rowText(const QList<QByteArray>& cells) {
+		QByteArray bytes;
+		foreach(const QByteArray& cell, cells) {
+			bytes.append(cell);
+			bytes.append('\0');
+		}
+		return QString::fromUtf8(bytes.constData(), bytes.size());
+	}
+
+	/// The runs of a row, as "col:attr:text"
+	static QStringList runs(const ShmGrid::Row& row) {
+		QStringList l;
+		foreach(const ShmGrid::Row::Run& run, row.runs()) {
+			l.append(QString("%1:%2:%3").arg(run.col).arg(run.attr).arg(run.text));
+		}
+		return l;
+	}
+};
+
+void TestShmGrid::create()
+{
+	ShmGrid g;
+	QVERIFY(!g.isValid());
+	QVERIFY(!g.create(0, 10));
+	QVERIFY(g.create(3, 4, 2));
+	QVERIFY(g.isValid());
+	QVERIFY(!g.create(3, 4, 2));
+
+	QFile f(g.path());
+	QVERIFY(f.open(QIODevice::ReadOnly));
+	QCOMPARE(f.size(), qint64(HEADER_SIZE + 2 * (SLOT_HEADER_SIZE + 3*4*CELL_SIZE)));
+	QCOMPARE(f.read(8), QByteArray("NVQTSHM1"));
+
+	// Nothing was published yet
+	QVector<ShmGrid::Row> rows;
+	QVERIFY(!g.readRows(1, 1, 0, 3, rows));
+	QVERIFY(!g.readRows(0, 5, 0, 3, rows));
+}
+
+void TestShmGrid::readRow()
+{
+	ShmGrid g;
+	QVERIFY(g.create(3, 4, 2));
+	QFile f(g.path());
+	QVERIFY(f.open(QIODevice::ReadWrite));
+	uchar *map = f.map(0, f.size());
+	QVERIFY(map);
+
+	// A snapshot of a 2x3 grid in slot 1, with a double width character
+	// and a combining character
+	uchar *slot = slotAt(map, g, 1);
+	QList<QByteArray> row0, row1;
+	row0 << "a" << "\xe6\x97\xa5" << "";
+	row1 << "e\xcc\x81" << " " << "x";
+	for (int col=0; col<3; col++) {
+		setCell(slot, g, 0, col, row0.at(col), col == 0 ? 1 : 2);
+		setCell(slot, g, 1, col, row1.at(col), 3);
+	}
+	setHeader(slot, 7, 7, 2, 3);
+
+	QVector<ShmGrid::Row> rows;
+	QVERIFY(g.readRows(7, 1, 0, 2, rows));
+	QCOMPARE(rows.size(), 2);
+	QCOMPARE(rows.at(0).text, rowText(row0));
+	QCOMPARE(rows.at(0).attrs, QVector<qint32>() << 1 << 2 << 2);
+	QCOMPARE(rows.at(1).text, rowText(row1));
+	// Every cell ends with a NUL
+	QCOMPARE(rows.at(0).text.count(QChar::Null), 3);
+	QCOMPARE(rows.at(1).text.count(QChar::Null), 3);
+	QCOMPARE(rows.at(1).text, QString::fromUtf8("e\xcc\x81\0 \0x\0", 8));
+
+	// The runs of cells passed to Shell::putGrid()
+	QCOMPARE(runs(rows.at(0)), QStringList() << "0:1:a" << "1:2:\xe6\x97\xa5");
+	QCOMPARE(runs(rows.at(1)), QStringList() << "0:3:e\xcc\x81 x");
+	QCOMPARE(rows.at(1).attrs, QVector<qint32>() << 3 << 3 << 3);
+
+	// Rows past the grid size are not read
+	QVERIFY(g.readRows(7, 1, 1, 3, rows));
+	QCOMPARE(rows.size(), 1);
+	QCOMPARE(rows.at(0).text, rowText(row1));
+}
+
+void TestShmGrid::resync()
+{
+	ShmGrid g;
+	QVERIFY(g.create(2, 2, 2));
+	QFile f(g.path());
+	QVERIFY(f.open(QIODevice::ReadWrite));
+	uchar *map = f.map(0, f.size());
+	QVERIFY(map);
+
+	uchar *slot = slotAt(map, g, 0);
+	setCell(slot, g, 0, 0, "a", 0);
+	setCell(slot, g, 0, 1, "b", 0);
+	setHeader(slot, 2, 2, 2, 2);
+	QVector<ShmGrid::Row> rows;
+	QVERIFY(g.readRows(2, 0, 0, 1, rows));
+
+	// The slot is being overwritten by a later snapshot
+	setHeader(slot, 4, 2, 2, 2);
+	QVERIFY(!g.readRows(2, 0, 0, 1, rows));
+	QVERIFY(!g.readRows(4, 0, 0, 1, rows));
+
+	// The later snapshot is complete, the old one is gone
+	setCell(slot, g, 0, 0, "c", 0);
+	setHeader(slot, 4, 4, 2, 2);
+	QVERIFY(!g.readRows(2, 0, 0, 1, rows));
+	QVERIFY(g.readRows(4, 0, 0, 2, rows));
+	QCOMPARE(rows.size(), 2);
+	QCOMPARE(rows.at(0).text, rowText(QList<QByteArray>() << "c" << "b"));
+	QCOMPARE(rows.at(0).text.count(QChar::Null), 2);
+}
+
+} // Namespace NeovimQt
+
+QTEST_GUILESS_MAIN(NeovimQt::TestShmGrid)
+#include "tst_shmgrid.moc"
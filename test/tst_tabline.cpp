@@ -0,0 +1,91 @@
+#include <QtTest/QtTest>
+#include <gui/tabline.h>
+
+namespace NeovimQt {
+
+class TestTabline: public QObject
+{
+	Q_OBJECT
+private slots:
+	void update();
+	void unchanged();
+	void manyTabs();
+private:
+	static QList<Tab> tabs(const QList<int64_t>& handles) {
+		QList<Tab> l;
+		foreach(int64_t h, handles) {
+			l.append(Tab(h, QString("tab %1").arg(h)));
+		}
+		return l;
+	}
+	/// The tab handles in the bar, checking the tab text
+	static QList<int64_t> handles(QTabBar& bar) {
+		QList<int64_t> l;
+		for (int i=0; i<bar.count(); i++) {
+			int64_t h = bar.tabData(i).toLongLong();
+			if (bar.tabText(i) != QString("tab %1").arg(h)) {
+				l.append(-1);
+			} else {
+				l.append(h);
+			}
+		}
+		return l;
+	}
+};
+
+void TestTabline::update()
+{
+	QTabBar bar;
+	QSignalSpy spy(&bar, SIGNAL(currentChanged(int)));
+	QCOMPARE(updateTabBar(&bar, 2, tabs({1, 2, 3})), 3);
+	QCOMPARE(handles(bar), QList<int64_t>({1, 2, 3}));
+	QCOMPARE(bar.currentIndex(), 1);
+
+	// Remove, insert and move
+	updateTabBar(&bar, 3, tabs({3, 4, 1}));
+	QCOMPARE(handles(bar), QList<int64_t>({3, 4, 1}));
+	QCOMPARE(bar.currentIndex(), 0);
+
+	// Rename
+	QList<Tab> renamed = tabs({3, 4, 1});
+	renamed[1].name = "a & b";
+	QCOMPARE(updateTabBar(&bar, 3, renamed), 1);
+	QCOMPARE(bar.tabText(1), QString("a && b"));
+
+	// Tab changes from Neovim are not sent back
+	QCOMPARE(spy.count(), 0);
+}
+
+void TestTabline::unchanged()
+{
+	QTabBar bar;
+	updateTabBar(&bar, 1, tabs({1, 2, 3}));
+	QCOMPARE(updateTabBar(&bar, 1, tabs({1, 2, 3})), 0);
+	QCOMPARE(updateTabBar(&bar, 3, tabs({1, 2, 3})), 0);
+	QCOMPARE(bar.currentIndex(), 2);
+}
+
+void TestTabline::manyTabs()
+{
+	QList<int64_t> list;
+	for (int i=1; i<=100; i++) {
+		list.append(i);
+	}
+	QTabBar bar;
+	updateTabBar(&bar, 1, tabs(list));
+
+	// Closing a tab in the middle only removes that tab
+	list.removeAt(50);
+	QCOMPARE(updateTabBar(&bar, 1, tabs(list)), 1);
+	QCOMPARE(handles(bar), list);
+
+	// Moving the last tab to the front is a single move
+	list.prepend(list.takeLast());
+	QCOMPARE(updateTabBar(&bar, 1, tabs(list)), 1);
+	QCOMPARE(handles(bar), list);
+}
+
+} // Namespace NeovimQt
+
+QTEST_MAIN(NeovimQt::TestTabline)
+#include "tst_tabline.moc"
@@ -3,6 +3,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <uv.h>
 #include "nvim/event/multiqueue.h"
 #include "multiqueue.h"
 
@@ -17,3 +18,32 @@ const char *ut_multiqueue_get(MultiQueue *this)
   Event event = multiqueue_get(this);
   return event.argv[0];
 }
+
+/// Pushes `count` events round-robin to `nchildren` child queues (to the
+/// parent if there are none), draining the parent every `batch` events, and
+/// returns the events per second.
+double ut_multiqueue_bench(size_t nchildren, size_t batch, size_t count)
+{
+  MultiQueue *parent = multiqueue_new_parent(NULL, NULL);
+  MultiQueue **children = malloc((nchildren + 1) * sizeof(MultiQueue *));
+  for (size_t i = 0; i < nchildren; i++) {
+    children[i] = multiqueue_new_child(parent);
+  }
+
+  uint64_t start = uv_hrtime();
+  for (size_t i = 0; i < count; i += batch) {
+    for (size_t j = 0; j < batch; j++) {
+      MultiQueue *q = nchildren ? children[j % nchildren] : parent;
+      multiqueue_put(q, NULL, 0);
+    }
+    multiqueue_process_events(parent);
+  }
+  uint64_t elapsed = uv_hrtime() - start;
+
+  for (size_t i = 0; i < nchildren; i++) {
+    multiqueue_free(children[i]);
+  }
+  free(children);
+  multiqueue_free(parent);
+  return elapsed ? (double)count * 1e9 / (double)elapsed : 0;
+}
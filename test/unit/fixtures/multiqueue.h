@@ -2,3 +2,4 @@
 
 void ut_multiqueue_put(MultiQueue *queue, const char *str);
 const char *ut_multiqueue_get(MultiQueue *queue);
+double ut_multiqueue_bench(size_t nchildren, size_t batch, size_t count);
@@ -0,0 +1,142 @@
+local helpers = require("test.unit.helpers")(after_each)
+local itp = helpers.gen_itp(it)
+
+local cimport = helpers.cimport
+local eq = helpers.eq
+local ffi = helpers.ffi
+
+local lib = cimport('./src/nvim/linediff.h', './src/nvim/memory.h')
+
+local algorithms = {
+  myers = lib.kLineDiffMyers,
+  minimal = lib.kLineDiffMinimal,
+  patience = lib.kLineDiffPatience,
+  histogram = lib.kLineDiffHistogram,
+}
+
+local function ids(t)
+  local c = ffi.new('int[?]', #t + 1)
+  for i, v in ipairs(t) do
+    c[i - 1] = v
+  end
+  return c
+end
+
+local function diff(a, b, algorithm)
+  local hunks = ffi.new('LineDiffHunks[1]')
+  lib.linediff(ids(a), #a, ids(b), #b, algorithm, hunks)
+  local res = {}
+  for i = 0, tonumber(hunks[0].size) - 1 do
+    local h = hunks[0].items[i]
+    table.insert(res, {tonumber(h.start_a), tonumber(h.count_a),
+                       tonumber(h.start_b), tonumber(h.count_b)})
+  end
+  lib.xfree(hunks[0].items)
+  return res
+end
+
+-- Checks that the lines between the hunks are equal, returns the number of
+-- changed lines.
+local function check(a, b, hunks)
+  local i, j, edits = 0, 0, 0
+  local function equal_until(si, sj)
+    eq(si - i, sj - j)
+    while i < si do
+      eq(a[i + 1], b[j + 1])
+      i, j = i + 1, j + 1
+    end
+  end
+  for _, h in ipairs(hunks) do
+    assert.is_true(h[1] >= i and h[3] >= j)
+    assert.is_true(h[2] + h[4] > 0)
+    equal_until(h[1], h[3])
+    i, j = i + h[2], j + h[4]
+    edits = edits + h[2] + h[4]
+  end
+  equal_until(#a, #b)
+  return edits
+end
+
+-- Number of changed lines in a smallest diff.
+local function min_edits(a, b)
+  local lcs = {}
+  for i = 0, #a do
+    lcs[i] = {[0] = 0}
+  end
+  for j = 0, #b do
+    lcs[0][j] = 0
+  end
+  for i = 1, #a do
+    for j = 1, #b do
+      if a[i] == b[j] then
+        lcs[i][j] = lcs[i - 1][j - 1] + 1
+      else
+        lcs[i][j] = math.max(lcs[i - 1][j], lcs[i][j - 1])
+      end
+    end
+  end
+  return #a + #b - 2 * lcs[#a][#b]
+end
+
+describe('linediff', function()
+  for name, algorithm in pairs(algorithms) do
+    describe(name, function()
+      itp('finds no changes in equal lines', function()
+        eq({}, diff({}, {}, algorithm))
+        eq({}, diff({1, 2, 3}, {1, 2, 3}, algorithm))
+      end)
+
+      itp('finds changed, added and deleted lines', function()
+        eq({{1, 1, 1, 1}}, diff({1, 2, 3}, {1, 4, 3}, algorithm))
+        eq({{1, 0, 1, 2}}, diff({1, 3}, {1, 4, 5, 3}, algorithm))
+        eq({{0, 2, 0, 0}}, diff({1, 2, 3}, {3}, algorithm))
+        eq({{0, 0, 0, 2}}, diff({}, {1, 2}, algorithm))
+        eq({{1, 1, 1, 0}, {4, 0, 3, 1}},
+           diff({1, 2, 3, 4, 5}, {1, 3, 4, 6, 5}, algorithm))
+      end)
+
+      itp('matches all equal lines', function()
+        math.randomseed(42)
+        for _ = 1, 100 do
+          local a, b = {}, {}
+          for _ = 1, math.random(0, 40) do
+            table.insert(a, math.random(1, 6))
+          end
+          for _ = 1, math.random(0, 40) do
+            table.insert(b, math.random(1, 6))
+          end
+          local edits = check(a, b, diff(a, b, algorithm))
+          if algorithm == lib.kLineDiffMinimal then
+            eq(min_edits(a, b), edits)
+          end
+        end
+      end)
+    end)
+  end
+
+  itp('anchors on all unique lines at once', function()
+    -- Every tenth line changed: all unique lines must be anchors of the
+    -- first pass, one anchor per pass takes quadratic time and recursion
+    -- as deep as the number of lines.
+    local a, b = {}, {}
+    for i = 1, 50000 do
+      a[i] = i
+      b[i] = i % 10 == 0 and 100000 + i or i
+    end
+    for _, algorithm in ipairs({lib.kLineDiffPatience,
+                                lib.kLineDiffHistogram}) do
+      local hunks = diff(a, b, algorithm)
+      eq(5000, #hunks)
+      eq(10000, check(a, b, hunks))
+    end
+  end)
+
+  itp('anchors patience diffs on unique lines', function()
+    -- Myers keeps the repeated lines 5, patience keeps the unique line 1.
+    local a = {1, 5, 5, 2}
+    local b = {5, 5, 1, 2}
+    eq({{0, 1, 0, 0}, {3, 0, 2, 1}}, diff(a, b, lib.kLineDiffMyers))
+    eq({{0, 0, 0, 2}, {1, 2, 3, 0}}, diff(a, b, lib.kLineDiffPatience))
+    eq({{0, 0, 0, 2}, {1, 2, 3, 0}}, diff(a, b, lib.kLineDiffHistogram))
+  end)
+end)
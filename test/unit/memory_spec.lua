@@ -50,3 +50,24 @@ describe('xstrlcat()', function()
   end)
 
 end)
+
+describe('arena', function()
+  itp('allocates small and large blocks', function()
+    local arena = ffi.new('Arena[1]')
+    local strs = {}
+    -- enough small strings to need several blocks
+    for i = 1, 1000 do
+      local s = 'item' .. i
+      strs[i] = cimp.arena_memdupz(arena, s, #s)
+    end
+    local big = string.rep('x', 10000)
+    local big_cstr = cimp.arena_memdupz(arena, big, #big)
+    for i = 1, 1000 do
+      eq('item' .. i, ffi.string(strs[i]))
+    end
+    eq(big, ffi.string(big_cstr))
+    cimp.arena_mem_free(arena)
+    eq(true, arena[0].cur_blk == nil)
+    eq(0, tonumber(arena[0].size))
+  end)
+end)
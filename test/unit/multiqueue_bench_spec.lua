@@ -0,0 +1,35 @@
+local helpers = require("test.unit.helpers")(after_each)
+local itp = helpers.gen_itp(it)
+
+local cimport = helpers.cimport
+local ok = helpers.ok
+
+local multiqueue = cimport("./test/unit/fixtures/multiqueue.h")
+
+describe('multiqueue benchmark', function()
+  -- Takes a few seconds, only run on request
+  if os.getenv('NVIM_TEST_RUN_BENCHMARKS') ~= '1' then
+    pending('set NVIM_TEST_RUN_BENCHMARKS=1 to run', function() end)
+    return
+  end
+
+  local function bench(nchildren, batch)
+    local count = 1000000
+    local rate = multiqueue.ut_multiqueue_bench(nchildren, batch, count)
+    print(('\n%d events, %d children, batch %d: %.0f events/s'):format(
+      count, nchildren, batch, rate))
+    ok(rate > 0)
+  end
+
+  itp('pushes to a parent queue', function()
+    bench(0, 64)
+  end)
+
+  itp('pushes to child queues', function()
+    bench(4, 64)
+  end)
+
+  itp('pushes to child queues in large batches', function()
+    bench(4, 4096)
+  end)
+end)
@@ -138,6 +138,20 @@ describe("multiqueue (multi-level event-queue)", function()
     eq('c2i11', get(parent))
   end)
 
+  itp('moves events to another queue in order', function()
+    local other = multiqueue.multiqueue_new_parent(ffi.NULL, ffi.NULL)
+    put(other, 'o1')
+    put(other, 'o2')
+    multiqueue.multiqueue_move_events(child3, other)
+    eq(0, multiqueue.multiqueue_size(other))
+    eq(4, multiqueue.multiqueue_size(child3))
+    eq('c3i1', get(child3))
+    eq('c3i2', get(child3))
+    eq('o1', get(child3))
+    eq('o2', get(child3))
+    free(other)
+  end)
+
   itp('removes from parent queue when child is freed', function()
     free(child2)
     eq('c1i1', get(parent))
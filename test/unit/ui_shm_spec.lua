@@ -0,0 +1,170 @@
+local helpers = require("test.unit.helpers")(after_each)
+local itp = helpers.gen_itp(it)
+
+local eq = helpers.eq
+local ffi = helpers.ffi
+local to_cstr = helpers.to_cstr
+local NULL = helpers.NULL
+
+local lib = helpers.cimport('./src/nvim/ui_shm.h')
+
+local fname = 'Xtest-ui-shm'
+
+-- Keep in sync with src/nvim/ui_shm.h
+local TEXT_BYTES = 32
+local HEADER_SIZE = 64
+local SLOT_HEADER_SIZE = 32
+
+-- Creates a shared grid the way the UI does, returns it opened by nvim
+local function open(rows, cols, slots)
+  local header = ffi.new('UIShmHeader')
+  ffi.copy(header.magic, 'NVQTSHM1', 8)
+  header.rows, header.cols, header.slots = rows, cols, slots
+  header.text_bytes = TEXT_BYTES
+  local slot_size = SLOT_HEADER_SIZE
+                    + rows * cols * ffi.sizeof('UIShmCell')
+  local f = io.open(fname, 'wb')
+  f:write(ffi.string(header, ffi.sizeof(header)))
+  f:write(('\0'):rep(HEADER_SIZE - ffi.sizeof(header)
+                     + slots * slot_size))
+  f:close()
+
+  local err = ffi.new('Error[1]')
+  err[0].type = lib.kErrorTypeNone
+  local shm = lib.ui_shm_open(to_cstr(fname), err)
+  eq(lib.kErrorTypeNone, err[0].type)
+  return shm
+end
+
+-- Writes a grid line, cells is a list of {text, attr}
+local function raw_line(shm, row, startcol, cells, clearcol)
+  local chunk = ffi.new('schar_T[?]', #cells + 1)
+  local attrs = ffi.new('sattr_T[?]', #cells + 1)
+  for i, cell in ipairs(cells) do
+    ffi.copy(chunk[i - 1], cell[1])
+    attrs[i - 1] = cell[2]
+  end
+  local endcol = startcol + #cells
+  return lib.ui_shm_raw_line(shm, row, startcol, endcol, clearcol or endcol,
+                             0, chunk, attrs)
+end
+
+-- Reads rows from the snapshot like the UI does, as a list of lines with
+-- the cells separated by |, or nil if the snapshot is incomplete
+local function read(shm, slot, generation)
+  local base = shm.map + HEADER_SIZE
+               + slot * (SLOT_HEADER_SIZE
+                         + shm.rows * shm.cols * ffi.sizeof('UIShmCell'))
+  local header = ffi.cast('UIShmSlotHeader *', base)
+  if header.gen_begin ~= generation or header.gen_end ~= generation then
+    return nil
+  end
+  local cells = ffi.cast('UIShmCell *', base + SLOT_HEADER_SIZE)
+  local lines = {}
+  for row = 0, header.rows - 1 do
+    local line = {}
+    for col = 0, header.cols - 1 do
+      local cell = cells[row * shm.cols + col]
+      table.insert(line, ffi.string(cell.text) .. ':' .. cell.attr)
+    end
+    table.insert(lines, table.concat(line, '|'))
+  end
+  return lines
+end
+
+local function publish(shm)
+  local slot = ffi.new('uint32_t[1]')
+  local generation = lib.ui_shm_publish(shm, slot)
+  return slot[0], generation
+end
+
+describe('ui_shm', function()
+  after_each(function()
+    os.remove(fname)
+  end)
+
+  itp('rejects invalid files', function()
+    local f = io.open(fname, 'wb')
+    f:write(('x'):rep(256))
+    f:close()
+    local err = ffi.new('Error[1]')
+    err[0].type = lib.kErrorTypeNone
+    eq(true, lib.ui_shm_open(to_cstr(fname), err) == NULL)
+    eq(lib.kErrorTypeValidation, err[0].type)
+  end)
+
+  itp('publishes grid lines to the next slot', function()
+    local shm = open(3, 4, 2)
+    lib.ui_shm_resize(shm, 3, 2)
+    eq(true, shm.active)
+    eq(true, raw_line(shm, 1, 0, {{'a', 1}, {'日', 2}, {'', 2}}))
+    eq(true, raw_line(shm, 0, 1, {{'é', 3}}, 3))
+
+    local slot, generation = publish(shm)
+    eq(1, slot)
+    eq({' :0|é:3| :0', 'a:1|日:2|:2'}, read(shm, slot, generation))
+
+    -- Later snapshots use the other slot, the first one is kept
+    eq(true, raw_line(shm, 0, 0, {{'x', 4}}))
+    local slot2, generation2 = publish(shm)
+    eq(0, slot2)
+    eq({'x:4|é:3| :0', 'a:1|日:2|:2'}, read(shm, slot2, generation2))
+    eq({' :0|é:3| :0', 'a:1|日:2|:2'}, read(shm, slot, generation))
+
+    -- The slot of the first snapshot is reused, its generation is gone
+    local slot3 = publish(shm)
+    eq(slot, slot3)
+    eq(nil, read(shm, slot, generation))
+    lib.ui_shm_close(shm)
+  end)
+
+  itp('rejects lines outside the grid', function()
+    local shm = open(3, 4, 2)
+    lib.ui_shm_resize(shm, 3, 2)
+    eq(false, raw_line(shm, -1, 0, {{'a', 1}}))
+    eq(false, raw_line(shm, 2, 0, {{'a', 1}}))
+    eq(false, raw_line(shm, 0, -1, {{'a', 1}}))
+    eq(false, raw_line(shm, 0, 2, {{'a', 1}, {'b', 1}}))
+    eq(false, raw_line(shm, 0, 0, {{'a', 1}}, 4))
+
+    -- Grids larger than the shared grid are sent as grid_line events
+    lib.ui_shm_resize(shm, 5, 2)
+    eq(false, shm.active)
+    eq(false, raw_line(shm, 0, 0, {{'a', 1}}))
+    lib.ui_shm_close(shm)
+  end)
+
+  itp('scrolls rows along with their dirty flags', function()
+    local shm = open(4, 2, 2)
+    lib.ui_shm_resize(shm, 2, 4)
+    for row = 0, 3 do
+      raw_line(shm, row, 0, {{tostring(row), row}, {'-', 0}})
+    end
+    publish(shm)
+    for row = 0, 3 do
+      shm.dirty[row] = false
+    end
+
+    -- Row 3 changes, then rows [1, 4) scroll up by one
+    raw_line(shm, 3, 0, {{'x', 5}})
+    lib.ui_shm_scroll(shm, 1, 4, 0, 2, 1)
+    local slot, generation = publish(shm)
+    eq({'0:0|-:0', '2:2|-:0', 'x:5|-:0', 'x:5|-:0'},
+       read(shm, slot, generation))
+    eq({false, false, true, true},
+       {shm.dirty[0], shm.dirty[1], shm.dirty[2], shm.dirty[3]})
+
+    -- Row 0 changes, then the grid scrolls down by two
+    for row = 0, 3 do
+      shm.dirty[row] = false
+    end
+    raw_line(shm, 0, 0, {{'y', 6}})
+    lib.ui_shm_scroll(shm, 0, 4, 0, 2, -2)
+    slot, generation = publish(shm)
+    eq({'y:6|-:0', '2:2|-:0', 'y:6|-:0', '2:2|-:0'},
+       read(shm, slot, generation))
+    eq({true, false, true, false},
+       {shm.dirty[0], shm.dirty[1], shm.dirty[2], shm.dirty[3]})
+    lib.ui_shm_close(shm)
+  end)
+end)